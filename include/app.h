@@ -12,17 +12,78 @@
 // Common
 // =============================================================================
 
+// Note(fredy): a function takes a scratch arena other than the one of its caller, two are enough for that
+#define THREAD_SCRATCH_ARENA_COUNT 2
+
 typedef struct ThreadContext {
+	/**
+	 * @brief Memory of the thread alone, given by the platform. It is only used through temporary scopes, so it is
+	 * empty between jobs
+	 */
+	Arena *scratch_arenas[THREAD_SCRATCH_ARENA_COUNT];
+
+	// Note(fredy): 0 is the main thread, the workers go from 1 to the worker count
 	unsigned idx;
 } ThreadContext;
 
+/**
+ * @brief Opens a temporary scope on a scratch arena of the thread, it has to be closed by arena_end_temp
+ *
+ * @param thread
+ * @param conflict Arena of the caller, the scratch arena is never this one. nullptr when there is none
+ * @return ArenaTemp
+ */
+static inline ArenaTemp thread_begin_scratch(ThreadContext *thread, const Arena *conflict)
+{
+	Arena *arena = nullptr;
+
+	for (uint32_t scratch_idx = 0; scratch_idx < THREAD_SCRATCH_ARENA_COUNT; ++scratch_idx) {
+		if (thread->scratch_arenas[scratch_idx] != conflict) {
+			arena = thread->scratch_arenas[scratch_idx];
+			break;
+		}
+	}
+
+	assert(arena);
+
+	ArenaTemp result = arena_begin_temp(arena);
+
+	return result;
+}
+
+// =============================================================================
+// Work Queue
+// =============================================================================
+
+/**
+ * @brief Pool of worker threads owned by the platform. Every thread has its own deque and steals from the
+ * others when its deque is empty.
+ */
+typedef struct WorkQueue WorkQueue;
+
+#define WORK_QUEUE_CALLBACK(name) void name([[__maybe_unused__]] ThreadContext *thread, void *data)
+typedef WORK_QUEUE_CALLBACK(work_queue_callback_func);
+
+/**
+ * @brief Pushes a job into the deque of the calling thread
+ */
+#define WORK_QUEUE_ADD_ENTRY(name) \
+	void name(WorkQueue *queue, ThreadContext *thread, work_queue_callback_func *callback, void *data)
+typedef WORK_QUEUE_ADD_ENTRY(work_queue_add_entry_func);
+
+/**
+ * @brief Runs jobs on the calling thread until every added job is done
+ */
+#define WORK_QUEUE_COMPLETE_ALL(name) void name(WorkQueue *queue, ThreadContext *thread)
+typedef WORK_QUEUE_COMPLETE_ALL(work_queue_complete_all_func);
+
 // =============================================================================
 // Platform API
 // =============================================================================
 
 #if DEBUG
 
-#define MEMORY_BASE_ADDRESS ((void *)TB_TO_BYTES(2))
+#define MEMORY_BASE_ADDRESS ((void *)TB_TO_BYTES(2ULL))
 
 typedef struct ReadFileResult {
 	size_t size_byte;
@@ -145,10 +206,27 @@ typedef struct Storage {
 	size_t transient_size_byte;   // transient storage in bytes
 	void *transient_base_address; // This should be zero initialized
 
+	// Note(fredy): when the platform gives these the storage is only reserved, the game commits what it uses.
+	// Without them the storage is committed and zeroed upfront
+	arena_commit_func *plat_memory_commit;
+	arena_decommit_func *plat_memory_decommit;
+
 	file_free_debug_func *plat_file_free_debug;
 	file_read_debug_func *plat_file_read_debug;
 	file_write_debug_func *file_write_debug;
 
+	WorkQueue *work_queue;
+	work_queue_add_entry_func *plat_work_queue_add_entry;
+	work_queue_complete_all_func *plat_work_queue_complete_all;
+
+	uint64_t state_checksum; // checksum of the simulated state, written by the game every frame
+
+#if ARENA_INSTRUMENTATION
+	// Note(fredy): written by the game at the end of every frame, the transient one shows what the frame used
+	ArenaStats permanent_stats;
+	ArenaStats transient_stats;
+#endif
+
 	uint8_t is_initialized;
 } Storage;
 
@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h> // IWYU pragma: keep
 #include <string.h>
@@ -36,6 +37,22 @@
 #include <intrin.h>
 #endif
 
+#include <immintrin.h>
+
+// =============================================================================
+// Instruction sets
+// =============================================================================
+
+// Note(fredy): the build scripts pass -mavx2, a build without it compiles the scalar paths for the CPUs that lack
+// the instructions
+#ifndef LIB_SIMD_AVX2
+#ifdef __AVX2__
+#define LIB_SIMD_AVX2 1
+#else
+#define LIB_SIMD_AVX2 0
+#endif
+#endif
+
 // =============================================================================
 // Memory
 // =============================================================================
@@ -45,42 +62,603 @@
 #define GB_TO_BYTES(_pr_v) (MB_TO_BYTES(_pr_v) * 1024)
 #define TB_TO_BYTES(_pr_v) (GB_TO_BYTES(_pr_v) * 1024)
 
-#define ARENA_PUSH_ARRAY(arena, type, count) (type *)arena_push((arena), sizeof(type) * (count))
-#define ARENA_PUSH_STRUCT(arena, type) (type *)arena_push((arena), sizeof(type))
+#define CACHE_LINE_BYTES 64
+
+// Note(fredy): accounts the pushes of every arena by tag, without it the tags cost nothing. The game and the
+// platform must be built with the same value, Storage changes with it
+#ifndef ARENA_INSTRUMENTATION
+#define ARENA_INSTRUMENTATION 0
+#endif
+
+// Note(fredy): the arenas over reserved memory commit it in blocks of this size, a multiple of the page size
+#define ARENA_COMMIT_BYTES MB_TO_BYTES(1ULL)
+
+/**
+ * @brief Makes the reserved pages that hold the bytes readable and writable, they come zeroed. Returns 0 on failure
+ */
+#define ARENA_COMMIT(name) uint32_t name(void *base_address, size_t size_bytes)
+typedef ARENA_COMMIT(arena_commit_func);
+
+/**
+ * @brief Gives the pages that hold the bytes back to the OS, they stay reserved
+ */
+#define ARENA_DECOMMIT(name) void name(void *base_address, size_t size_bytes)
+typedef ARENA_DECOMMIT(arena_decommit_func);
+
+#define ARENA_PUSH_ARRAY(arena, type, count) \
+	(type *)arena_push_aligned((arena), sizeof(type) * (count), alignof(type))
+#define ARENA_PUSH_STRUCT(arena, type) (type *)arena_push_aligned((arena), sizeof(type), alignof(type))
+
+#define ARENA_PUSH_ARRAY_ZERO(arena, type, count) \
+	(type *)arena_push_zero_aligned((arena), sizeof(type) * (count), alignof(type))
+#define ARENA_PUSH_STRUCT_ZERO(arena, type) (type *)arena_push_zero_aligned((arena), sizeof(type), alignof(type))
+
+// Note(fredy): for the arrays loaded by SIMD kernels and for the data written by different threads, nothing else
+// shares their first cache line
+#define ARENA_PUSH_ARRAY_CACHE_LINE(arena, type, count) \
+	(type *)arena_push_aligned((arena), sizeof(type) * (count), CACHE_LINE_BYTES)
+#define ARENA_PUSH_STRUCT_CACHE_LINE(arena, type) (type *)arena_push_aligned((arena), sizeof(type), CACHE_LINE_BYTES)
 
-#define ARENA_PUSH_ARRAY_ZERO(arena, type, count) (type *)arena_push_zero((arena), sizeof(type) * (count))
-#define ARENA_PUSH_STRUCT_ZERO(arena, type) (type *)arena_push_zero((arena), sizeof(type))
+/**
+ * @brief What the bytes pushed on an arena are used for, the pushes go to the tag set last on the arena
+ */
+typedef enum ArenaTag {
+	ARENA_TAG_NONE,
+	ARENA_TAG_MAP,
+	ARENA_TAG_ENTITIES,
+	ARENA_TAG_ASSETS,
+	ARENA_TAG_RENDER,
+
+	ARENA_TAG_COUNT,
+} ArenaTag;
+
+static const char *const arena_tag_names[ARENA_TAG_COUNT] = {
+	[ARENA_TAG_NONE] = "none",
+	[ARENA_TAG_MAP] = "map",
+	[ARENA_TAG_ENTITIES] = "entities",
+	[ARENA_TAG_ASSETS] = "assets",
+	[ARENA_TAG_RENDER] = "render",
+};
+
+typedef struct ArenaTagStats {
+	/**
+	 * @brief Bytes of the tag that are still pushed, the padding before a push counts for its tag
+	 */
+	size_t used_bytes;
+	size_t high_water_bytes;
+	uint64_t push_count;
+} ArenaTagStats;
+
+/**
+ * @brief Snapshot of the use of an arena, the high water marks and the tags are zero without ARENA_INSTRUMENTATION
+ */
+typedef struct ArenaStats {
+	size_t capacity_bytes;
+	size_t used_bytes;
+	size_t committed_bytes;
+	size_t high_water_bytes;
+	ArenaTagStats tags[ARENA_TAG_COUNT];
+} ArenaStats;
 
 typedef struct Arena {
 	size_t capacity_bytes;
 	unsigned char *base_address;
 	size_t used_bytes;
+
+	/**
+	 * @brief Most bytes used since the arena was reset, the temporary scopes do not lower it
+	 */
+	size_t peak_bytes;
+
+	/**
+	 * @brief Bytes from the base that may have been written, the memory past them is still zero
+	 */
+	size_t dirty_bytes;
+
+	/**
+	 * @brief Bytes from the base that can be used, the rest is only reserved. The memory is committed all at once
+	 * when there is no commit function
+	 */
+	size_t committed_bytes;
+	arena_commit_func *commit;
+	arena_decommit_func *decommit;
+
+	/**
+	 * @brief Temporary scopes that are open, they must be closed in the reverse order they were opened
+	 */
+	uint32_t temp_count;
+
+#if ARENA_INSTRUMENTATION
+	ArenaTag tag;
+	size_t high_water_bytes;
+	ArenaTagStats tags[ARENA_TAG_COUNT];
+#endif
 } Arena;
 
+/**
+ * @brief Scope of an arena, everything pushed after it begins is released when it ends
+ */
+typedef struct ArenaTemp {
+	Arena *arena;
+	size_t used_bytes;
+
+#if ARENA_INSTRUMENTATION
+	size_t tag_used_bytes[ARENA_TAG_COUNT];
+#endif
+
+	uint32_t temp_idx;
+} ArenaTemp;
+
+/**
+ * @brief Arena over memory with any content, the zeroing pushes clear all of it
+ *
+ * @param arena
+ * @param size_bytes
+ * @param base
+ */
 void arena_init(Arena *restrict arena, const size_t size_bytes, unsigned char *const restrict base)
 {
 	arena->capacity_bytes = size_bytes;
 	arena->base_address = base;
 	arena->used_bytes = 0;
+	arena->peak_bytes = 0;
+	arena->dirty_bytes = size_bytes;
+	arena->committed_bytes = size_bytes;
+	arena->commit = nullptr;
+	arena->decommit = nullptr;
+	arena->temp_count = 0;
+
+#if ARENA_INSTRUMENTATION
+	arena->tag = ARENA_TAG_NONE;
+	arena->high_water_bytes = 0;
+	memset(arena->tags, 0, sizeof(arena->tags));
+#endif
+}
+
+/**
+ * @brief Sets the tag the next pushes are accounted to
+ *
+ * @param arena
+ * @param tag
+ */
+void arena_set_tag([[__maybe_unused__]] Arena *arena, [[__maybe_unused__]] ArenaTag tag)
+{
+#if ARENA_INSTRUMENTATION
+	arena->tag = tag;
+#endif
+}
+
+/**
+ * @brief Takes a snapshot of the use of the arena
+ *
+ * @param arena
+ * @return ArenaStats
+ */
+ArenaStats arena_get_stats(const Arena *arena)
+{
+	ArenaStats result = {
+		.capacity_bytes = arena->capacity_bytes,
+		.used_bytes = arena->used_bytes,
+		.committed_bytes = arena->committed_bytes,
+	};
+
+#if ARENA_INSTRUMENTATION
+	result.high_water_bytes = arena->high_water_bytes;
+	memcpy(result.tags, arena->tags, sizeof(result.tags));
+#endif
+
+	return result;
+}
+
+/**
+ * @brief Writes the stats as text, one line for the arena and one for every tag that was pushed
+ *
+ * @param stats
+ * @param name Names the arena in the text
+ * @param buffer
+ * @param size_bytes Size of the buffer, the text is cut to fit it
+ */
+void arena_format_stats(const ArenaStats *restrict stats, const char *restrict name, char *restrict buffer,
+                        size_t size_bytes)
+{
+	int written = snprintf(buffer, size_bytes, "%s: %zu/%zu KB used, %zu KB committed, %zu KB high water\n", name,
+	                       stats->used_bytes / 1024, stats->capacity_bytes / 1024, stats->committed_bytes / 1024,
+	                       stats->high_water_bytes / 1024);
+	size_t offset_bytes = written > 0 ? (size_t)written : 0;
+
+	for (uint32_t tag_idx = 0; tag_idx < ARENA_TAG_COUNT && offset_bytes < size_bytes; ++tag_idx) {
+		const ArenaTagStats *tag = &stats->tags[tag_idx];
+
+		if (tag->push_count) {
+			const char *tag_name = arena_tag_names[tag_idx];
+			size_t used_kb = tag->used_bytes / 1024;
+			size_t high_water_kb = tag->high_water_bytes / 1024;
+			written = snprintf(buffer + offset_bytes, size_bytes - offset_bytes,
+			                   "  %-8s %zu KB used, %zu KB high water, %llu pushes\n", tag_name, used_kb,
+			                   high_water_kb, (unsigned long long)tag->push_count);
+			offset_bytes += written > 0 ? (size_t)written : 0;
+		}
+	}
+}
+
+/**
+ * @brief Arena over memory that is all zero, like the pages just committed by the OS. The zeroing pushes only clear
+ * the bytes that were pushed before
+ *
+ * @param arena
+ * @param size_bytes
+ * @param base
+ */
+void arena_init_zeroed(Arena *restrict arena, const size_t size_bytes, unsigned char *const restrict base)
+{
+	arena_init(arena, size_bytes, base);
+	arena->dirty_bytes = 0;
+}
+
+/**
+ * @brief Arena over reserved memory, the pages are committed as the pushes reach them. The memory has to end on a
+ * page boundary so decommitting never touches what follows it
+ *
+ * @param arena
+ * @param size_bytes
+ * @param base
+ * @param commit nullptr when the memory is already committed and zeroed
+ * @param decommit nullptr when the committed memory is kept until the arena goes away
+ */
+void arena_init_reserved(Arena *restrict arena, const size_t size_bytes, unsigned char *const restrict base,
+                         arena_commit_func *commit, arena_decommit_func *decommit)
+{
+	arena_init_zeroed(arena, size_bytes, base);
+
+	if (commit) {
+		arena->committed_bytes = 0;
+		arena->commit = commit;
+		arena->decommit = decommit;
+	}
+}
+
+/**
+ * @brief Bytes from the base to the first commit block boundary at or after the given bytes, blocks are aligned on
+ * the address space so they hold whole pages
+ */
+size_t arena_get_commit_end(const Arena *arena, size_t size_bytes)
+{
+	uintptr_t base = (uintptr_t)arena->base_address;
+	uintptr_t end = (base + size_bytes + ARENA_COMMIT_BYTES - 1) & ~(uintptr_t)(ARENA_COMMIT_BYTES - 1);
+	size_t result = end - base < arena->capacity_bytes ? end - base : arena->capacity_bytes;
+
+	return result;
+}
+
+/**
+ * @brief Gives back the committed pages past the used bytes and the bytes to keep, they are zero when they are
+ * committed again. Does nothing when the arena has no decommit function
+ *
+ * @param arena
+ * @param keep_bytes Bytes from the base that stay committed even if they are not used
+ */
+void arena_decommit(Arena *arena, size_t keep_bytes)
+{
+	if (arena->decommit) {
+		size_t kept_bytes = arena->used_bytes > keep_bytes ? arena->used_bytes : keep_bytes;
+		size_t commit_end = arena_get_commit_end(arena, kept_bytes);
+
+		if (commit_end < arena->committed_bytes) {
+			arena->decommit(arena->base_address + commit_end, arena->committed_bytes - commit_end);
+			arena->committed_bytes = commit_end;
+
+			if (arena->dirty_bytes > commit_end) {
+				arena->dirty_bytes = commit_end;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Releases everything pushed on the arena, there can not be open temporary scopes
+ *
+ * @param arena
+ */
+void arena_reset(Arena *arena)
+{
+	assert(arena->temp_count == 0);
+
+	arena->used_bytes = 0;
+	arena->peak_bytes = 0;
+
+#if ARENA_INSTRUMENTATION
+	for (uint32_t tag_idx = 0; tag_idx < ARENA_TAG_COUNT; ++tag_idx) {
+		arena->tags[tag_idx].used_bytes = 0;
+	}
+#endif
+}
+
+/**
+ * @brief Opens a temporary scope, it has to be closed by arena_end_temp before the scopes opened earlier
+ *
+ * @param arena
+ * @return ArenaTemp
+ */
+ArenaTemp arena_begin_temp(Arena *arena)
+{
+	ArenaTemp result = {
+		.arena = arena,
+		.used_bytes = arena->used_bytes,
+		.temp_idx = arena->temp_count++,
+	};
+
+#if ARENA_INSTRUMENTATION
+	for (uint32_t tag_idx = 0; tag_idx < ARENA_TAG_COUNT; ++tag_idx) {
+		result.tag_used_bytes[tag_idx] = arena->tags[tag_idx].used_bytes;
+	}
+#endif
+
+	return result;
+}
+
+/**
+ * @brief Closes a temporary scope, releasing everything pushed while it was open
+ *
+ * @param temp
+ */
+void arena_end_temp(ArenaTemp temp)
+{
+	Arena *arena = temp.arena;
+
+	assert(arena->temp_count == temp.temp_idx + 1);
+	assert(arena->used_bytes >= temp.used_bytes);
+
+	arena->used_bytes = temp.used_bytes;
+	--arena->temp_count;
+
+#if ARENA_INSTRUMENTATION
+	for (uint32_t tag_idx = 0; tag_idx < ARENA_TAG_COUNT; ++tag_idx) {
+		arena->tags[tag_idx].used_bytes = temp.tag_used_bytes[tag_idx];
+	}
+#endif
+}
+
+/**
+ * @brief Pushes a block whose address is a multiple of the alignment
+ *
+ * @param arena
+ * @param size_bytes
+ * @param alignment_bytes A power of two
+ * @return void* nullptr when the pages it needs could not be committed, the arena is left as it was
+ */
+void *arena_push_aligned(Arena *arena, size_t size_bytes, size_t alignment_bytes)
+{
+	assert(alignment_bytes && (alignment_bytes & (alignment_bytes - 1)) == 0);
+
+	uintptr_t address = (uintptr_t)(arena->base_address + arena->used_bytes);
+	size_t padding_bytes = (size_t)(-address & (alignment_bytes - 1));
+
+	assert(arena->used_bytes + padding_bytes + size_bytes <= arena->capacity_bytes);
+
+	void *result = arena->base_address + arena->used_bytes + padding_bytes;
+	size_t used_bytes = arena->used_bytes + padding_bytes + size_bytes;
+
+	if (used_bytes > arena->committed_bytes) {
+		size_t commit_end = arena_get_commit_end(arena, used_bytes);
+		uint32_t was_committed = arena->commit(arena->base_address + arena->committed_bytes,
+		                                       commit_end - arena->committed_bytes);
+
+		if (was_committed) {
+			arena->committed_bytes = commit_end;
+		} else {
+			result = nullptr;
+		}
+	}
+
+	if (result) {
+		arena->used_bytes = used_bytes;
+
+		if (arena->dirty_bytes < arena->used_bytes) {
+			arena->dirty_bytes = arena->used_bytes;
+		}
+
+		if (arena->peak_bytes < arena->used_bytes) {
+			arena->peak_bytes = arena->used_bytes;
+		}
+
+#if ARENA_INSTRUMENTATION
+		ArenaTagStats *tag = &arena->tags[arena->tag];
+		tag->used_bytes += padding_bytes + size_bytes;
+		++tag->push_count;
+
+		if (tag->high_water_bytes < tag->used_bytes) {
+			tag->high_water_bytes = tag->used_bytes;
+		}
+
+		if (arena->high_water_bytes < arena->used_bytes) {
+			arena->high_water_bytes = arena->used_bytes;
+		}
+#endif
+	}
+
+	return result;
 }
 
+/**
+ * @brief Pushes a block right after the last one, with no alignment
+ *
+ * @param arena
+ * @param size_bytes
+ * @return void*
+ */
 void *arena_push(Arena *arena, size_t size_bytes)
 {
-	assert(arena->used_bytes + size_bytes <= arena->capacity_bytes);
+	void *result = arena_push_aligned(arena, size_bytes, 1);
+
+	return result;
+}
+
+/**
+ * @brief Pushes an aligned block that is all zero, only the part of it that was pushed before is cleared
+ *
+ * @param arena
+ * @param size_bytes
+ * @param alignment_bytes A power of two
+ * @return void* nullptr when arena_push_aligned fails
+ */
+void *arena_push_zero_aligned(Arena *arena, size_t size_bytes, size_t alignment_bytes)
+{
+	size_t dirty_bytes = arena->dirty_bytes;
+	unsigned char *result = arena_push_aligned(arena, size_bytes, alignment_bytes);
+	size_t offset_bytes = result ? (size_t)(result - arena->base_address) : dirty_bytes;
 
-	void *result = arena->base_address + arena->used_bytes;
-	arena->used_bytes += size_bytes;
+	if (dirty_bytes > offset_bytes) {
+		size_t clear_bytes = dirty_bytes - offset_bytes < size_bytes ? dirty_bytes - offset_bytes : size_bytes;
+		memset(result, 0, clear_bytes);
+	}
 
 	return result;
 }
 
 void *arena_push_zero(Arena *arena, size_t size_bytes)
 {
-	void *result = arena_push(arena, size_bytes);
+	void *result = arena_push_zero_aligned(arena, size_bytes, 1);
+
+	return result;
+}
+
+// Note(fredy): the freed blocks are filled with this in debug builds, a block that changes while it is free was
+// written through a stale pointer
+#define POOL_POISON_BYTE 0xCD
+
+#define POOL_INIT_ARRAY(pool, arena, type, count) \
+	pool_init((pool), (arena), sizeof(type) * (count), alignof(type))
+#define POOL_INIT_STRUCT(pool, arena, type) pool_init((pool), (arena), sizeof(type), alignof(type))
+
+typedef struct PoolNode {
+	struct PoolNode *next;
+} PoolNode;
+
+/**
+ * @brief Blocks of one size pushed on an arena, the freed ones are kept in a list inside of them and handed out
+ * again before pushing new ones. It is not thread safe, every thread needs its own pool
+ */
+typedef struct Pool {
+	Arena *arena;
+	size_t block_bytes;
+	size_t alignment_bytes;
+	PoolNode *first_free;
+
+	/**
+	 * @brief Blocks handed out and not freed yet
+	 */
+	uint32_t used_count;
+	uint32_t free_count;
+} Pool;
+
+/**
+ * @brief Pool of blocks that are pushed on the arena as they are needed
+ *
+ * @param pool
+ * @param arena
+ * @param size_bytes Size of a block, it grows to hold the free list link
+ * @param alignment_bytes A power of two
+ */
+void pool_init(Pool *restrict pool, Arena *restrict arena, size_t size_bytes, size_t alignment_bytes)
+{
+	assert(alignment_bytes && (alignment_bytes & (alignment_bytes - 1)) == 0);
+
+	if (alignment_bytes < alignof(PoolNode)) {
+		alignment_bytes = alignof(PoolNode);
+	}
+
+	if (size_bytes < sizeof(PoolNode)) {
+		size_bytes = sizeof(PoolNode);
+	}
+
+	pool->arena = arena;
+	pool->block_bytes = (size_bytes + alignment_bytes - 1) & ~(alignment_bytes - 1);
+	pool->alignment_bytes = alignment_bytes;
+	pool->first_free = nullptr;
+	pool->used_count = 0;
+	pool->free_count = 0;
+}
+
+/**
+ * @brief Takes a block, its content is whatever it had when it was freed
+ *
+ * @param pool
+ * @return void* nullptr when a new block could not be pushed on the arena
+ */
+void *pool_alloc(Pool *pool)
+{
+	void *result = pool->first_free;
+
+	if (result) {
+		pool->first_free = pool->first_free->next;
+		--pool->free_count;
+
+#if DEBUG
+		unsigned char *poison = (unsigned char *)result + sizeof(PoolNode);
+		for (size_t byte_idx = 0; byte_idx < pool->block_bytes - sizeof(PoolNode); ++byte_idx) {
+			assert(poison[byte_idx] == POOL_POISON_BYTE);
+		}
+
+		(void)poison;
+#endif
+	} else {
+		result = arena_push_aligned(pool->arena, pool->block_bytes, pool->alignment_bytes);
+	}
+
+	if (result) {
+		++pool->used_count;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Takes a block that is all zero
+ *
+ * @param pool
+ * @return void* nullptr when a new block could not be pushed on the arena
+ */
+void *pool_alloc_zero(Pool *pool)
+{
+	void *result = nullptr;
+
+	if (pool->first_free) {
+		result = pool_alloc(pool);
+		memset(result, 0, pool->block_bytes);
+	} else {
+		result = arena_push_zero_aligned(pool->arena, pool->block_bytes, pool->alignment_bytes);
+
+		if (result) {
+			++pool->used_count;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Gives a block back to the pool, the next allocation gets it first
+ *
+ * @param pool
+ * @param block Taken from this pool
+ */
+void pool_free(Pool *restrict pool, void *restrict block)
+{
+	assert(block);
+	assert(pool->used_count);
+	assert((unsigned char *)block >= pool->arena->base_address &&
+	       (unsigned char *)block + pool->block_bytes <= pool->arena->base_address + pool->arena->used_bytes);
 
-	memset(result, 0, size_bytes);
+#if DEBUG
+	memset(block, POOL_POISON_BYTE, pool->block_bytes);
+#endif
 
-	return nullptr;
+	PoolNode *node = block;
+	node->next = pool->first_free;
+	pool->first_free = node;
+
+	--pool->used_count;
+	++pool->free_count;
 }
 
 // =============================================================================
@@ -183,6 +761,16 @@ inline float float_square(float value)
 	return value * value;
 }
 
+/**
+ * @brief Linear interpolation, t = 0 gives a and t = 1 gives b
+ */
+inline float float_lerp(float a, float b, float t)
+{
+	float result = a + (b - a) * t;
+
+	return result;
+}
+
 inline unsigned int_abs(int value)
 {
 	// trick to avoid branches: (x ^ (x >> 31)) - (x >> 31)
@@ -346,6 +934,24 @@ inline Vtwo vtwo_add_scalar(Vtwo a, float s)
 	return result;
 }
 
+/**
+ * @brief Linear interpolation between two vectors
+ *
+ * @param a The vector at t = 0
+ * @param b The vector at t = 1
+ * @param t The interpolation factor
+ * @return Vtwo a + (b - a) * t
+ */
+inline Vtwo vtwo_lerp(Vtwo a, Vtwo b, float t)
+{
+	Vtwo result = {
+		.x = float_lerp(a.x, b.x, t),
+		.y = float_lerp(a.y, b.y, t),
+	};
+
+	return result;
+}
+
 /**
  * @brief Calculates the dot product between two bidimensional vectors
  *
@@ -442,6 +1048,115 @@ AppRect rectangle(Vtwo center, Vtwo dim)
 #define RING_IS_BETWEEN(start, end, test) \
 	((end) >= (start) ? ((test) >= (start) && (test) <= (end)) : ((test) >= (start) || (test) <= (end)))
 
+// =============================================================================
+// Work stealing deque
+// =============================================================================
+
+// Must be a power of two
+#define WORK_DEQUE_CAPACITY 256
+
+/**
+ * @brief Chase-Lev work stealing deque of pointers with a fixed capacity.
+ *
+ * Only the thread that owns the deque pushes and takes, at the bottom. Any other thread steals from the top.
+ * Memory orderings follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013).
+ */
+typedef struct WorkDeque {
+	// Note(fredy): top and bottom on their own cache lines so the thieves do not invalidate the owner's line
+	alignas(64) _Atomic int64_t top;
+	alignas(64) _Atomic int64_t bottom;
+	alignas(64) _Atomic(void *) items[WORK_DEQUE_CAPACITY];
+} WorkDeque;
+
+void work_deque_init(WorkDeque *deque)
+{
+	atomic_init(&deque->top, 0);
+	atomic_init(&deque->bottom, 0);
+
+	for (uint32_t item_idx = 0; item_idx < WORK_DEQUE_CAPACITY; ++item_idx) {
+		atomic_init(&deque->items[item_idx], nullptr);
+	}
+}
+
+/**
+ * @brief Pushes an item at the bottom of the deque. Only the owner thread can push.
+ *
+ * @return uint32_t 1 if the item was pushed, 0 if the deque is full
+ */
+uint32_t work_deque_push(WorkDeque *deque, void *item)
+{
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+	if (bottom - top >= WORK_DEQUE_CAPACITY) {
+		return 0U;
+	}
+
+	atomic_store_explicit(&deque->items[bottom & (WORK_DEQUE_CAPACITY - 1)], item, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+	return 1U;
+}
+
+/**
+ * @brief Takes the last pushed item. Only the owner thread can take.
+ *
+ * @return void* The item, nullptr if the deque is empty
+ */
+void *work_deque_take(WorkDeque *deque)
+{
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	void *result = nullptr;
+
+	if (top <= bottom) {
+		result = atomic_load_explicit(&deque->items[bottom & (WORK_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+
+		if (top == bottom) {
+			// Note(fredy): last item, race against the thieves for it
+			if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+			                                             memory_order_relaxed)) {
+				result = nullptr;
+			}
+
+			atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+		}
+	} else {
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Steals the first pushed item. Any thread can steal.
+ *
+ * @return void* The item, nullptr if the deque is empty or another thread won the item
+ */
+void *work_deque_steal(WorkDeque *deque)
+{
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+	void *result = nullptr;
+
+	if (top < bottom) {
+		result = atomic_load_explicit(&deque->items[top & (WORK_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+
+		if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+		                                             memory_order_relaxed)) {
+			result = nullptr;
+		}
+	}
+
+	return result;
+}
+
 // =============================================================================
 // String
 // =============================================================================
@@ -483,6 +1198,13 @@ void string_concat(const size_t one_count, const char *const restrict one, const
 #define LOG_LEVEL LOG_LEVEL_ALL
 #endif // LOG_LEVEL
 
+// Note(fredy): the C library of Windows only has the bounds checked version, which returns an error code
+#ifdef _WIN32
+#define IMPL_LOG_GMTIME(_pr_time, _pr_tm) gmtime_s((_pr_tm), (_pr_time))
+#else
+#define IMPL_LOG_GMTIME(_pr_time, _pr_tm) (gmtime_r((_pr_time), (_pr_tm)) == nullptr)
+#endif
+
 #if DEBUG
 #define IMPL_LOG_WRITE(fmt, ...)                                                     \
 	do {                                                                         \
@@ -505,7 +1227,7 @@ void string_concat(const size_t one_count, const char *const restrict one, const
 		if (!timespec_get(&_pr_ts, TIME_UTC)) {                                                        \
 			break;                                                                                 \
 		}                                                                                              \
-		if (gmtime_s(&_pr_tm, &_pr_ts.tv_sec)) {                                                       \
+		if (IMPL_LOG_GMTIME(&_pr_ts.tv_sec, &_pr_tm)) {                                                \
 			break;                                                                                 \
 		}                                                                                              \
 		if (strftime(_pr_tstamp_str, LOG_TSTAMP_BUF_SIZE_BYTES, "%FT%T", &_pr_tm) == 0) {              \
@@ -633,4 +1355,41 @@ uint32_t uint_rotl(uint32_t value, int32_t shift)
 	return result;
 }
 
+// =============================================================================
+// Hashing
+// =============================================================================
+
+/**
+ * @brief Mixes a 64-bit value into a hash. It is fast and spreads every bit, it is not meant to be secure.
+ *
+ * @param hash The hash so far
+ * @param value The value to mix in
+ * @return uint64_t The new hash
+ *
+ * @example
+ * uint64_t h = hash_mix(hash_mix(seed, x), y);
+ */
+uint64_t hash_mix(uint64_t hash, uint64_t value)
+{
+	uint64_t result = (hash ^ value) * 0xFF51AFD7ED558CCDULL;
+	result ^= result >> 33;
+	result *= 0xC4CEB9FE1A85EC53ULL;
+	result ^= result >> 29;
+
+	return result;
+}
+
+/**
+ * @brief Mixes the bits of a float into a hash, so two floats only hash the same if they are bit-exact
+ */
+uint64_t hash_mix_float(uint64_t hash, float value)
+{
+	uint32_t bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint64_t result = hash_mix(hash, bits);
+
+	return result;
+}
+
 #endif // LIB_H
@@ -0,0 +1,1648 @@
+/*
+* Benchmarks of the game code, built by misc/build.bat and misc/build.sh. Every benchmark runs the code of the game
+* and the code it replaced on the same inputs, then prints the time per call of both.
+* Usage: bench [collision|streams|path|spatial|rays|positions|flow]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+#endif
+
+// Note(fredy): the game is built with its world in the middle of the tile space, far from the tile 0
+#define WORLD_ORIGIN_X_TL (UINT32_MAX / 2)
+#define WORLD_ORIGIN_Y_TL (UINT32_MAX / 2)
+
+#include "../src/app.c"
+
+#define BENCH_OBSTACLE_SIZE_COUNT 3U
+#define BENCH_OBSTACLE_COUNT_MAX 1000U
+#define BENCH_OBSTACLE_CAPACITY \
+	((BENCH_OBSTACLE_COUNT_MAX + COLLISION_LANES - 1) / COLLISION_LANES * COLLISION_LANES)
+
+#define BENCH_SWEEP_COUNT 1024U
+#define BENCH_SWEEP_REPEATS 20U
+
+// Half side of the square where the obstacles and the movers are placed
+#define BENCH_SCENE_HALF_SIDE_M 20.0F
+
+#define BENCH_ENTITY_SIZE_COUNT 3U
+#define BENCH_ENTITY_COUNT_MAX (1U << 20)
+
+// Every size scans about this many entities, so the small sizes are repeated more
+#define BENCH_ENTITY_SCAN_COUNT (1U << 26)
+
+// Side of the square of tiles where the entities are placed
+#define BENCH_ENTITY_SIDE_TL 4096U
+
+#define BENCH_PATH_MAP_COUNT 2U
+#define BENCH_PATH_QUERY_COUNT 2000U
+
+// Queries whose path is checked against the optimal one, the reference search is slow
+#define BENCH_PATH_CHECK_COUNT 200U
+
+#define BENCH_GAME_ARENA_BYTES GB_TO_BYTES(1ULL)
+#define BENCH_SCRATCH_ARENA_BYTES MB_TO_BYTES(64ULL)
+#define BENCH_MAP_SIZE_TL (MAP_SIDE_X_TL * MAP_SIDE_Y_TL)
+
+static uint64_t bench_get_ns(void)
+{
+	struct timespec now = {};
+	(void)timespec_get(&now, TIME_UTC);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Xorshift, the benchmarks only need the same inputs on every run
+ */
+static uint32_t bench_random(uint32_t *state)
+{
+	uint32_t result = *state;
+	result ^= result << 13;
+	result ^= result >> 17;
+	result ^= result << 5;
+	*state = result;
+
+	return result;
+}
+
+static float bench_random_float(uint32_t *state, float min, float max)
+{
+	float unit = (float)(bench_random(state) >> 8) / (float)(1U << 24);
+
+	return min + unit * (max - min);
+}
+
+/**
+ * @brief Opens the hardware counter of the cache misses of this thread
+ *
+ * @return int -1 when the platform, the kernel or the machine do not have it
+ */
+static int bench_open_cache_misses(void)
+{
+	int result = -1;
+
+#ifdef __linux__
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.size = sizeof(attr),
+		.config = PERF_COUNT_HW_CACHE_MISSES,
+		.disabled = 1,
+		.exclude_kernel = 1,
+		.exclude_hv = 1,
+	};
+
+	result = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+
+	return result;
+}
+
+static void bench_start_counter(int counter_fd)
+{
+#ifdef __linux__
+	if (counter_fd >= 0) {
+		(void)ioctl(counter_fd, PERF_EVENT_IOC_RESET, 0);
+		(void)ioctl(counter_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#else
+	(void)counter_fd;
+#endif
+}
+
+/**
+ * @return uint64_t UINT64_MAX when the counter is not available
+ */
+static uint64_t bench_stop_counter(int counter_fd)
+{
+	uint64_t result = UINT64_MAX;
+
+#ifdef __linux__
+	if (counter_fd >= 0) {
+		(void)ioctl(counter_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+		if (read(counter_fd, &result, sizeof(result)) != sizeof(result)) {
+			result = UINT64_MAX;
+		}
+	}
+#else
+	(void)counter_fd;
+#endif
+
+	return result;
+}
+
+static void bench_close_counter(int counter_fd)
+{
+#ifdef __linux__
+	if (counter_fd >= 0) {
+		(void)close(counter_fd);
+	}
+#else
+	(void)counter_fd;
+#endif
+}
+
+// =============================================================================
+// Collision
+// =============================================================================
+
+typedef struct BenchObstacles {
+	float center_x[BENCH_OBSTACLE_CAPACITY];
+	float center_y[BENCH_OBSTACLE_CAPACITY];
+	float half_width[BENCH_OBSTACLE_CAPACITY];
+	float half_height[BENCH_OBSTACLE_CAPACITY];
+	uint32_t collides_mask[BENCH_OBSTACLE_CAPACITY];
+} BenchObstacles;
+
+typedef struct BenchSweep {
+	Vtwo pos;
+	Vtwo half_dim;
+	Vtwo displacement;
+} BenchSweep;
+
+/**
+ * @brief The wall test the game used before collision_sweep, one wall of one obstacle at a time
+ */
+static uint32_t bench_wall_test(float wall_x, float rel_x, float rel_y, float delta_x, float delta_y,
+                                float *max_time, float min_y, float max_y)
+{
+	uint32_t was_wall_hit = 0U;
+	float t_epsilon = 0.001F;
+
+	if (delta_x != 0.0F) {
+		float t_result = (wall_x - rel_x) / delta_x;
+		float y = delta_y * t_result + rel_y;
+
+		if (t_result >= 0.0F && *max_time > t_result && y >= min_y && y <= max_y) {
+			*max_time = NUMBER_MAX(0.0F, t_result - t_epsilon);
+			was_wall_hit = 1U;
+		}
+	}
+
+	return was_wall_hit;
+}
+
+/**
+ * @brief The scalar loop collision_sweep replaced, it keeps the last obstacle hit at the earliest time
+ */
+static SweepHit bench_collision_sweep_scalar(const BenchObstacles *obstacles, uint32_t obstacle_count,
+                                             const BenchSweep *sweep)
+{
+	SweepHit result = {
+		.time = 1.0F,
+		.obstacle_idx = UINT32_MAX,
+	};
+
+	for (uint32_t obstacle_idx = 0; obstacle_idx < obstacle_count; ++obstacle_idx) {
+		if (obstacles->collides_mask[obstacle_idx]) {
+			Vtwo radius = {
+				.x = obstacles->half_width[obstacle_idx] + sweep->half_dim.x,
+				.y = obstacles->half_height[obstacle_idx] + sweep->half_dim.y,
+			};
+			Vtwo rel = {
+				.x = sweep->pos.x - obstacles->center_x[obstacle_idx],
+				.y = sweep->pos.y - obstacles->center_y[obstacle_idx],
+			};
+			Vtwo delta = sweep->displacement;
+			float *time = &result.time;
+
+			if (bench_wall_test(-radius.x, rel.x, rel.y, delta.x, delta.y, time, -radius.y, radius.y)) {
+				result.normal = (Vtwo){ .x = -1.0F, .y = 0.0F };
+				result.obstacle_idx = obstacle_idx;
+			}
+
+			if (bench_wall_test(radius.x, rel.x, rel.y, delta.x, delta.y, time, -radius.y, radius.y)) {
+				result.normal = (Vtwo){ .x = 1.0F, .y = 0.0F };
+				result.obstacle_idx = obstacle_idx;
+			}
+
+			if (bench_wall_test(-radius.y, rel.y, rel.x, delta.y, delta.x, time, -radius.x, radius.x)) {
+				result.normal = (Vtwo){ .x = 0.0F, .y = -1.0F };
+				result.obstacle_idx = obstacle_idx;
+			}
+
+			if (bench_wall_test(radius.y, rel.y, rel.x, delta.y, delta.x, time, -radius.x, radius.x)) {
+				result.normal = (Vtwo){ .x = 0.0F, .y = 1.0F };
+				result.obstacle_idx = obstacle_idx;
+			}
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Sweeps random movers against 10, 100 and 1000 random obstacles, with the scalar loop and with
+ * collision_sweep. A mismatch is a different obstacle hit at a time that is not a tie within the epsilon
+ */
+static void bench_collision(void)
+{
+	static BenchObstacles obstacles;
+	static BenchSweep sweeps[BENCH_SWEEP_COUNT];
+	static SweepHit scalar_hits[BENCH_SWEEP_COUNT];
+	static SweepHit simd_hits[BENCH_SWEEP_COUNT];
+	const uint32_t obstacle_counts[BENCH_OBSTACLE_SIZE_COUNT] = { 10, 100, BENCH_OBSTACLE_COUNT_MAX };
+
+	printf("collision: ns per sweep, collision_sweep %s\n", LIB_SIMD_AVX2 ? "with avx2" : "without avx2");
+	printf("%10s %10s %10s %8s %11s\n", "obstacles", "scalar", "sweep", "speedup", "mismatches");
+
+	for (uint32_t count_idx = 0; count_idx < BENCH_OBSTACLE_SIZE_COUNT; ++count_idx) {
+		uint32_t obstacle_count = obstacle_counts[count_idx];
+		uint32_t padded_count = (obstacle_count + COLLISION_LANES - 1) / COLLISION_LANES * COLLISION_LANES;
+		uint32_t random_state = 0x9E3779B9U;
+
+		memset(&obstacles, 0, sizeof(obstacles));
+		for (uint32_t obstacle_idx = 0; obstacle_idx < obstacle_count; ++obstacle_idx) {
+			obstacles.center_x[obstacle_idx] =
+				bench_random_float(&random_state, -BENCH_SCENE_HALF_SIDE_M, BENCH_SCENE_HALF_SIDE_M);
+			obstacles.center_y[obstacle_idx] =
+				bench_random_float(&random_state, -BENCH_SCENE_HALF_SIDE_M, BENCH_SCENE_HALF_SIDE_M);
+			obstacles.half_width[obstacle_idx] = 0.5F * TILE_SIDE_M;
+			obstacles.half_height[obstacle_idx] = 0.5F * TILE_SIDE_M;
+			obstacles.collides_mask[obstacle_idx] = UINT32_MAX;
+		}
+
+		for (uint32_t sweep_idx = 0; sweep_idx < BENCH_SWEEP_COUNT; ++sweep_idx) {
+			BenchSweep *sweep = &sweeps[sweep_idx];
+			sweep->pos.x = bench_random_float(&random_state, -BENCH_SCENE_HALF_SIDE_M,
+			                                  BENCH_SCENE_HALF_SIDE_M);
+			sweep->pos.y = bench_random_float(&random_state, -BENCH_SCENE_HALF_SIDE_M,
+			                                  BENCH_SCENE_HALF_SIDE_M);
+			sweep->half_dim = (Vtwo){ .x = HERO_WIDTH_RADIUS_M, .y = HERO_HEIGHT_RADIUS_M };
+			sweep->displacement.x = bench_random_float(&random_state, -2.0F, 2.0F);
+			sweep->displacement.y = bench_random_float(&random_state, -2.0F, 2.0F);
+		}
+
+		uint64_t scalar_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < BENCH_SWEEP_REPEATS; ++repeat_idx) {
+			for (uint32_t sweep_idx = 0; sweep_idx < BENCH_SWEEP_COUNT; ++sweep_idx) {
+				scalar_hits[sweep_idx] =
+					bench_collision_sweep_scalar(&obstacles, obstacle_count, &sweeps[sweep_idx]);
+			}
+		}
+		uint64_t scalar_ns = bench_get_ns() - scalar_start_ns;
+
+		uint64_t simd_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < BENCH_SWEEP_REPEATS; ++repeat_idx) {
+			for (uint32_t sweep_idx = 0; sweep_idx < BENCH_SWEEP_COUNT; ++sweep_idx) {
+				const BenchSweep *sweep = &sweeps[sweep_idx];
+				simd_hits[sweep_idx] =
+					collision_sweep(obstacles.center_x, obstacles.center_y, obstacles.half_width,
+					                obstacles.half_height, obstacles.collides_mask, padded_count,
+					                UINT32_MAX, sweep->pos, sweep->half_dim, sweep->displacement);
+			}
+		}
+		uint64_t simd_ns = bench_get_ns() - simd_start_ns;
+
+		uint32_t mismatch_count = 0;
+		for (uint32_t sweep_idx = 0; sweep_idx < BENCH_SWEEP_COUNT; ++sweep_idx) {
+			SweepHit scalar_hit = scalar_hits[sweep_idx];
+			SweepHit simd_hit = simd_hits[sweep_idx];
+
+			if (scalar_hit.obstacle_idx != simd_hit.obstacle_idx &&
+			    fabsf(scalar_hit.time - simd_hit.time) > 0.001F) {
+				++mismatch_count;
+			}
+		}
+
+		double call_count = (double)(BENCH_SWEEP_COUNT * BENCH_SWEEP_REPEATS);
+		double scalar_call_ns = (double)scalar_ns / call_count;
+		double simd_call_ns = (double)simd_ns / call_count;
+		printf("%10u %10.1f %10.1f %7.2fx %11u\n", obstacle_count, scalar_call_ns, simd_call_ns,
+		       scalar_call_ns / simd_call_ns, mismatch_count);
+	}
+}
+
+// =============================================================================
+// Entity streams
+// =============================================================================
+
+/**
+ * @brief DormantEntity as it was before the hot and cold streams, the game kept all of it in a single array
+ */
+typedef struct BenchDormantEntity {
+	Position pos;
+	float width_m;
+	float height_m;
+
+	int32_t delta_tile_z;
+	uint8_t collides;
+
+	EntityType entity_type;
+} BenchDormantEntity;
+
+/**
+ * @brief Counts the entities around @p center, it reads only the positions like the spatial queries and the camera
+ * do. @p stride_bytes is the distance between two positions
+ */
+static uint32_t bench_streams_count_near(const unsigned char *first_pos, size_t stride_bytes, uint32_t entity_count,
+                                         Position center, float radius_m)
+{
+	uint32_t result = 0;
+	float radius_sq = radius_m * radius_m;
+
+	for (uint32_t entity_idx = 0; entity_idx < entity_count; ++entity_idx) {
+		const Position *pos = (const Position *)(first_pos + entity_idx * stride_bytes);
+		PositionDelta delta = position_substract(pos, &center);
+
+		result += vtwo_dot(delta.delta_xy_m, delta.delta_xy_m) <= radius_sq;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Scans the positions of 256 (MAX_ENTITIES), 64K and 1M entities, from the old single array and from the
+ * position stream
+ */
+static void bench_streams(void)
+{
+	const uint32_t entity_counts[BENCH_ENTITY_SIZE_COUNT] = { MAX_ENTITIES, 1U << 16, BENCH_ENTITY_COUNT_MAX };
+	BenchDormantEntity *dormant_entities = malloc(BENCH_ENTITY_COUNT_MAX * sizeof(BenchDormantEntity));
+	Position *positions = malloc(BENCH_ENTITY_COUNT_MAX * sizeof(Position));
+
+	if (!dormant_entities || !positions) {
+		printf("streams: failed to allocate the entities\n");
+		free(positions);
+		free(dormant_entities);
+
+		return;
+	}
+
+	int counter_fd = bench_open_cache_misses();
+
+	Position center = { .tile_x = BENCH_ENTITY_SIDE_TL / 2, .tile_y = BENCH_ENTITY_SIDE_TL / 2 };
+	float radius_m = 64.0F * TILE_SIDE_M;
+
+	printf("streams: ns and cache misses per entity, %zu bytes per entity before, %zu after\n",
+	       sizeof(BenchDormantEntity), sizeof(Position));
+	if (counter_fd < 0) {
+		printf("the cache miss counter is not available, the misses are not shown\n");
+	}
+	printf("%10s %10s %10s %8s %12s %12s\n", "entities", "array", "stream", "speedup", "array miss", "stream miss");
+
+	for (uint32_t count_idx = 0; count_idx < BENCH_ENTITY_SIZE_COUNT; ++count_idx) {
+		uint32_t entity_count = entity_counts[count_idx];
+		uint32_t repeat_count = BENCH_ENTITY_SCAN_COUNT / entity_count;
+		uint32_t random_state = 0x9E3779B9U;
+
+		for (uint32_t entity_idx = 0; entity_idx < entity_count; ++entity_idx) {
+			Position pos = {
+				.tile_x = bench_random(&random_state) % BENCH_ENTITY_SIDE_TL,
+				.tile_y = bench_random(&random_state) % BENCH_ENTITY_SIDE_TL,
+			};
+			pos.offset_m.x = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+			pos.offset_m.y = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+
+			positions[entity_idx] = pos;
+			dormant_entities[entity_idx] = (BenchDormantEntity){
+				.pos = pos,
+				.width_m = TILE_SIDE_M,
+				.height_m = TILE_SIDE_M,
+				.collides = 1U,
+				.entity_type = ENTITY_TYPE_WALL,
+			};
+		}
+
+		uint32_t array_near_count = 0;
+		bench_start_counter(counter_fd);
+		uint64_t array_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < repeat_count; ++repeat_idx) {
+			array_near_count += bench_streams_count_near((const unsigned char *)&dormant_entities[0].pos,
+			                                             sizeof(BenchDormantEntity), entity_count, center,
+			                                             radius_m);
+		}
+		uint64_t array_ns = bench_get_ns() - array_start_ns;
+		uint64_t array_misses = bench_stop_counter(counter_fd);
+
+		uint32_t stream_near_count = 0;
+		bench_start_counter(counter_fd);
+		uint64_t stream_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < repeat_count; ++repeat_idx) {
+			stream_near_count += bench_streams_count_near((const unsigned char *)&positions[0],
+			                                              sizeof(Position), entity_count, center, radius_m);
+		}
+		uint64_t stream_ns = bench_get_ns() - stream_start_ns;
+		uint64_t stream_misses = bench_stop_counter(counter_fd);
+
+		if (array_near_count != stream_near_count) {
+			printf("the two layouts found a different number of entities\n");
+		}
+
+		double scan_count = (double)repeat_count * (double)entity_count;
+		double array_entity_ns = (double)array_ns / scan_count;
+		double stream_entity_ns = (double)stream_ns / scan_count;
+		printf("%10u %10.2f %10.2f %7.2fx", entity_count, array_entity_ns, stream_entity_ns,
+		       array_entity_ns / stream_entity_ns);
+
+		if (array_misses != UINT64_MAX && stream_misses != UINT64_MAX) {
+			printf(" %12.4f %12.4f", (double)array_misses / scan_count, (double)stream_misses / scan_count);
+		}
+		printf("\n");
+	}
+
+	bench_close_counter(counter_fd);
+	free(positions);
+	free(dormant_entities);
+}
+
+// =============================================================================
+// Pathfinding
+// =============================================================================
+
+typedef enum BenchPathMap : uint8_t {
+	BENCH_PATH_MAP_NOISE,
+	BENCH_PATH_MAP_ROOMS,
+} BenchPathMap;
+
+/**
+ * @brief The first pass builds the graphs of the chunks, the second one times the queries on them and the last one
+ * compares some of the paths with the shortest ones
+ */
+typedef enum BenchPathPass : uint8_t {
+	BENCH_PATH_PASS_COLD,
+	BENCH_PATH_PASS_WARM,
+	BENCH_PATH_PASS_CHECK,
+	BENCH_PATH_PASS_COUNT,
+} BenchPathPass;
+
+/**
+ * @brief Search of the shortest path over the tiles, the reference the paths of the game are compared with
+ */
+typedef struct BenchPathReference {
+	uint32_t *costs;
+	uint32_t *search_idxs;
+	uint32_t search_idx;
+	PathHeap open;
+} BenchPathReference;
+
+/**
+ * @brief Game with an empty map, the pathfinding and the spatial index only need the map and the arena
+ */
+static Game *bench_init_game(void)
+{
+	Game *result = calloc(1, sizeof(Game));
+	unsigned char *arena_base = calloc(1, BENCH_GAME_ARENA_BYTES);
+
+	if (result && arena_base) {
+		// Note(fredy): the memory of the arena comes from calloc, what is pushed on it starts zeroed
+		arena_init(&result->arena, BENCH_GAME_ARENA_BYTES, arena_base);
+		result->world = ARENA_PUSH_STRUCT(&result->arena, World);
+		result->world->map = ARENA_PUSH_STRUCT(&result->arena, Map);
+
+		Map *map = result->world->map;
+		map->chunks = ARENA_PUSH_ARRAY(&result->arena, TileChunk, (size_t)MAP_SIZE_CHK);
+		POOL_INIT_ARRAY(&map->tile_pool, &result->arena, uint32_t, (size_t)CHUNK_SIZE_TL);
+	} else {
+		free(result);
+		free(arena_base);
+		result = nullptr;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Fills the level 0 of the map. The noise map has 22% of walls and long walls with gaps every 64 tiles over
+ * a quarter of the map, the rest is out of it. The rooms map is the 17x9 rooms of the game with random doors over
+ * the whole map, the paths can wrap around it
+ */
+static void bench_path_fill_map(Game *game, BenchPathMap map_type)
+{
+	Map *map = game->world->map;
+	uint32_t random_state = 1234567U;
+	uint32_t side_tl = map_type == BENCH_PATH_MAP_NOISE ? MAP_SIDE_X_TL / 2 : MAP_SIDE_X_TL;
+
+	for (uint32_t tile_y = 0; tile_y < side_tl; ++tile_y) {
+		for (uint32_t tile_x = 0; tile_x < side_tl; ++tile_x) {
+			TileType tile_type = TILE_TYPE_EMPTY;
+
+			if (map_type == BENCH_PATH_MAP_NOISE) {
+				uint32_t is_wall = bench_random(&random_state) % 100 < 22;
+				uint32_t is_long_wall = (tile_x % 64 == 0 || tile_y % 64 == 0) &&
+				                        bench_random(&random_state) % 8 != 0;
+				tile_type = is_wall || is_long_wall ? TILE_TYPE_WALL : TILE_TYPE_EMPTY;
+			} else {
+				uint32_t room_x = tile_x % 17;
+				uint32_t room_y = tile_y % 9;
+				uint32_t room_hash = (tile_x / 17) * 7919U + (tile_y / 9) * 104729U;
+				room_hash ^= room_hash >> 7;
+				room_hash *= 2654435761U;
+
+				uint32_t is_door = (room_x == 0 && room_y == 4 && (room_hash & 3)) ||
+				                   (room_y == 0 && room_x == 8 && ((room_hash >> 4) & 3));
+				tile_type = (room_x == 0 || room_y == 0) && !is_door ? TILE_TYPE_WALL : TILE_TYPE_EMPTY;
+			}
+
+			map_set_tile_value(map, tile_x, tile_y, 0, tile_type);
+		}
+	}
+}
+
+static Position bench_path_random_tile(Map *map, uint32_t *random_state, uint32_t side_tl)
+{
+	Position result = {};
+
+	do {
+		result.tile_x = bench_random(random_state) % side_tl;
+		result.tile_y = bench_random(random_state) % side_tl;
+	} while (!map_is_tile_walkable(map, result.tile_x, result.tile_y, 0));
+
+	return result;
+}
+
+/**
+ * @brief A* over the tiles of the level 0 with the same moves as the game, 8 directions without cutting corners
+ *
+ * @return uint32_t Cost of the shortest path, PATH_TILE_NONE when there is none
+ */
+static uint32_t bench_path_reference_cost(Map *map, BenchPathReference *reference, Position start, Position goal)
+{
+	uint32_t result = PATH_TILE_NONE;
+	uint32_t start_key = start.tile_y * MAP_SIDE_X_TL + start.tile_x;
+	uint32_t goal_key = goal.tile_y * MAP_SIDE_X_TL + goal.tile_x;
+
+	++reference->search_idx;
+	reference->open.count = 0;
+	reference->costs[start_key] = 0;
+	reference->search_idxs[start_key] = reference->search_idx;
+	path_heap_push(&reference->open,
+	               path_get_octile_cost(path_get_map_delta(start.tile_x, goal.tile_x, MAP_SIDE_X_TL),
+	                                    path_get_map_delta(start.tile_y, goal.tile_y, MAP_SIDE_Y_TL)),
+	               start_key);
+
+	while (reference->open.count > 0 && result == PATH_TILE_NONE) {
+		PathHeapEntry entry = path_heap_pop(&reference->open);
+		uint32_t tile_x = entry.key % MAP_SIDE_X_TL;
+		uint32_t tile_y = entry.key / MAP_SIDE_X_TL;
+		uint32_t cost = reference->costs[entry.key];
+		uint32_t heuristic = path_get_octile_cost(path_get_map_delta(tile_x, goal.tile_x, MAP_SIDE_X_TL),
+		                                          path_get_map_delta(tile_y, goal.tile_y, MAP_SIDE_Y_TL));
+
+		if (entry.key == goal_key) {
+			result = cost;
+		} else if (entry.priority == cost + heuristic) {
+			for (int32_t delta_y = -1; delta_y <= 1; ++delta_y) {
+				for (int32_t delta_x = -1; delta_x <= 1; ++delta_x) {
+					uint32_t next_x = (tile_x + (uint32_t)delta_x) & (MAP_SIDE_X_TL - 1);
+					uint32_t next_y = (tile_y + (uint32_t)delta_y) & (MAP_SIDE_Y_TL - 1);
+					uint32_t next_key = next_y * MAP_SIDE_X_TL + next_x;
+					uint32_t next_cost = cost;
+					next_cost += delta_x && delta_y ? PATH_COST_DIAGONAL : PATH_COST_STRAIGHT;
+
+					if ((delta_x || delta_y) && map_is_tile_walkable(map, next_x, next_y, 0) &&
+					    map_is_tile_walkable(map, next_x, tile_y, 0) &&
+					    map_is_tile_walkable(map, tile_x, next_y, 0) &&
+					    (reference->search_idxs[next_key] != reference->search_idx ||
+					     next_cost < reference->costs[next_key])) {
+						uint32_t next_heuristic = path_get_octile_cost(
+							path_get_map_delta(next_x, goal.tile_x, MAP_SIDE_X_TL),
+							path_get_map_delta(next_y, goal.tile_y, MAP_SIDE_Y_TL));
+
+						reference->costs[next_key] = next_cost;
+						reference->search_idxs[next_key] = reference->search_idx;
+						path_heap_push(&reference->open, next_cost + next_heuristic, next_key);
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Walks the waypoints of a path, every step has to be straight or diagonal over walkable tiles without
+ * cutting corners and the last one has to be the goal
+ *
+ * @return uint32_t Cost of the path, PATH_TILE_NONE when it is not valid
+ */
+static uint32_t bench_path_walk(Map *map, PathResult path, Position start, Position goal)
+{
+	uint32_t result = 0;
+	uint32_t tile_x = start.tile_x;
+	uint32_t tile_y = start.tile_y;
+
+	for (uint32_t waypoint_idx = 0; waypoint_idx < path.count && result != PATH_TILE_NONE; ++waypoint_idx) {
+		Position waypoint = path.waypoints[waypoint_idx];
+		int32_t delta_x = (int32_t)(waypoint.tile_x - tile_x);
+		int32_t delta_y = (int32_t)(waypoint.tile_y - tile_y);
+		int32_t step_x = (delta_x > 0) - (delta_x < 0);
+		int32_t step_y = (delta_y > 0) - (delta_y < 0);
+		uint32_t step_count = NUMBER_MAX(int_abs(delta_x), int_abs(delta_y));
+
+		if (delta_x && delta_y && int_abs(delta_x) != int_abs(delta_y)) {
+			result = PATH_TILE_NONE;
+		} else {
+			result += path_get_octile_cost(delta_x, delta_y);
+		}
+
+		for (uint32_t step_idx = 0; step_idx < step_count && result != PATH_TILE_NONE; ++step_idx) {
+			uint32_t next_x = tile_x + (uint32_t)step_x;
+			uint32_t next_y = tile_y + (uint32_t)step_y;
+
+			if (!map_is_tile_walkable(map, next_x, next_y, 0) ||
+			    !map_is_tile_walkable(map, next_x, tile_y, 0) ||
+			    !map_is_tile_walkable(map, tile_x, next_y, 0)) {
+				result = PATH_TILE_NONE;
+			}
+
+			tile_x = next_x;
+			tile_y = next_y;
+		}
+	}
+
+	if (((tile_x ^ goal.tile_x) & (MAP_SIDE_X_TL - 1)) || ((tile_y ^ goal.tile_y) & (MAP_SIDE_Y_TL - 1))) {
+		result = PATH_TILE_NONE;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Times random queries on a map with holes and on a map of rooms
+ */
+static void bench_path(void)
+{
+	static const char *map_names[BENCH_PATH_MAP_COUNT] = { "noise", "rooms" };
+	static const char *pass_names[BENCH_PATH_PASS_COUNT] = { "cold", "warm", "check" };
+	BenchPathReference reference = {
+		.costs = malloc(BENCH_MAP_SIZE_TL * sizeof(uint32_t)),
+		.search_idxs = calloc(BENCH_MAP_SIZE_TL, sizeof(uint32_t)),
+		.open = {
+			.entries = malloc(8 * BENCH_MAP_SIZE_TL * sizeof(PathHeapEntry)),
+			.capacity = 8 * BENCH_MAP_SIZE_TL,
+		},
+	};
+	unsigned char *scratch_base = malloc(THREAD_SCRATCH_ARENA_COUNT * BENCH_SCRATCH_ARENA_BYTES);
+	unsigned char *waypoints_base = malloc(BENCH_SCRATCH_ARENA_BYTES);
+
+	if (!reference.costs || !reference.search_idxs || !reference.open.entries || !scratch_base ||
+	    !waypoints_base) {
+		printf("path: failed to allocate the searches\n");
+		free(waypoints_base);
+		free(scratch_base);
+		free(reference.open.entries);
+		free(reference.search_idxs);
+		free(reference.costs);
+
+		return;
+	}
+
+	Arena scratch_arenas[THREAD_SCRATCH_ARENA_COUNT] = {};
+	ThreadContext thread = {};
+	for (uint32_t scratch_idx = 0; scratch_idx < THREAD_SCRATCH_ARENA_COUNT; ++scratch_idx) {
+		arena_init(&scratch_arenas[scratch_idx], BENCH_SCRATCH_ARENA_BYTES,
+		           scratch_base + scratch_idx * BENCH_SCRATCH_ARENA_BYTES);
+		thread.scratch_arenas[scratch_idx] = &scratch_arenas[scratch_idx];
+	}
+
+	// Note(fredy): the search state goes to a scratch arena of the thread, the waypoints are emptied every query
+	Arena waypoints_arena = {};
+	arena_init(&waypoints_arena, BENCH_SCRATCH_ARENA_BYTES, waypoints_base);
+
+	printf("path: ms per query, %u queries\n", BENCH_PATH_QUERY_COUNT);
+	printf("%6s %6s %8s %8s %8s %8s %8s %8s\n", "map", "pass", "average", "worst", "found", "invalid", "cost",
+	       "worst");
+
+	for (uint32_t map_idx = 0; map_idx < BENCH_PATH_MAP_COUNT; ++map_idx) {
+		Game *game = bench_init_game();
+
+		if (!game) {
+			printf("path: failed to allocate the game\n");
+			break;
+		}
+
+		Map *map = game->world->map;
+		uint32_t side_tl = map_idx == BENCH_PATH_MAP_NOISE ? MAP_SIDE_X_TL / 2 : MAP_SIDE_X_TL;
+		bench_path_fill_map(game, (BenchPathMap)map_idx);
+
+		// Note(fredy): the reference search goes through lots of memory, it runs on a pass that is not timed
+		for (uint32_t pass_idx = 0; pass_idx < BENCH_PATH_PASS_COUNT; ++pass_idx) {
+			uint32_t random_state = 7654321U;
+			uint32_t query_count = pass_idx == BENCH_PATH_PASS_CHECK ? BENCH_PATH_CHECK_COUNT
+			                                                         : BENCH_PATH_QUERY_COUNT;
+			uint32_t found_count = 0;
+			uint32_t invalid_count = 0;
+			uint64_t total_ns = 0;
+			uint64_t worst_ns = 0;
+			double cost_ratio_sum = 0.0;
+			double cost_ratio_worst = 0.0;
+			uint32_t checked_count = 0;
+
+			for (uint32_t query_idx = 0; query_idx < query_count; ++query_idx) {
+				Position start = bench_path_random_tile(map, &random_state, side_tl);
+				Position goal = bench_path_random_tile(map, &random_state, side_tl);
+
+				arena_reset(&waypoints_arena);
+				uint64_t start_ns = bench_get_ns();
+				PathResult path = path_find(game, &thread, &waypoints_arena, start, goal);
+				uint64_t query_ns = bench_get_ns() - start_ns;
+
+				total_ns += query_ns;
+				worst_ns = NUMBER_MAX(worst_ns, query_ns);
+
+				uint32_t cost = bench_path_walk(map, path, start, goal);
+				uint32_t is_found = path.count > 0 || MAP_ARE_SAME_TILE(start, goal);
+				found_count += is_found;
+				invalid_count += is_found && cost == PATH_TILE_NONE;
+
+				if (pass_idx == BENCH_PATH_PASS_CHECK) {
+					uint32_t reference_cost =
+						bench_path_reference_cost(map, &reference, start, goal);
+
+					if ((reference_cost != PATH_TILE_NONE) != is_found) {
+						++invalid_count;
+					} else if (is_found && reference_cost > 0 && cost != PATH_TILE_NONE) {
+						double cost_ratio = (double)cost / (double)reference_cost;
+						cost_ratio_sum += cost_ratio;
+						cost_ratio_worst = NUMBER_MAX(cost_ratio_worst, cost_ratio);
+						++checked_count;
+					}
+				}
+			}
+
+			if (pass_idx == BENCH_PATH_PASS_CHECK) {
+				printf("%6s %6s %8s %8s %8u %8u %8.3f %8.3f\n", map_names[map_idx],
+				       pass_names[pass_idx], "-", "-", found_count, invalid_count,
+				       cost_ratio_sum / NUMBER_MAX(checked_count, 1U), cost_ratio_worst);
+			} else {
+				printf("%6s %6s %8.3f %8.3f %8u %8u\n", map_names[map_idx], pass_names[pass_idx],
+				       (double)total_ns / 1e6 / query_count, (double)worst_ns / 1e6, found_count,
+				       invalid_count);
+			}
+		}
+
+		free(game->arena.base_address);
+		free(game);
+	}
+
+	printf("cost: length of the paths over the shortest ones, checked on the first %u queries\n",
+	       BENCH_PATH_CHECK_COUNT);
+
+	free(waypoints_base);
+	free(scratch_base);
+	free(reference.open.entries);
+	free(reference.search_idxs);
+	free(reference.costs);
+}
+
+// =============================================================================
+// Position deltas
+// =============================================================================
+
+#define BENCH_POSITION_PAIR_COUNT (1U << 16)
+#define BENCH_POSITION_REPEATS 64U
+
+// Most tiles between the two positions of a pair, the spans the simulation compares are much smaller
+#define BENCH_POSITION_SPREAD_TL 4096U
+
+typedef enum BenchPositionPlace : uint8_t {
+	BENCH_POSITION_PLACE_ORIGIN,
+	BENCH_POSITION_PLACE_WORLD,
+	BENCH_POSITION_PLACE_WRAP,
+	BENCH_POSITION_PLACE_COUNT,
+} BenchPositionPlace;
+
+typedef enum BenchPositionMethod : uint8_t {
+	BENCH_POSITION_METHOD_FLOAT,
+	BENCH_POSITION_METHOD_SUBSTRACT,
+	BENCH_POSITION_METHOD_FIXED,
+	BENCH_POSITION_METHOD_FIXED_M,
+	BENCH_POSITION_METHOD_COUNT,
+} BenchPositionMethod;
+
+typedef struct BenchPositionPair {
+	Position a;
+	Position b;
+} BenchPositionPair;
+
+/**
+ * @brief position_substract as it was before the tile delta was taken on the integers
+ */
+static PositionDelta bench_position_substract_float(const Position *const a, const Position *const b)
+{
+	PositionDelta result = {};
+
+	Vtwo delta_xy_tile = {
+		.x = (float)a->tile_x - (float)b->tile_x,
+		.y = (float)a->tile_y - (float)b->tile_y,
+	};
+	float delta_tile_z = (float)a->tile_z - (float)b->tile_z;
+
+	Vtwo delta_xy_m = vtwo_scale(delta_xy_tile, TILE_SIDE_M);
+
+	Vtwo delta_tile_offset_m = vtwo_sub(a->offset_m, b->offset_m);
+	delta_xy_m = vtwo_add(delta_xy_m, delta_tile_offset_m);
+
+	result.delta_xy_m = delta_xy_m;
+	result.delta_z_m = delta_tile_z * TILE_SIDE_M;
+
+	return result;
+}
+
+/**
+ * @brief Distance in meters between a delta and the one computed in double, the tiles are subtracted the short
+ * way around the tile space
+ */
+static double bench_position_error(const BenchPositionPair *pair, double delta_x_m, double delta_y_m)
+{
+	const Position *a = &pair->a;
+	const Position *b = &pair->b;
+	double exact_x_m = (double)(int32_t)(a->tile_x - b->tile_x) * (double)TILE_SIDE_M +
+	                   ((double)a->offset_m.x - (double)b->offset_m.x);
+	double exact_y_m = (double)(int32_t)(a->tile_y - b->tile_y) * (double)TILE_SIDE_M +
+	                   ((double)a->offset_m.y - (double)b->offset_m.y);
+	double result = NUMBER_MAX(fabs(exact_x_m - delta_x_m), fabs(exact_y_m - delta_y_m));
+
+	return result;
+}
+
+/**
+ * @brief Subtracts pairs of positions near the tile 0, near the origin of the world and across the wrap of the tile
+ * space. It uses the float tiles of the old position_substract, position_substract and position_substract_fixed,
+ * whose delta is measured before and after position_delta_from_fixed turns it into float meters
+ */
+static void bench_positions(void)
+{
+	static const char *place_names[BENCH_POSITION_PLACE_COUNT] = { "origin", "world", "wrap" };
+	static const char *method_names[BENCH_POSITION_METHOD_COUNT] = { "float", "substract", "fixed", "fixed m" };
+	static BenchPositionPair pairs[BENCH_POSITION_PAIR_COUNT];
+	static PositionDelta float_deltas[BENCH_POSITION_PAIR_COUNT];
+	static PositionDelta deltas[BENCH_POSITION_PAIR_COUNT];
+	static PositionDeltaFixed fixed_deltas[BENCH_POSITION_PAIR_COUNT];
+	static PositionDelta fixed_m_deltas[BENCH_POSITION_PAIR_COUNT];
+	double errors_m[BENCH_POSITION_PLACE_COUNT][BENCH_POSITION_METHOD_COUNT] = {};
+	uint64_t method_ns[BENCH_POSITION_METHOD_COUNT] = {};
+	double meters_per_fx = (double)TILE_SIDE_M / (double)(1 << POSITION_FIXED_SHIFT);
+
+	for (uint32_t place_idx = 0; place_idx < BENCH_POSITION_PLACE_COUNT; ++place_idx) {
+		uint32_t random_state = 0xBB67AE85U;
+		uint32_t base_x_tl = place_idx == BENCH_POSITION_PLACE_WORLD ? WORLD_ORIGIN_X_TL : 0U;
+		uint32_t base_y_tl = place_idx == BENCH_POSITION_PLACE_WORLD ? WORLD_ORIGIN_Y_TL : 0U;
+
+		// Note(fredy): around the wrap the first position is before the tile 0 and the second one after it
+		for (uint32_t pair_idx = 0; pair_idx < BENCH_POSITION_PAIR_COUNT; ++pair_idx) {
+			BenchPositionPair *pair = &pairs[pair_idx];
+			uint32_t spread_x_tl = bench_random(&random_state) % BENCH_POSITION_SPREAD_TL;
+			uint32_t spread_y_tl = bench_random(&random_state) % BENCH_POSITION_SPREAD_TL;
+			*pair = (BenchPositionPair){
+				.a = { .tile_x = base_x_tl + spread_x_tl, .tile_y = base_y_tl + spread_y_tl },
+				.b = { .tile_x = base_x_tl + spread_y_tl, .tile_y = base_y_tl + spread_x_tl },
+			};
+			if (place_idx == BENCH_POSITION_PLACE_WRAP) {
+				pair->a.tile_x = UINT32_MAX - spread_x_tl;
+				pair->a.tile_y = UINT32_MAX - spread_y_tl;
+			}
+
+			pair->a.offset_m.x = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+			pair->a.offset_m.y = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+			pair->b.offset_m.x = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+			pair->b.offset_m.y = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+		}
+
+		uint64_t float_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < BENCH_POSITION_REPEATS; ++repeat_idx) {
+			for (uint32_t pair_idx = 0; pair_idx < BENCH_POSITION_PAIR_COUNT; ++pair_idx) {
+				float_deltas[pair_idx] = bench_position_substract_float(&pairs[pair_idx].a,
+				                                                        &pairs[pair_idx].b);
+			}
+		}
+		method_ns[BENCH_POSITION_METHOD_FLOAT] += bench_get_ns() - float_start_ns;
+
+		uint64_t substract_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < BENCH_POSITION_REPEATS; ++repeat_idx) {
+			for (uint32_t pair_idx = 0; pair_idx < BENCH_POSITION_PAIR_COUNT; ++pair_idx) {
+				deltas[pair_idx] = position_substract(&pairs[pair_idx].a, &pairs[pair_idx].b);
+			}
+		}
+		method_ns[BENCH_POSITION_METHOD_SUBSTRACT] += bench_get_ns() - substract_start_ns;
+
+		uint64_t fixed_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < BENCH_POSITION_REPEATS; ++repeat_idx) {
+			for (uint32_t pair_idx = 0; pair_idx < BENCH_POSITION_PAIR_COUNT; ++pair_idx) {
+				fixed_deltas[pair_idx] =
+					position_substract_fixed(&pairs[pair_idx].a, &pairs[pair_idx].b);
+			}
+		}
+		method_ns[BENCH_POSITION_METHOD_FIXED] += bench_get_ns() - fixed_start_ns;
+
+		uint64_t fixed_m_start_ns = bench_get_ns();
+		for (uint32_t repeat_idx = 0; repeat_idx < BENCH_POSITION_REPEATS; ++repeat_idx) {
+			for (uint32_t pair_idx = 0; pair_idx < BENCH_POSITION_PAIR_COUNT; ++pair_idx) {
+				fixed_m_deltas[pair_idx] = position_delta_from_fixed(fixed_deltas[pair_idx]);
+			}
+		}
+		method_ns[BENCH_POSITION_METHOD_FIXED_M] += bench_get_ns() - fixed_m_start_ns;
+
+		double *place_errors_m = errors_m[place_idx];
+		for (uint32_t pair_idx = 0; pair_idx < BENCH_POSITION_PAIR_COUNT; ++pair_idx) {
+			const BenchPositionPair *pair = &pairs[pair_idx];
+			PositionDelta float_delta = float_deltas[pair_idx];
+			PositionDelta delta = deltas[pair_idx];
+			PositionDeltaFixed fixed_delta = fixed_deltas[pair_idx];
+			PositionDelta fixed_m_delta = fixed_m_deltas[pair_idx];
+
+			double float_error_m = bench_position_error(pair, (double)float_delta.delta_xy_m.x,
+			                                            (double)float_delta.delta_xy_m.y);
+			double error_m = bench_position_error(pair, (double)delta.delta_xy_m.x,
+			                                      (double)delta.delta_xy_m.y);
+			double fixed_x_m = (double)fixed_delta.delta_x_fx * meters_per_fx;
+			double fixed_y_m = (double)fixed_delta.delta_y_fx * meters_per_fx;
+			double fixed_error_m = bench_position_error(pair, fixed_x_m, fixed_y_m);
+			double fixed_m_error_m = bench_position_error(pair, (double)fixed_m_delta.delta_xy_m.x,
+			                                              (double)fixed_m_delta.delta_xy_m.y);
+
+			place_errors_m[BENCH_POSITION_METHOD_FLOAT] =
+				NUMBER_MAX(place_errors_m[BENCH_POSITION_METHOD_FLOAT], float_error_m);
+			place_errors_m[BENCH_POSITION_METHOD_SUBSTRACT] =
+				NUMBER_MAX(place_errors_m[BENCH_POSITION_METHOD_SUBSTRACT], error_m);
+			place_errors_m[BENCH_POSITION_METHOD_FIXED] =
+				NUMBER_MAX(place_errors_m[BENCH_POSITION_METHOD_FIXED], fixed_error_m);
+			place_errors_m[BENCH_POSITION_METHOD_FIXED_M] =
+				NUMBER_MAX(place_errors_m[BENCH_POSITION_METHOD_FIXED_M], fixed_m_error_m);
+		}
+	}
+
+	printf("positions: largest error in meters, %u pairs up to %u tiles apart, the world origin is at %u,%u\n",
+	       BENCH_POSITION_PAIR_COUNT, BENCH_POSITION_SPREAD_TL, WORLD_ORIGIN_X_TL, WORLD_ORIGIN_Y_TL);
+	printf("%10s", "place");
+	for (uint32_t method_idx = 0; method_idx < BENCH_POSITION_METHOD_COUNT; ++method_idx) {
+		printf(" %12s", method_names[method_idx]);
+	}
+	printf("\n");
+
+	for (uint32_t place_idx = 0; place_idx < BENCH_POSITION_PLACE_COUNT; ++place_idx) {
+		printf("%10s", place_names[place_idx]);
+		for (uint32_t method_idx = 0; method_idx < BENCH_POSITION_METHOD_COUNT; ++method_idx) {
+			printf(" %12.6f", errors_m[place_idx][method_idx]);
+		}
+		printf("\n");
+	}
+
+	double call_count = (double)BENCH_POSITION_PLACE_COUNT * BENCH_POSITION_REPEATS * BENCH_POSITION_PAIR_COUNT;
+	printf("%10s", "ns");
+	for (uint32_t method_idx = 0; method_idx < BENCH_POSITION_METHOD_COUNT; ++method_idx) {
+		printf(" %12.2f", (double)method_ns[method_idx] / call_count);
+	}
+	printf("\n");
+	printf("fixed: the fixed-point delta, fixed m: that delta in float meters from position_delta_from_fixed\n");
+}
+
+// =============================================================================
+// Flow field
+// =============================================================================
+
+#define BENCH_FLOW_TARGET_COUNT 16U
+#define BENCH_FLOW_EDIT_COUNT 64U
+#define BENCH_FLOW_SAMPLE_COUNT (1U << 20)
+
+/**
+ * @brief Builds flow fields around random targets of the noise map, then opens and closes random tiles of each
+ * field with game_set_tile_value, which repairs it. Every repair is compared with a field built again from scratch,
+ * the way the game would have to update it without the repair
+ */
+static void bench_flow(void)
+{
+	static FlowField rebuilt_field;
+	unsigned char *scratch_base = malloc(BENCH_SCRATCH_ARENA_BYTES);
+	Game *game = bench_init_game();
+
+	if (!scratch_base || !game) {
+		printf("flow: failed to allocate the game\n");
+		if (game) {
+			free(game->arena.base_address);
+		}
+		free(game);
+		free(scratch_base);
+
+		return;
+	}
+
+	Arena scratch_arena = {};
+	arena_init(&scratch_arena, BENCH_SCRATCH_ARENA_BYTES, scratch_base);
+
+	Map *map = game->world->map;
+	FlowField *field = &game->flow_field;
+	uint32_t side_tl = MAP_SIDE_X_TL / 2;
+	uint32_t random_state = 0x3C6EF372U;
+	bench_path_fill_map(game, BENCH_PATH_MAP_NOISE);
+
+	uint64_t build_ns = 0;
+	uint64_t repair_ns = 0;
+	uint64_t rebuild_ns = 0;
+	uint32_t mismatch_count = 0;
+	uint32_t reachable_count = 0;
+
+	for (uint32_t target_idx = 0; target_idx < BENCH_FLOW_TARGET_COUNT; ++target_idx) {
+		Position target = bench_path_random_tile(map, &random_state, side_tl);
+
+		arena_reset(&scratch_arena);
+		uint64_t build_start_ns = bench_get_ns();
+		flow_field_build(field, map, &scratch_arena, target);
+		build_ns += bench_get_ns() - build_start_ns;
+
+		for (uint32_t edit_idx = 0; edit_idx < BENCH_FLOW_EDIT_COUNT; ++edit_idx) {
+			uint32_t field_x = bench_random(&random_state) % FLOW_FIELD_SIDE_X_TL;
+			uint32_t field_y = bench_random(&random_state) % FLOW_FIELD_SIDE_Y_TL;
+			uint32_t tile_x = field->min_tile_x + field_x;
+			uint32_t tile_y = field->min_tile_y + field_y;
+			uint32_t is_walkable = map_is_tile_walkable(map, tile_x, tile_y, 0);
+
+			// Note(fredy): the target stays open, a field without it has no paths to compare
+			if (tile_x != target.tile_x || tile_y != target.tile_y) {
+				arena_reset(&scratch_arena);
+				uint64_t repair_start_ns = bench_get_ns();
+				game_set_tile_value(game, &scratch_arena, tile_x, tile_y, 0,
+				                    is_walkable ? TILE_TYPE_WALL : TILE_TYPE_EMPTY);
+				repair_ns += bench_get_ns() - repair_start_ns;
+
+				arena_reset(&scratch_arena);
+				uint64_t rebuild_start_ns = bench_get_ns();
+				flow_field_build(&rebuilt_field, map, &scratch_arena, target);
+				rebuild_ns += bench_get_ns() - rebuild_start_ns;
+
+				uint32_t is_same_cost =
+					memcmp(field->costs, rebuilt_field.costs, sizeof(field->costs)) == 0;
+				uint32_t is_same_direction = memcmp(field->directions, rebuilt_field.directions,
+				                                    sizeof(field->directions)) == 0;
+				mismatch_count += !is_same_cost || !is_same_direction;
+			}
+		}
+
+		for (uint32_t tile_idx = 0; tile_idx < FLOW_FIELD_SIZE_TL; ++tile_idx) {
+			reachable_count += field->costs[tile_idx] != FLOW_COST_UNREACHABLE;
+		}
+	}
+
+	// Note(fredy): the samples land on the field of the last target, some of them out of it
+	uint64_t sample_start_ns = bench_get_ns();
+	Vtwo sample_sum = {};
+	for (uint32_t sample_idx = 0; sample_idx < BENCH_FLOW_SAMPLE_COUNT; ++sample_idx) {
+		Position pos = {
+			.tile_x = field->min_tile_x - 8U + bench_random(&random_state) % (FLOW_FIELD_SIDE_X_TL + 16U),
+			.tile_y = field->min_tile_y - 8U + bench_random(&random_state) % (FLOW_FIELD_SIDE_Y_TL + 16U),
+		};
+		sample_sum = vtwo_add(sample_sum, flow_field_sample(field, pos));
+	}
+	uint64_t sample_ns = bench_get_ns() - sample_start_ns;
+
+	uint32_t edit_count = BENCH_FLOW_TARGET_COUNT * BENCH_FLOW_EDIT_COUNT;
+	double rebuild_edit_us = (double)rebuild_ns / 1e3 / edit_count;
+	double repair_edit_us = (double)repair_ns / 1e3 / edit_count;
+
+	printf("flow: %ux%u tiles per field, %.0f%% of them reachable, %u edits over %u fields\n", FLOW_FIELD_SIDE_X_TL,
+	       FLOW_FIELD_SIDE_Y_TL, 100.0 * reachable_count / ((double)FLOW_FIELD_SIZE_TL * BENCH_FLOW_TARGET_COUNT),
+	       edit_count, BENCH_FLOW_TARGET_COUNT);
+	printf("%10s %10s %10s %8s %11s\n", "us", "rebuild", "repair", "speedup", "mismatches");
+	printf("%10s %10.2f %10.2f %7.2fx %11u\n", "edit", rebuild_edit_us, repair_edit_us,
+	       rebuild_edit_us / repair_edit_us, mismatch_count);
+	printf("build: %.2f us per field, sample: %.2f ns per position, the directions sum to (%.1f, %.1f)\n",
+	       (double)build_ns / 1e3 / BENCH_FLOW_TARGET_COUNT, (double)sample_ns / BENCH_FLOW_SAMPLE_COUNT,
+	       (double)sample_sum.x, (double)sample_sum.y);
+
+	free(game->arena.base_address);
+	free(game);
+	free(scratch_base);
+}
+
+// =============================================================================
+// Raycasts
+// =============================================================================
+
+#define BENCH_RAY_ORIGIN_COUNT 512U
+#define BENCH_RAY_BATCH_COUNT 64U
+#define BENCH_RAY_LENGTH_M (16.0F * TILE_SIDE_M)
+
+// Distances of the same hit from the traversal and from the box test differ by the rounding only
+#define BENCH_RAY_EPSILON_M 0.001F
+
+/**
+ * @brief Tests the ray against every blocked tile of the square around the origin that contains the ray, the
+ * nearest entry is the hit. It is the reference the traversal is compared with
+ */
+static RayHit bench_ray_cast_boxes(Map *map, Position origin, Vtwo direction, float length_m)
+{
+	RayHit result = {
+		.distance_m = length_m,
+	};
+	int32_t radius_tl = (int32_t)float_ceil_to_uint(length_m / TILE_SIDE_M) + 1;
+
+	for (int32_t delta_y = -radius_tl; delta_y <= radius_tl; ++delta_y) {
+		for (int32_t delta_x = -radius_tl; delta_x <= radius_tl; ++delta_x) {
+			uint32_t tile_x = origin.tile_x + (uint32_t)delta_x;
+			uint32_t tile_y = origin.tile_y + (uint32_t)delta_y;
+
+			if (!map_is_tile_walkable(map, tile_x, tile_y, origin.tile_z)) {
+				Vtwo center_m = {
+					.x = (float)delta_x * TILE_SIDE_M - origin.offset_m.x,
+					.y = (float)delta_y * TILE_SIDE_M - origin.offset_m.y,
+				};
+				float enter_m = 0.0F;
+				float exit_m = length_m;
+
+				for (uint32_t axis = 0; axis < 2; ++axis) {
+					float min_m = center_m.e[axis] - TILE_RADIUS_M;
+					float max_m = center_m.e[axis] + TILE_RADIUS_M;
+
+					if (fabsf(direction.e[axis]) < FLT_EPSILON) {
+						if (min_m > 0.0F || max_m < 0.0F) {
+							exit_m = -1.0F;
+						}
+					} else {
+						float min_t = min_m / direction.e[axis];
+						float max_t = max_m / direction.e[axis];
+						enter_m = NUMBER_MAX(enter_m, NUMBER_MIN(min_t, max_t));
+						exit_m = NUMBER_MIN(exit_m, NUMBER_MAX(min_t, max_t));
+					}
+				}
+
+				if (enter_m <= exit_m && (!result.is_hit || enter_m < result.distance_m)) {
+					result.is_hit = 1U;
+					result.distance_m = enter_m;
+					result.tile_x = tile_x;
+					result.tile_y = tile_y;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static uint32_t bench_ray_is_same_hit(RayHit a, RayHit b)
+{
+	uint32_t result = a.is_hit == b.is_hit && fabsf(a.distance_m - b.distance_m) <= BENCH_RAY_EPSILON_M;
+
+	return result;
+}
+
+/**
+ * @brief Casts BENCH_RAY_BATCH_COUNT rays around random origins of the noise map with ray_cast, with ray_cast_batch
+ * and with the box test of the reference. Then checks the line of sight between random pairs of positions
+ */
+static void bench_rays(void)
+{
+	static Position origins[BENCH_RAY_ORIGIN_COUNT];
+	static Vtwo directions[BENCH_RAY_BATCH_COUNT];
+	static RayHit cast_hits[BENCH_RAY_ORIGIN_COUNT][BENCH_RAY_BATCH_COUNT];
+	static RayHit box_hits[BENCH_RAY_ORIGIN_COUNT][BENCH_RAY_BATCH_COUNT];
+	unsigned char *batch_base = malloc(BENCH_SCRATCH_ARENA_BYTES);
+	Game *game = bench_init_game();
+
+	if (!batch_base || !game) {
+		printf("rays: failed to allocate the game\n");
+		if (game) {
+			free(game->arena.base_address);
+		}
+		free(game);
+		free(batch_base);
+
+		return;
+	}
+
+	Arena batch_arena = {};
+	arena_init(&batch_arena, BENCH_SCRATCH_ARENA_BYTES, batch_base);
+
+	Map *map = game->world->map;
+	uint32_t side_tl = MAP_SIDE_X_TL / 2;
+	uint32_t random_state = 0x6A09E667U;
+	bench_path_fill_map(game, BENCH_PATH_MAP_NOISE);
+
+	for (uint32_t origin_idx = 0; origin_idx < BENCH_RAY_ORIGIN_COUNT; ++origin_idx) {
+		origins[origin_idx] = bench_path_random_tile(map, &random_state, side_tl);
+		origins[origin_idx].offset_m.x = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+		origins[origin_idx].offset_m.y = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+	}
+
+	for (uint32_t ray_idx = 0; ray_idx < BENCH_RAY_BATCH_COUNT; ++ray_idx) {
+		float angle = ((float)ray_idx + 0.5F) * 2.0F * PIE / BENCH_RAY_BATCH_COUNT;
+		directions[ray_idx] = (Vtwo){ .x = cosf(angle), .y = sinf(angle) };
+	}
+
+	uint64_t box_start_ns = bench_get_ns();
+	for (uint32_t origin_idx = 0; origin_idx < BENCH_RAY_ORIGIN_COUNT; ++origin_idx) {
+		for (uint32_t ray_idx = 0; ray_idx < BENCH_RAY_BATCH_COUNT; ++ray_idx) {
+			box_hits[origin_idx][ray_idx] =
+				bench_ray_cast_boxes(map, origins[origin_idx], directions[ray_idx], BENCH_RAY_LENGTH_M);
+		}
+	}
+	uint64_t box_ns = bench_get_ns() - box_start_ns;
+
+	uint64_t cast_start_ns = bench_get_ns();
+	for (uint32_t origin_idx = 0; origin_idx < BENCH_RAY_ORIGIN_COUNT; ++origin_idx) {
+		for (uint32_t ray_idx = 0; ray_idx < BENCH_RAY_BATCH_COUNT; ++ray_idx) {
+			cast_hits[origin_idx][ray_idx] = ray_cast(map, origins[origin_idx], directions[ray_idx],
+			                                          BENCH_RAY_LENGTH_M);
+		}
+	}
+	uint64_t cast_ns = bench_get_ns() - cast_start_ns;
+
+	uint32_t batch_mismatch_count = 0;
+	uint64_t batch_ns = 0;
+	for (uint32_t origin_idx = 0; origin_idx < BENCH_RAY_ORIGIN_COUNT; ++origin_idx) {
+		arena_reset(&batch_arena);
+		uint64_t batch_start_ns = bench_get_ns();
+		RayHit *batch_hits = ray_cast_batch(map, &batch_arena, origins[origin_idx], directions,
+		                                    BENCH_RAY_BATCH_COUNT, BENCH_RAY_LENGTH_M);
+		batch_ns += bench_get_ns() - batch_start_ns;
+
+		// Note(fredy): the batch shares the origin with ray_cast, the hits have to be the same bits
+		batch_mismatch_count += (uint32_t)(memcmp(batch_hits, cast_hits[origin_idx],
+		                                          BENCH_RAY_BATCH_COUNT * sizeof(RayHit)) != 0);
+	}
+
+	uint32_t hit_count = 0;
+	uint32_t cast_mismatch_count = 0;
+	for (uint32_t origin_idx = 0; origin_idx < BENCH_RAY_ORIGIN_COUNT; ++origin_idx) {
+		for (uint32_t ray_idx = 0; ray_idx < BENCH_RAY_BATCH_COUNT; ++ray_idx) {
+			RayHit cast_hit = cast_hits[origin_idx][ray_idx];
+			hit_count += cast_hit.is_hit;
+			cast_mismatch_count += !bench_ray_is_same_hit(cast_hit, box_hits[origin_idx][ray_idx]);
+		}
+	}
+
+	uint32_t ray_count = BENCH_RAY_ORIGIN_COUNT * BENCH_RAY_BATCH_COUNT;
+	double box_ray_ns = (double)box_ns / ray_count;
+	double cast_ray_ns = (double)cast_ns / ray_count;
+	double batch_ray_ns = (double)batch_ns / ray_count;
+
+	printf("rays: ns per ray, %u rays of %.1f m, %u per batch, %.1f%% hit a wall\n", ray_count,
+	       (double)BENCH_RAY_LENGTH_M, BENCH_RAY_BATCH_COUNT, 100.0 * hit_count / ray_count);
+	printf("%10s %10s %10s %8s %11s\n", "pass", "boxes", "rays", "speedup", "mismatches");
+	printf("%10s %10.1f %10.1f %7.2fx %11u\n", "ray_cast", box_ray_ns, cast_ray_ns, box_ray_ns / cast_ray_ns,
+	       cast_mismatch_count);
+	printf("%10s %10.1f %10.1f %7.2fx %11u\n", "batch", box_ray_ns, batch_ray_ns, box_ray_ns / batch_ray_ns,
+	       batch_mismatch_count);
+
+	// Note(fredy): the pairs are up to a ray length apart, so the reference square covers the segment
+	uint32_t visible_count = 0;
+	uint32_t sight_mismatch_count = 0;
+	for (uint32_t origin_idx = 0; origin_idx < BENCH_RAY_ORIGIN_COUNT; ++origin_idx) {
+		Position from = origins[origin_idx];
+		Position to = from;
+		to.offset_m.x += bench_random_float(&random_state, -0.7F, 0.7F) * BENCH_RAY_LENGTH_M;
+		to.offset_m.y += bench_random_float(&random_state, -0.7F, 0.7F) * BENCH_RAY_LENGTH_M;
+		map_normalize_position(&to);
+
+		Vtwo delta_m = position_substract(&to, &from).delta_xy_m;
+		float length_m = vtwo_norm(delta_m);
+		RayHit box_hit = bench_ray_cast_boxes(map, from, vtwo_scale(delta_m, 1.0F / length_m), length_m);
+		uint32_t has_line_of_sight = ray_has_line_of_sight(map, from, to);
+
+		visible_count += has_line_of_sight;
+		// Note(fredy): a hit within the epsilon of the end of the segment can go either way
+		if (has_line_of_sight == box_hit.is_hit && fabsf(box_hit.distance_m - length_m) > BENCH_RAY_EPSILON_M) {
+			++sight_mismatch_count;
+		}
+	}
+
+	printf("line of sight: %u pairs, %u visible, %u mismatches\n", BENCH_RAY_ORIGIN_COUNT, visible_count,
+	       sight_mismatch_count);
+	printf("mismatches: ray_cast against the boxes within %.3f m, the batch against ray_cast bit for bit\n",
+	       (double)BENCH_RAY_EPSILON_M);
+
+	free(game->arena.base_address);
+	free(game);
+	free(batch_base);
+}
+
+// =============================================================================
+// Spatial queries
+// =============================================================================
+
+#define BENCH_SPATIAL_QUERY_COUNT 4096U
+#define BENCH_SPATIAL_NEAREST_COUNT 8U
+
+// Side of the square of tiles where the entities are placed, 4x4 chunks
+#define BENCH_SPATIAL_SIDE_TL (4U * (uint32_t)CHUNK_SIDE_TL)
+
+typedef enum BenchSpatialKind : uint8_t {
+	BENCH_SPATIAL_KIND_RECT,
+	BENCH_SPATIAL_KIND_RADIUS,
+	BENCH_SPATIAL_KIND_NEAREST,
+	BENCH_SPATIAL_KIND_RAY,
+	BENCH_SPATIAL_KIND_COUNT,
+} BenchSpatialKind;
+
+/**
+ * @brief A query of any kind, the rect uses dim_m, the ray uses direction and distance_m as its length, the others
+ * use distance_m as the radius
+ */
+typedef struct BenchSpatialArgs {
+	Position center;
+	Vtwo dim_m;
+	Vtwo direction;
+	float distance_m;
+	BenchSpatialKind kind;
+} BenchSpatialArgs;
+
+static SpatialQuery bench_spatial_query(Game *game, Arena *arena, const BenchSpatialArgs *args)
+{
+	SpatialQuery result = {};
+
+	if (args->kind == BENCH_SPATIAL_KIND_RECT) {
+		result = spatial_query_rect(game, arena, args->center, args->dim_m);
+	} else if (args->kind == BENCH_SPATIAL_KIND_RADIUS) {
+		result = spatial_query_radius(game, arena, args->center, args->distance_m);
+	} else if (args->kind == BENCH_SPATIAL_KIND_NEAREST) {
+		result = spatial_query_nearest(game, arena, args->center, BENCH_SPATIAL_NEAREST_COUNT,
+		                               args->distance_m);
+	} else {
+		result = spatial_query_ray(game, arena, args->center, args->direction, args->distance_m);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Slab test of a segment that starts at the origin against a box, like spatial_query_ray does it
+ */
+static uint32_t bench_spatial_ray_hits(Vtwo box_center_m, Vtwo box_half_dim_m, Vtwo direction, float length_m)
+{
+	float enter_m = 0.0F;
+	float exit_m = length_m;
+
+	for (uint32_t axis = 0; axis < 2; ++axis) {
+		float min_m = box_center_m.e[axis] - box_half_dim_m.e[axis];
+		float max_m = box_center_m.e[axis] + box_half_dim_m.e[axis];
+
+		if (fabsf(direction.e[axis]) < FLT_EPSILON) {
+			if (min_m > 0.0F || max_m < 0.0F) {
+				exit_m = -1.0F;
+			}
+		} else {
+			float min_t = min_m / direction.e[axis];
+			float max_t = max_m / direction.e[axis];
+			enter_m = NUMBER_MAX(enter_m, NUMBER_MIN(min_t, max_t));
+			exit_m = NUMBER_MIN(exit_m, NUMBER_MAX(min_t, max_t));
+		}
+	}
+
+	return enter_m <= exit_m;
+}
+
+/**
+ * @brief The query without the index, every entity is tested like the camera did over the whole DORMANT list. The
+ * nearest are kept with a selection over all the entities in range
+ */
+static SpatialQuery bench_spatial_scan(Game *game, Arena *arena, const BenchSpatialArgs *args)
+{
+	SpatialQuery result = {};
+	result.entity_idxs = ARENA_PUSH_ARRAY(arena, uint32_t, game->entity_count);
+	float *distances_sq = ARENA_PUSH_ARRAY(arena, float, game->entity_count);
+	AppRect rect = rectangle((Vtwo){}, args->dim_m);
+	float distance_sq = float_square(args->distance_m);
+
+	for (uint32_t entity_idx = 1; entity_idx < game->entity_count; ++entity_idx) {
+		const Position *pos = &game->entity_positions[entity_idx];
+		Vtwo delta_m = position_substract(pos, &args->center).delta_xy_m;
+		uint32_t is_hit = 0U;
+
+		if (pos->tile_z == args->center.tile_z) {
+			if (args->kind == BENCH_SPATIAL_KIND_RECT) {
+				is_hit = rectangle_contains(rect, delta_m);
+			} else if (args->kind == BENCH_SPATIAL_KIND_RAY) {
+				EntityShape *shape = &game->entity_shapes[entity_idx];
+				Vtwo half_dim_m = { .x = shape->width_m * 0.5F, .y = shape->height_m * 0.5F };
+				is_hit = bench_spatial_ray_hits(delta_m, half_dim_m, args->direction, args->distance_m);
+			} else {
+				is_hit = vtwo_norm_sq(delta_m) <= distance_sq;
+			}
+		}
+
+		if (is_hit) {
+			distances_sq[result.count] = vtwo_norm_sq(delta_m);
+			result.entity_idxs[result.count++] = entity_idx;
+		}
+	}
+
+	if (args->kind == BENCH_SPATIAL_KIND_NEAREST) {
+		uint32_t count = NUMBER_MIN(result.count, BENCH_SPATIAL_NEAREST_COUNT);
+
+		for (uint32_t sorted_idx = 0; sorted_idx < count; ++sorted_idx) {
+			uint32_t nearest_idx = sorted_idx;
+
+			for (uint32_t result_idx = sorted_idx + 1; result_idx < result.count; ++result_idx) {
+				if (distances_sq[result_idx] < distances_sq[nearest_idx]) {
+					nearest_idx = result_idx;
+				}
+			}
+
+			float swap_distance_sq = distances_sq[sorted_idx];
+			uint32_t swap_entity_idx = result.entity_idxs[sorted_idx];
+			distances_sq[sorted_idx] = distances_sq[nearest_idx];
+			result.entity_idxs[sorted_idx] = result.entity_idxs[nearest_idx];
+			distances_sq[nearest_idx] = swap_distance_sq;
+			result.entity_idxs[nearest_idx] = swap_entity_idx;
+		}
+
+		result.count = count;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Compares the entities found by the index with the ones of the scan, the nearest also have to be sorted by
+ * distance
+ */
+static uint32_t bench_spatial_is_match(Game *game, const BenchSpatialArgs *args, SpatialQuery query,
+                                       SpatialQuery scan, uint8_t *marks)
+{
+	uint32_t result = query.count == scan.count;
+
+	for (uint32_t scan_idx = 0; scan_idx < scan.count; ++scan_idx) {
+		marks[scan.entity_idxs[scan_idx]] = 1U;
+	}
+
+	float previous_distance_sq = 0.0F;
+
+	for (uint32_t query_idx = 0; query_idx < query.count && result; ++query_idx) {
+		uint32_t entity_idx = query.entity_idxs[query_idx];
+		Vtwo delta_m = position_substract(&game->entity_positions[entity_idx], &args->center).delta_xy_m;
+		float distance_sq = vtwo_norm_sq(delta_m);
+
+		result = marks[entity_idx];
+		if (args->kind == BENCH_SPATIAL_KIND_NEAREST) {
+			result = result && distance_sq >= previous_distance_sq;
+		}
+
+		previous_distance_sq = distance_sq;
+	}
+
+	for (uint32_t scan_idx = 0; scan_idx < scan.count; ++scan_idx) {
+		marks[scan.entity_idxs[scan_idx]] = 0U;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Places MAX_ENTITIES entities over 4x4 chunks and times random queries of every kind against the scan of
+ * all of them
+ */
+static void bench_spatial(void)
+{
+	static const char *kind_names[BENCH_SPATIAL_KIND_COUNT] = { "rect", "radius", "nearest", "ray" };
+	static BenchSpatialArgs queries[BENCH_SPATIAL_QUERY_COUNT];
+	static uint8_t marks[MAX_ENTITIES];
+	unsigned char *query_base = malloc(BENCH_SCRATCH_ARENA_BYTES);
+	Game *game = bench_init_game();
+
+	if (!query_base || !game) {
+		printf("spatial: failed to allocate the game\n");
+		if (game) {
+			free(game->arena.base_address);
+		}
+		free(game);
+		free(query_base);
+
+		return;
+	}
+
+	Arena query_arena = {};
+	arena_init(&query_arena, BENCH_SCRATCH_ARENA_BYTES, query_base);
+
+	uint32_t random_state = 0x2545F491U;
+	uint32_t side_tl = BENCH_SPATIAL_SIDE_TL;
+
+	// Note(fredy): the half dimensions stay under SPATIAL_MARGIN_TL, the index does not look further for the boxes
+	game->entity_count = MAX_ENTITIES;
+	for (uint32_t entity_idx = 1; entity_idx < game->entity_count; ++entity_idx) {
+		Position pos = {
+			.tile_x = bench_random(&random_state) % side_tl,
+			.tile_y = bench_random(&random_state) % side_tl,
+		};
+		pos.offset_m.x = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+		pos.offset_m.y = bench_random_float(&random_state, -TILE_RADIUS_M, TILE_RADIUS_M);
+
+		game->entity_positions[entity_idx] = pos;
+		game->entity_shapes[entity_idx] = (EntityShape){
+			.width_m = bench_random_float(&random_state, 0.2F, TILE_SIDE_M),
+			.height_m = bench_random_float(&random_state, 0.2F, TILE_SIDE_M),
+		};
+		spatial_update_entity(game, entity_idx);
+	}
+
+	printf("spatial: ns per query, %u entities over %ux%u tiles, %u queries\n", game->entity_count - 1, side_tl,
+	       side_tl, BENCH_SPATIAL_QUERY_COUNT);
+	printf("%8s %10s %10s %8s %8s %11s\n", "query", "scan", "index", "speedup", "found", "mismatches");
+
+	for (uint32_t kind_idx = 0; kind_idx < BENCH_SPATIAL_KIND_COUNT; ++kind_idx) {
+		for (uint32_t query_idx = 0; query_idx < BENCH_SPATIAL_QUERY_COUNT; ++query_idx) {
+			float angle = bench_random_float(&random_state, 0.0F, 2.0F * PIE);
+			BenchSpatialArgs *args = &queries[query_idx];
+			*args = (BenchSpatialArgs){
+				.center = {
+					.tile_x = bench_random(&random_state) % side_tl,
+					.tile_y = bench_random(&random_state) % side_tl,
+				},
+				.dim_m = {
+					.x = bench_random_float(&random_state, 1.0F, 16.0F) * TILE_SIDE_M,
+					.y = bench_random_float(&random_state, 1.0F, 16.0F) * TILE_SIDE_M,
+				},
+				.direction = { .x = cosf(angle), .y = sinf(angle) },
+				.distance_m = bench_random_float(&random_state, 1.0F, 16.0F) * TILE_SIDE_M,
+				.kind = (BenchSpatialKind)kind_idx,
+			};
+		}
+
+		uint64_t scan_start_ns = bench_get_ns();
+		for (uint32_t query_idx = 0; query_idx < BENCH_SPATIAL_QUERY_COUNT; ++query_idx) {
+			arena_reset(&query_arena);
+			(void)bench_spatial_scan(game, &query_arena, &queries[query_idx]);
+		}
+		uint64_t scan_ns = bench_get_ns() - scan_start_ns;
+
+		uint64_t query_start_ns = bench_get_ns();
+		for (uint32_t query_idx = 0; query_idx < BENCH_SPATIAL_QUERY_COUNT; ++query_idx) {
+			arena_reset(&query_arena);
+			(void)bench_spatial_query(game, &query_arena, &queries[query_idx]);
+		}
+		uint64_t query_ns = bench_get_ns() - query_start_ns;
+
+		uint32_t found_count = 0;
+		uint32_t mismatch_count = 0;
+		for (uint32_t query_idx = 0; query_idx < BENCH_SPATIAL_QUERY_COUNT; ++query_idx) {
+			arena_reset(&query_arena);
+			SpatialQuery query = bench_spatial_query(game, &query_arena, &queries[query_idx]);
+			SpatialQuery scan = bench_spatial_scan(game, &query_arena, &queries[query_idx]);
+
+			found_count += query.count;
+			mismatch_count += !bench_spatial_is_match(game, &queries[query_idx], query, scan, marks);
+		}
+
+		double scan_query_ns = (double)scan_ns / BENCH_SPATIAL_QUERY_COUNT;
+		double index_query_ns = (double)query_ns / BENCH_SPATIAL_QUERY_COUNT;
+		printf("%8s %10.1f %10.1f %7.2fx %8.2f %11u\n", kind_names[kind_idx], scan_query_ns, index_query_ns,
+		       scan_query_ns / index_query_ns, (double)found_count / BENCH_SPATIAL_QUERY_COUNT,
+		       mismatch_count);
+	}
+
+	printf("found: entities per query\n");
+
+	free(game->arena.base_address);
+	free(game);
+	free(query_base);
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = argc > 1 ? argv[1] : nullptr;
+	uint32_t was_run = 0U;
+
+	if (!name || strcmp(name, "collision") == 0) {
+		bench_collision();
+		was_run = 1U;
+	}
+
+	if (!name || strcmp(name, "streams") == 0) {
+		bench_streams();
+		was_run = 1U;
+	}
+
+	if (!name || strcmp(name, "path") == 0) {
+		bench_path();
+		was_run = 1U;
+	}
+
+	if (!name || strcmp(name, "spatial") == 0) {
+		bench_spatial();
+		was_run = 1U;
+	}
+
+	if (!name || strcmp(name, "rays") == 0) {
+		bench_rays();
+		was_run = 1U;
+	}
+
+	if (!name || strcmp(name, "positions") == 0) {
+		bench_positions();
+		was_run = 1U;
+	}
+
+	if (!name || strcmp(name, "flow") == 0) {
+		bench_flow();
+		was_run = 1U;
+	}
+
+	if (!was_run) {
+		printf("unknown benchmark: %s\n", name);
+	}
+
+	return was_run ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -19,10 +19,14 @@ set "OutAppFileName=handmade_app"
 set "OutPlatFileName=win_handmade"
 set "OutPlatFilePath=%Outdir%/%OutPlatFileName%.exe"
 set "OutAppFilePath=%Outdir%/%OutAppFileName%.dll"
+set "BenchFilePath=./misc/bench.c"
+set "OutBenchFilePath=%Outdir%/bench.exe"
 set "FlagsFile=%ScriptDir%../compile_flags.txt"
-set "DebugFlags=-g -gcodeview -O0 -DDEBUG -Wl,/DEBUG:FULL -fms-runtime-lib=static_dbg"
+set "DebugFlags=-g -gcodeview -O0 -DDEBUG -DARENA_INSTRUMENTATION -Wl,/DEBUG:FULL -fms-runtime-lib=static_dbg"
 @REM set "DebugFlags=!DebugFlags! -fsanitize=address -fno-omit-frame-pointer"
 set "ReleaseFlags=-O3 -DNDEBUG -flto -Wl,/opt:ref -Wl,/opt:icf -fms-runtime-lib=static"
+REM Without it the collision sweep and the z integration compile their scalar paths
+set "SimdFlags=-mavx2"
 set "Flags="
 set "AppFlags=-shared -Wl,/MAP:%Outdir%/%OutAppFileName%.map,/MAPINFO:EXPORTS -Wl,/EXPORT:sound_create_samples -Wl,/EXPORT:game_update_and_render -Wl,/PDB:%Outdir%/%OutAppFileName%_%random%.pdb"
 set "PlatFlags=-luser32 -lgdi32 -lwinmm -Wl,/subsystem:windows -Wl,/MAP:%Outdir%/%OutPlatFileName%.map,/MAPINFO:EXPORTS"
@@ -98,6 +102,13 @@ if "%Architecture%"=="x86" (
     echo Building for 64-bit ^(x64^)...
 )
 
+set "Flags=!Flags! %SimdFlags%"
+
+REM The timings of a debug build mean nothing, the benchmarks are always optimized. The game only has its asset
+REM loading with the DEBUG file functions, so they keep them and drop the asserts
+set "BenchFlags=!Flags! %ReleaseFlags% -DDEBUG"
+
+
 if "%BuildMode%"=="debug" (
     set "Flags=!Flags! %DebugFlags%"
     echo Building in DEBUG mode...
@@ -152,3 +163,23 @@ if errorlevel 1 (
 
 echo.
 echo Building %OutPlatFilePath% succeeded!
+echo.
+
+echo ================================================================================
+echo.
+
+echo Building %OutBenchFilePath% ...
+echo.
+echo clang !BenchFlags! %BenchFilePath% -o %OutBenchFilePath%
+echo.
+
+clang !BenchFlags! %BenchFilePath% -o %OutBenchFilePath%
+
+if errorlevel 1 (
+    echo Building %OutBenchFilePath% failed!
+    exit /b %errorlevel%
+)
+
+echo.
+echo Building %OutBenchFilePath% succeeded!
+
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Builds the Linux platform layer and the benchmarks, the game is compiled into both.
+# Usage: misc/build.sh [debug|release]
+
+set -e
+
+ScriptDir=$(dirname "$0")
+
+BuildMode=${1:-debug}
+PlatFilePath=./src/plat_linux.c
+Outdir=./bin
+Datadir=./data
+OutPlatFilePath=$Outdir/linux_handmade
+BenchFilePath=./misc/bench.c
+OutBenchFilePath=$Outdir/bench
+FlagsFile=$ScriptDir/../compile_flags.txt
+DebugFlags="-g -O0 -DDEBUG -DARENA_INSTRUMENTATION"
+# Note: the platform API only has the file functions in DEBUG, the release build keeps them and drops the asserts
+ReleaseFlags="-O3 -DDEBUG -DNDEBUG -flto"
+# Note: lib.h defines its helpers as plain inline, in C that emits no symbol for the calls that are not inlined
+PlatFlags="-fgnu89-inline -lm"
+# Note: without it the collision sweep and the z integration compile their scalar paths
+SimdFlags="-mavx2"
+
+if [ "$BuildMode" != "debug" ] && [ "$BuildMode" != "release" ]; then
+	echo "Error: Invalid build mode \"$BuildMode\". Must be \"debug\" or \"release\"."
+	exit 1
+fi
+
+mkdir -p "$Outdir" "$Datadir"
+rm -f "$Datadir/log.txt"
+
+# Read flags from file, skipping the comments and the flags of the Windows linker
+Flags=$(grep -v -e '^//' -e '^-Wl,/' -e '^-fuse-ld' -e '^-D_CRT' "$FlagsFile" | tr '\n' ' ')
+Flags="$Flags $SimdFlags"
+# Note: the timings of a debug build mean nothing, the benchmarks are always optimized
+BenchFlags="$Flags $ReleaseFlags $PlatFlags"
+
+if [ "$BuildMode" = "debug" ]; then
+	Flags="$Flags $DebugFlags"
+	echo "Building in DEBUG mode..."
+else
+	Flags="$Flags $ReleaseFlags"
+	echo "Building in RELEASE mode..."
+fi
+
+Flags="$Flags $PlatFlags"
+
+echo "clang $Flags $PlatFilePath -o $OutPlatFilePath"
+clang $Flags $PlatFilePath -o $OutPlatFilePath
+
+echo "Building $OutPlatFilePath succeeded!"
+
+echo "clang $BenchFlags $BenchFilePath -o $OutBenchFilePath"
+clang $BenchFlags $BenchFilePath -o $OutBenchFilePath
+
+echo "Building $OutBenchFilePath succeeded!"
@@ -3,6 +3,7 @@
 */
 
 #include <assert.h>
+#include <float.h>
 #include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -44,6 +45,34 @@
 #define MAP_SIZE_XY_CHK (MAP_SIDE_Y_CHK * MAP_SIDE_X_CHK)
 #define MAP_SIZE_CHK (MAP_SIZE_XY_CHK * MAP_SIDE_Z_CHK)
 
+// Seed of the hashes of the state checksum
+#define CHECKSUM_SEED 0x9E3779B97F4A7C15ULL
+
+/**
+ * @brief Tile where the world is generated, the tile space wraps around so the world can be anywhere on it. A build
+ * can move it, misc/bench.c puts it in the middle of the tile space with (UINT32_MAX / 2)
+ */
+#ifndef WORLD_ORIGIN_X_TL
+#define WORLD_ORIGIN_X_TL 0U
+#endif
+
+#ifndef WORLD_ORIGIN_Y_TL
+#define WORLD_ORIGIN_Y_TL 0U
+#endif
+
+// Bits of the fraction of a tile in the fixed-point position deltas
+#define POSITION_FIXED_SHIFT 16
+
+// Map side in tiles, the tile space wraps around the map every this many tiles
+#define MAP_SIDE_X_TL (MAP_SIDE_X_CHK * (uint32_t)CHUNK_SIDE_TL)
+#define MAP_SIDE_Y_TL (MAP_SIDE_Y_CHK * (uint32_t)CHUNK_SIDE_TL)
+
+// Most nodes of a chunk for the pathfinding, an edge has at most half of its tiles as separate openings
+#define PATH_MAX_CHUNK_NODES (4U * (uint32_t)CHUNK_SIDE_TL / 2U)
+
+// Cost of the paths between the nodes of a chunk that are not joined inside it
+#define PATH_COST_NONE UINT16_MAX
+
 #define MAP_GET_TILE_TYPE_BY_POS(map, pos) map_get_tile_type(map, (pos).tile_x, (pos).tile_y, (pos).tile_z)
 #define MAP_IS_POSITION_WALKABLE(map, pos) map_is_tile_walkable(map, (pos).tile_x, (pos).tile_y, (pos).tile_z)
 
@@ -86,8 +115,55 @@ typedef struct ChunkPosition {
 	uint32_t tile_y;
 } ChunkPosition;
 
+typedef enum PathSide : uint8_t {
+	PATH_SIDE_RIGHT,
+	PATH_SIDE_UP,
+	PATH_SIDE_LEFT,
+	PATH_SIDE_DOWN,
+	PATH_SIDE_COUNT,
+} PathSide;
+
+/**
+ * @brief Abstract graph of a chunk for the pathfinding. The nodes are the tiles in the middle of the openings to the
+ * neighbor chunks and the edges the costs of the paths between them inside the chunk
+ */
+typedef struct PathChunk {
+	uint32_t is_dirty;
+	uint32_t node_count;
+	uint8_t node_tile_idxs[PATH_MAX_CHUNK_NODES];
+	PathSide node_sides[PATH_MAX_CHUNK_NODES];
+	uint16_t costs[PATH_MAX_CHUNK_NODES][PATH_MAX_CHUNK_NODES];
+} PathChunk;
+
+/**
+ * @brief Tiles of a chunk seen by the entity tracked by the camera, bit x of row y is the tile (x, y) of the chunk
+ */
+typedef struct ChunkVisibility {
+	uint16_t rows[CHUNK_SIDE_TL];
+
+	/**
+	 * @brief Whether the chunk is in the list of the chunks that the last visibility computation went through
+	 */
+	uint32_t is_listed;
+} ChunkVisibility;
+
 typedef struct TileChunk {
 	uint32_t *tiles;
+
+	/**
+	 * @brief Head of the list of the entities over the chunk, 0 (the null entity) ends the list
+	 */
+	uint32_t first_entity_idx;
+
+	/**
+	 * @brief Built by the first path that goes through the chunk and again after its tiles change
+	 */
+	PathChunk *path;
+
+	/**
+	 * @brief Allocated the first time a tile of the chunk is seen
+	 */
+	ChunkVisibility *visibility;
 } TileChunk;
 
 /**
@@ -98,6 +174,17 @@ typedef struct Map {
 	 * @brief Chunks are laid out in memory with z as the outermost dimension, then y, then x
 	 */
 	TileChunk *chunks;
+
+	/**
+	 * @brief Tile arrays of the chunks. Nothing unloads a chunk yet, so the pool only hands out new blocks
+	 */
+	Pool tile_pool;
+
+	/**
+	 * @brief XOR of the hashes of the allocated chunks and of their tiles that are not empty, kept up to date
+	 * as the tiles are set
+	 */
+	uint64_t checksum;
 } Map;
 
 typedef struct Position {
@@ -129,6 +216,16 @@ typedef struct PositionDelta {
 	float delta_z_m;
 } PositionDelta;
 
+/**
+ * @brief Exact difference between two positions anywhere in the tile space, x and y are in 1/2^POSITION_FIXED_SHIFT
+ * of a tile
+ */
+typedef struct PositionDeltaFixed {
+	int64_t delta_x_fx;
+	int64_t delta_y_fx;
+	int32_t delta_tile_z;
+} PositionDeltaFixed;
+
 /**
  * @brief Normalizes a single axis coordinate so the tile offset stays within [-TILE_RADIUS_M, TILE_RADIUS_M].
  *
@@ -168,13 +265,16 @@ static inline ChunkPosition map_get_chunk_pos(uint32_t tile_x, uint32_t tile_y,
 	return result;
 }
 
+/**
+ * @brief Chunk that stores a chunk position, the map repeats over the whole tile space so the positions out of it
+ * wrap around
+ */
 static inline TileChunk *map_get_chunk(Map *map, uint32_t chunk_x, uint32_t chunk_y, uint32_t chunk_z)
 {
-	TileChunk *result = nullptr;
-
-	if (chunk_x < MAP_SIDE_X_CHK && chunk_y < MAP_SIDE_Y_CHK && chunk_z < MAP_SIDE_Z_CHK) {
-		result = &map->chunks[chunk_z * MAP_SIZE_XY_CHK + chunk_y * MAP_SIDE_X_CHK + chunk_x];
-	}
+	uint32_t map_chunk_x = chunk_x % MAP_SIDE_X_CHK;
+	uint32_t map_chunk_y = chunk_y % MAP_SIDE_Y_CHK;
+	uint32_t map_chunk_z = chunk_z % MAP_SIDE_Z_CHK;
+	TileChunk *result = &map->chunks[map_chunk_z * MAP_SIZE_XY_CHK + map_chunk_y * MAP_SIDE_X_CHK + map_chunk_x];
 
 	return result;
 }
@@ -241,8 +341,40 @@ static uint32_t map_is_tile_walkable(Map *map, uint32_t tile_x, uint32_t tile_y,
 	return is_walkable;
 }
 
-static void map_set_tile_value(Map *map, Arena *arena, uint32_t tile_x, uint32_t tile_y, uint32_t tile_z,
-                               TileType tile_type)
+/**
+ * @brief Hash of a tile for the checksum of the map, the empty tiles do not count
+ */
+static inline uint64_t map_hash_tile(uint32_t tile_x, uint32_t tile_y, uint32_t tile_z, TileType tile_type)
+{
+	uint64_t result = 0;
+
+	if (tile_type != TILE_TYPE_EMPTY) {
+		result = hash_mix(hash_mix(hash_mix(hash_mix(CHECKSUM_SEED, tile_x), tile_y), tile_z), tile_type);
+	}
+
+	return result;
+}
+
+static inline void map_invalidate_path(Map *map, uint32_t chunk_x, uint32_t chunk_y, uint32_t chunk_z)
+{
+	TileChunk *chunk = map_get_chunk(map, chunk_x, chunk_y, chunk_z);
+
+	if (chunk->path) {
+		chunk->path->is_dirty = 1U;
+	}
+}
+
+/**
+ * @brief Hash of a chunk with tiles for the checksum of the map
+ */
+static inline uint64_t map_hash_chunk(uint32_t chunk_x, uint32_t chunk_y, uint32_t chunk_z)
+{
+	uint64_t result = hash_mix(hash_mix(hash_mix(CHECKSUM_SEED, chunk_x), chunk_y), chunk_z);
+
+	return result;
+}
+
+static void map_set_tile_value(Map *map, uint32_t tile_x, uint32_t tile_y, uint32_t tile_z, TileType tile_type)
 {
 	ChunkPosition cpos = map_get_chunk_pos(tile_x, tile_y, tile_z);
 	TileChunk *tilechunk = map_get_chunk(map, cpos.chunk_x, cpos.chunk_y, cpos.chunk_z);
@@ -250,20 +382,33 @@ static void map_set_tile_value(Map *map, Arena *arena, uint32_t tile_x, uint32_t
 	assert(tilechunk);
 
 	if (!tilechunk->tiles) {
-		tilechunk->tiles = ARENA_PUSH_ARRAY(arena, uint32_t, (size_t)CHUNK_SIZE_TL);
+		tilechunk->tiles = pool_alloc(&map->tile_pool);
 		for (uint32_t tile_idx = 0; tile_idx < CHUNK_SIZE_TL; ++tile_idx) {
 			tilechunk->tiles[tile_idx] = TILE_TYPE_EMPTY;
 		}
+
+		map->checksum ^= map_hash_chunk(cpos.chunk_x, cpos.chunk_y, cpos.chunk_z);
 	}
 
 	assert(cpos.tile_x < CHUNK_SIDE_TL);
 	assert(cpos.tile_y < CHUNK_SIDE_TL);
 
-	tilechunk->tiles[cpos.tile_y * CHUNK_SIDE_TL + cpos.tile_x] = tile_type;
+	uint32_t *tile = &tilechunk->tiles[cpos.tile_y * CHUNK_SIDE_TL + cpos.tile_x];
+	map->checksum ^= map_hash_tile(tile_x, tile_y, tile_z, *tile);
+	map->checksum ^= map_hash_tile(tile_x, tile_y, tile_z, tile_type);
+	*tile = tile_type;
+
+	// Note(fredy): the openings of a chunk depend on the tiles across its edges, the neighbors are built again too
+	map_invalidate_path(map, cpos.chunk_x, cpos.chunk_y, cpos.chunk_z);
+	map_invalidate_path(map, cpos.chunk_x + 1, cpos.chunk_y, cpos.chunk_z);
+	map_invalidate_path(map, cpos.chunk_x - 1, cpos.chunk_y, cpos.chunk_z);
+	map_invalidate_path(map, cpos.chunk_x, cpos.chunk_y + 1, cpos.chunk_z);
+	map_invalidate_path(map, cpos.chunk_x, cpos.chunk_y - 1, cpos.chunk_z);
 }
 
 /**
- * @brief Calculates a - b
+ * @brief Calculates a - b. The tile delta is taken on the integers so it wraps around the tile space and stays exact
+ * for positions up to 2^24 tiles apart, which covers anything the simulation compares
  *
  * @param a A position
  * @param b Another position
@@ -274,10 +419,10 @@ static PositionDelta position_substract(const Position *const a, const Position
 	PositionDelta result = {};
 
 	Vtwo delta_xy_tile = {
-		.x = (float)a->tile_x - (float)b->tile_x,
-		.y = (float)a->tile_y - (float)b->tile_y,
+		.x = (float)(int32_t)(a->tile_x - b->tile_x),
+		.y = (float)(int32_t)(a->tile_y - b->tile_y),
 	};
-	float delta_tile_z = (float)a->tile_z - (float)b->tile_z;
+	float delta_tile_z = (float)(int32_t)(a->tile_z - b->tile_z);
 
 	Vtwo delta_xy_m = vtwo_scale(delta_xy_tile, TILE_SIDE_M);
 
@@ -290,6 +435,259 @@ static PositionDelta position_substract(const Position *const a, const Position
 	return result;
 }
 
+static inline int64_t position_offset_to_fixed(float offset_m)
+{
+	int64_t result = float_round_to_int(offset_m * ((float)(1 << POSITION_FIXED_SHIFT) / TILE_SIDE_M));
+
+	return result;
+}
+
+/**
+ * @brief Calculates a - b in fixed point, exact over the whole tile space. Use position_substract when the positions
+ * are known to be close
+ *
+ * @param a A position
+ * @param b Another position
+ * @return PositionDeltaFixed
+ */
+static PositionDeltaFixed position_substract_fixed(const Position *const a, const Position *const b)
+{
+	PositionDeltaFixed result = {};
+
+	// Note(fredy): the unsigned difference read as signed is the shortest way around the wrapping tile space
+	int64_t delta_tile_x = (int32_t)(a->tile_x - b->tile_x);
+	int64_t delta_tile_y = (int32_t)(a->tile_y - b->tile_y);
+
+	result.delta_x_fx = delta_tile_x * (INT64_C(1) << POSITION_FIXED_SHIFT) +
+	                    position_offset_to_fixed(a->offset_m.x) - position_offset_to_fixed(b->offset_m.x);
+	result.delta_y_fx = delta_tile_y * (INT64_C(1) << POSITION_FIXED_SHIFT) +
+	                    position_offset_to_fixed(a->offset_m.y) - position_offset_to_fixed(b->offset_m.y);
+	result.delta_tile_z = (int32_t)(a->tile_z - b->tile_z);
+
+	return result;
+}
+
+/**
+ * @brief Meters of a fixed-point delta, the rounding happens once at the end
+ */
+static PositionDelta position_delta_from_fixed(PositionDeltaFixed delta)
+{
+	PositionDelta result = {};
+
+	float meters_per_fx = TILE_SIDE_M / (float)(1 << POSITION_FIXED_SHIFT);
+
+	result.delta_xy_m.x = (float)delta.delta_x_fx * meters_per_fx;
+	result.delta_xy_m.y = (float)delta.delta_y_fx * meters_per_fx;
+	result.delta_z_m = (float)delta.delta_tile_z * TILE_SIDE_M;
+
+	return result;
+}
+
+// =============================================================================
+// Raycast
+// =============================================================================
+
+typedef struct RayHit {
+	/**
+	 * @brief 0 when the ray covers its whole length over walkable tiles
+	 */
+	uint32_t is_hit;
+
+	/**
+	 * @brief Distance from the origin to where the ray enters the blocking tile, or the length of the ray
+	 */
+	float distance_m;
+
+	/**
+	 * @brief Blocking tile, or the tile where the ray ends
+	 */
+	uint32_t tile_x;
+	uint32_t tile_y;
+
+	/**
+	 * @brief Normal of the face the ray enters the blocking tile through, zero if the origin is already blocked
+	 */
+	Vtwo normal;
+} RayHit;
+
+/**
+ * @brief Origin of a ray split into what the traversal needs, shared by all the rays cast from it
+ */
+typedef struct RayOrigin {
+	Map *map;
+	uint32_t tile_x;
+	uint32_t tile_y;
+	uint32_t tile_z;
+
+	/**
+	 * @brief Position inside of the origin tile from its bottom-left corner, in tiles within [0, 1]
+	 */
+	Vtwo tile_fraction;
+
+	TileChunk *chunk;
+} RayOrigin;
+
+static RayOrigin ray_get_origin(Map *map, Position origin)
+{
+	RayOrigin result = {};
+
+	map_normalize_position(&origin);
+
+	result.map = map;
+	result.tile_x = origin.tile_x;
+	result.tile_y = origin.tile_y;
+	result.tile_z = origin.tile_z;
+	result.tile_fraction = vtwo_add_scalar(vtwo_scale(origin.offset_m, 1.0F / TILE_SIDE_M), 0.5F);
+
+	ChunkPosition cpos = map_get_chunk_pos(origin.tile_x, origin.tile_y, origin.tile_z);
+	result.chunk = map_get_chunk(map, cpos.chunk_x, cpos.chunk_y, cpos.chunk_z);
+
+	return result;
+}
+
+static inline uint32_t ray_is_tile_walkable(const TileChunk *chunk, uint32_t tile_x, uint32_t tile_y)
+{
+	uint32_t is_walkable = 0U;
+
+	// Note(fredy): same as map_get_tile_type, the tiles of the chunks that were never set are not walkable
+	if (chunk->tiles) {
+		TileType tile_type = chunk->tiles[(tile_y & CHUNK_MASK) * CHUNK_SIDE_TL + (tile_x & CHUNK_MASK)];
+		is_walkable = tile_is_walkable(tile_type);
+	}
+
+	return is_walkable;
+}
+
+/**
+ * @brief Walks the tiles crossed by a ray in order (Amanatides-Woo) until one of them is not walkable. The chunk of
+ * the tiles is fetched again only when the ray crosses into another chunk
+ *
+ * @param origin
+ * @param direction Unit direction of the ray
+ * @param length_m Length of the ray
+ * @return RayHit
+ */
+static RayHit ray_trace(const RayOrigin *origin, Vtwo direction, float length_m)
+{
+	RayHit result = {
+		.distance_m = length_m,
+		.tile_x = origin->tile_x,
+		.tile_y = origin->tile_y,
+	};
+
+	uint32_t tile[2] = { origin->tile_x, origin->tile_y };
+	uint32_t chunk_coord[2] = { tile[0] >> CHUNK_SHIFT_BITS, tile[1] >> CHUNK_SHIFT_BITS };
+	TileChunk *chunk = origin->chunk;
+
+	// Distance along the ray to the next tile edge on each axis and between two edges of the same axis
+	float next_edge_m[2] = { FLT_MAX, FLT_MAX };
+	float edge_step_m[2] = { FLT_MAX, FLT_MAX };
+	int32_t tile_step[2] = {};
+
+	for (uint32_t axis = 0; axis < 2; ++axis) {
+		if (direction.e[axis] > 0.0F) {
+			tile_step[axis] = 1;
+			edge_step_m[axis] = TILE_SIDE_M / direction.e[axis];
+			next_edge_m[axis] = (1.0F - origin->tile_fraction.e[axis]) * edge_step_m[axis];
+		} else if (direction.e[axis] < 0.0F) {
+			tile_step[axis] = -1;
+			edge_step_m[axis] = TILE_SIDE_M / -direction.e[axis];
+			next_edge_m[axis] = origin->tile_fraction.e[axis] * edge_step_m[axis];
+		}
+	}
+
+	if (!ray_is_tile_walkable(chunk, tile[0], tile[1])) {
+		result.is_hit = 1U;
+		result.distance_m = 0.0F;
+	}
+
+	while (!result.is_hit && NUMBER_MIN(next_edge_m[0], next_edge_m[1]) <= length_m) {
+		uint32_t axis = next_edge_m[1] < next_edge_m[0] ? 1U : 0U;
+		float distance_m = next_edge_m[axis];
+
+		next_edge_m[axis] += edge_step_m[axis];
+		tile[axis] += (uint32_t)tile_step[axis];
+
+		if ((tile[axis] >> CHUNK_SHIFT_BITS) != chunk_coord[axis]) {
+			chunk_coord[axis] = tile[axis] >> CHUNK_SHIFT_BITS;
+			chunk = map_get_chunk(origin->map, chunk_coord[0], chunk_coord[1], origin->tile_z);
+		}
+
+		if (!ray_is_tile_walkable(chunk, tile[0], tile[1])) {
+			result.is_hit = 1U;
+			result.distance_m = distance_m;
+			result.normal.e[axis] = (float)-tile_step[axis];
+		}
+	}
+
+	result.tile_x = tile[0];
+	result.tile_y = tile[1];
+
+	return result;
+}
+
+/**
+ * @brief Casts a ray over the tiles of the level of the origin, the hitscan of the gameplay
+ *
+ * @param map
+ * @param origin Start of the ray
+ * @param direction Unit direction of the ray
+ * @param length_m Length of the ray
+ * @return RayHit
+ */
+static RayHit ray_cast(Map *map, Position origin, Vtwo direction, float length_m)
+{
+	RayOrigin ray_origin = ray_get_origin(map, origin);
+	RayHit result = ray_trace(&ray_origin, direction, length_m);
+
+	return result;
+}
+
+/**
+ * @brief Casts many rays from one origin, for visibility polygons and fog of war
+ *
+ * @param map
+ * @param arena Where the hits are pushed, one per direction and in the same order
+ * @param origin Start of the rays
+ * @param directions Unit directions of the rays
+ * @param ray_count
+ * @param length_m Length of every ray
+ * @return RayHit*
+ */
+static RayHit *ray_cast_batch(Map *map, Arena *arena, Position origin, const Vtwo *directions, uint32_t ray_count,
+                              float length_m)
+{
+	RayHit *result = ARENA_PUSH_ARRAY(arena, RayHit, ray_count);
+	RayOrigin ray_origin = ray_get_origin(map, origin);
+
+	for (uint32_t ray_idx = 0; ray_idx < ray_count; ++ray_idx) {
+		result[ray_idx] = ray_trace(&ray_origin, directions[ray_idx], length_m);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Whether there are only walkable tiles between two positions, the positions in different levels never see
+ * each other
+ */
+static uint32_t ray_has_line_of_sight(Map *map, Position from, Position to)
+{
+	uint32_t has_line_of_sight = from.tile_z == to.tile_z;
+
+	if (has_line_of_sight) {
+		Vtwo delta_m = position_substract(&to, &from).delta_xy_m;
+		float length_m = vtwo_norm(delta_m);
+
+		if (length_m > FLT_EPSILON) {
+			RayHit hit = ray_cast(map, from, vtwo_scale(delta_m, 1.0F / length_m), length_m);
+			has_line_of_sight = !hit.is_hit;
+		}
+	}
+
+	return has_line_of_sight;
+}
+
 // =============================================================================
 // Rendering
 // =============================================================================
@@ -453,9 +851,10 @@ static void offscreen_render_bitmap(GameOffscreenBuffer *const restrict back_buf
 	assert(source_offset_x_px < bitmap->width_px);
 	assert(source_offset_y_px < bitmap->height_px);
 
-	uint32_t blit_width_px = min(back_buffer->width_px - target_offset_x_px, bitmap->width_px - source_offset_x_px);
+	uint32_t blit_width_px =
+		NUMBER_MIN(back_buffer->width_px - target_offset_x_px, bitmap->width_px - source_offset_x_px);
 	uint32_t blit_height_px =
-		min(back_buffer->height_px - target_offset_y_px, bitmap->height_px - source_offset_y_px);
+		NUMBER_MIN(back_buffer->height_px - target_offset_y_px, bitmap->height_px - source_offset_y_px);
 
 	// Register order: AA RR GG BB. Top-down
 	uint32_t *target_px_ptr = (uint32_t *)back_buffer->top_left_px +
@@ -563,44 +962,248 @@ static AppBitmap file_load_bitmap_debug(const char *const filepath, file_read_de
 // Collision detection
 // =============================================================================
 
+#define COLLISION_LANES 8
+
+typedef struct SweepHit {
+	Vtwo normal;
+
+	/**
+	 * @brief Fraction of the displacement that can be travelled, in [0, 1]
+	 */
+	float time;
+
+	/**
+	 * @brief Index of the obstacle that was hit, UINT32_MAX if nothing was hit
+	 */
+	uint32_t obstacle_idx;
+} SweepHit;
+
+#if LIB_SIMD_AVX2
+/**
+ * @brief Tests whether a moving point hits a wall segment, for COLLISION_LANES walls at a time.
+ *
+ * The wall is a line at @p wall on the axis of the movement, bounded on the perpendicular axis by
+ * [-@p extent_perp, @p extent_perp]. Positions are relative to the center of the obstacle.
+ *
+ * @param wall Position of the wall on the axis
+ * @param rel Position of the mover on the axis
+ * @param rel_perp Position of the mover on the perpendicular axis
+ * @param inv_delta Inverse of the displacement on the axis
+ * @param delta_perp Displacement on the perpendicular axis
+ * @param extent_perp Half extent of the wall
+ * @param active Mask of the lanes that can be hit
+ * @param best_time In/out. Earliest hit time of every lane, updated with the new hits.
+ * @return __m256 Mask of the lanes whose wall was hit before @p best_time
+ */
+static inline __m256 collision_wall_test_lanes(__m256 wall, __m256 rel, __m256 rel_perp, __m256 inv_delta,
+                                               __m256 delta_perp, __m256 extent_perp, __m256 active,
+                                               __m256 *best_time)
+{
+	__m256 time = _mm256_mul_ps(_mm256_sub_ps(wall, rel), inv_delta);
+	__m256 perp = _mm256_add_ps(_mm256_mul_ps(delta_perp, time), rel_perp);
+	__m256 min_perp = _mm256_sub_ps(_mm256_setzero_ps(), extent_perp);
+
+	__m256 was_hit = _mm256_and_ps(active, _mm256_cmp_ps(time, _mm256_setzero_ps(), _CMP_GE_OQ));
+	was_hit = _mm256_and_ps(was_hit, _mm256_cmp_ps(time, *best_time, _CMP_LT_OQ));
+	was_hit = _mm256_and_ps(was_hit, _mm256_cmp_ps(perp, min_perp, _CMP_GE_OQ));
+	was_hit = _mm256_and_ps(was_hit, _mm256_cmp_ps(perp, extent_perp, _CMP_LE_OQ));
+
+	*best_time = _mm256_blendv_ps(*best_time, time, was_hit);
+
+	return was_hit;
+}
+#else
+/**
+ * @brief Tests whether a moving point hits a wall segment, the scalar version of collision_wall_test_lanes
+ *
+ * @param wall Position of the wall on the axis
+ * @param rel Position of the mover on the axis
+ * @param rel_perp Position of the mover on the perpendicular axis
+ * @param inv_delta Inverse of the displacement on the axis
+ * @param delta_perp Displacement on the perpendicular axis
+ * @param extent_perp Half extent of the wall
+ * @param best_time In/out. Earliest hit time, updated with the new hit.
+ * @return uint32_t 1U if the wall was hit before @p best_time
+ */
+static inline uint32_t collision_wall_test(float wall, float rel, float rel_perp, float inv_delta, float delta_perp,
+                                           float extent_perp, float *best_time)
+{
+	float time = (wall - rel) * inv_delta;
+	float perp = delta_perp * time + rel_perp;
+	uint32_t result = time >= 0.0F && time < *best_time && perp >= -extent_perp && perp <= extent_perp;
+
+	if (result) {
+		*best_time = time;
+	}
+
+	return result;
+}
+#endif
+
 /**
- * @brief Tests whether a moving entity hits a wall segment during its movement step.
+ * @brief Sweeps a moving box against a set of static boxes, COLLISION_LANES obstacles at a time.
  *
- * Uses parametric ray-casting to determine if the entity's path intersects the wall.
- * The wall is treated as a vertical line at @p wall_x, bounded vertically by
- * [@p min_y, @p max_y]. If a valid hit is found, @p max_time is clamped to just
- * before the collision time to prevent tunnelling.
+ * The obstacles are given as structure of arrays. Every box is grown by the half extents of the mover
+ * (Minkowski sum), so the mover is tested as a point against the four walls of every grown box. The
+ * displacement is inverted once for all the obstacles. The time of the hit is moved back a bit to prevent
+ * tunnelling.
  *
- * @param wall_x X coordinate of the vertical wall.
- * @param rel_x Entity's X position relative to the wall's reference frame.
- * @param rel_y Entity's Y position relative to the wall's reference frame.
- * @param delta_x X component of the entity's movement vector for this step.
- * @param delta_y Y component of the entity's movement vector for this step.
- * @param max_time In/out. The current maximum allowable travel time (t in [0,1]).
- *                 Updated to the hit time (minus epsilon) when a hit occurs.
- * @param min_y Minimum Y extent of the wall segment.
- * @param max_y Maximum Y extent of the wall segment.
- * @return 0 if the wall was not hit, 1 if a valid collision was detected.
- */
-inline static uint32_t wall_test(float wall_x, float rel_x, float rel_y, float delta_x, float delta_y, float *max_time,
-                                 float min_y, float max_y)
-{
-	uint32_t was_wall_hit = 0U;
-	float t_epsilon = 0.001F;
-
-	if (delta_x != 0.0F) {
-		float t_result = (wall_x - rel_x) / delta_x;
-		float y = delta_y * t_result + rel_y;
-
-		if (t_result >= 0.0F && *max_time > t_result) {
-			if (y >= min_y && y <= max_y) {
-				*max_time = max(0.0F, t_result - t_epsilon);
-				was_wall_hit = 1U;
+ * @param center_x Obstacle centers
+ * @param center_y
+ * @param half_width Obstacle half extents
+ * @param half_height
+ * @param collides_mask UINT32_MAX for the obstacles that can be hit, 0 for the rest
+ * @param obstacle_count Multiple of COLLISION_LANES, the arrays are read up to it
+ * @param ignore_idx An obstacle to skip, usually the mover itself
+ * @param mover_pos Center of the mover
+ * @param mover_half_dim Half extents of the mover
+ * @param displacement Movement of the mover for this step
+ * @return SweepHit The earliest hit, the obstacle with the lowest index wins the ties
+ */
+static SweepHit collision_sweep(const float *center_x, const float *center_y, const float *half_width,
+                                const float *half_height, const uint32_t *collides_mask, uint32_t obstacle_count,
+                                uint32_t ignore_idx, Vtwo mover_pos, Vtwo mover_half_dim, Vtwo displacement)
+{
+	assert(obstacle_count % COLLISION_LANES == 0);
+
+	SweepHit result = {
+		.time = 1.0F,
+		.obstacle_idx = UINT32_MAX,
+	};
+	float earliest_time = 1.0F;
+
+#if LIB_SIMD_AVX2
+	// Note(fredy): an axis without displacement has no hits, its inverse is masked out
+	__m256 moves_x = _mm256_castsi256_ps(_mm256_set1_epi32(displacement.x != 0.0F ? -1 : 0));
+	__m256 moves_y = _mm256_castsi256_ps(_mm256_set1_epi32(displacement.y != 0.0F ? -1 : 0));
+	__m256 inv_delta_x = _mm256_set1_ps(displacement.x != 0.0F ? 1.0F / displacement.x : 0.0F);
+	__m256 inv_delta_y = _mm256_set1_ps(displacement.y != 0.0F ? 1.0F / displacement.y : 0.0F);
+	__m256 delta_x = _mm256_set1_ps(displacement.x);
+	__m256 delta_y = _mm256_set1_ps(displacement.y);
+	__m256 mover_x = _mm256_set1_ps(mover_pos.x);
+	__m256 mover_y = _mm256_set1_ps(mover_pos.y);
+	__m256 mover_half_width = _mm256_set1_ps(mover_half_dim.x);
+	__m256 mover_half_height = _mm256_set1_ps(mover_half_dim.y);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1.0F);
+	__m256 minus_one = _mm256_set1_ps(-1.0F);
+
+	__m256i ignore = _mm256_set1_epi32((int32_t)ignore_idx);
+	__m256i lane_idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i lane_step = _mm256_set1_epi32(COLLISION_LANES);
+
+	__m256 best_time = one;
+	__m256 best_normal_x = zero;
+	__m256 best_normal_y = zero;
+	__m256i best_idx = _mm256_set1_epi32(-1);
+
+	for (uint32_t obstacle_idx = 0; obstacle_idx < obstacle_count; obstacle_idx += COLLISION_LANES) {
+		__m256 rel_x = _mm256_sub_ps(mover_x, _mm256_loadu_ps(center_x + obstacle_idx));
+		__m256 rel_y = _mm256_sub_ps(mover_y, _mm256_loadu_ps(center_y + obstacle_idx));
+		__m256 radius_w = _mm256_add_ps(_mm256_loadu_ps(half_width + obstacle_idx), mover_half_width);
+		__m256 radius_h = _mm256_add_ps(_mm256_loadu_ps(half_height + obstacle_idx), mover_half_height);
+
+		__m256i collides = _mm256_loadu_si256((const __m256i *)(collides_mask + obstacle_idx));
+		__m256i is_ignored = _mm256_cmpeq_epi32(lane_idx, ignore);
+		__m256 active = _mm256_castsi256_ps(_mm256_andnot_si256(is_ignored, collides));
+		__m256 active_x = _mm256_and_ps(active, moves_x);
+		__m256 active_y = _mm256_and_ps(active, moves_y);
+
+		__m256 was_hit = collision_wall_test_lanes(_mm256_sub_ps(zero, radius_w), rel_x, rel_y, inv_delta_x,
+		                                           delta_y, radius_h, active_x, &best_time);
+		best_normal_x = _mm256_blendv_ps(best_normal_x, minus_one, was_hit);
+		best_normal_y = _mm256_blendv_ps(best_normal_y, zero, was_hit);
+		best_idx = _mm256_blendv_epi8(best_idx, lane_idx, _mm256_castps_si256(was_hit));
+
+		was_hit = collision_wall_test_lanes(radius_w, rel_x, rel_y, inv_delta_x, delta_y, radius_h, active_x,
+		                                    &best_time);
+		best_normal_x = _mm256_blendv_ps(best_normal_x, one, was_hit);
+		best_normal_y = _mm256_blendv_ps(best_normal_y, zero, was_hit);
+		best_idx = _mm256_blendv_epi8(best_idx, lane_idx, _mm256_castps_si256(was_hit));
+
+		was_hit = collision_wall_test_lanes(_mm256_sub_ps(zero, radius_h), rel_y, rel_x, inv_delta_y, delta_x,
+		                                    radius_w, active_y, &best_time);
+		best_normal_x = _mm256_blendv_ps(best_normal_x, zero, was_hit);
+		best_normal_y = _mm256_blendv_ps(best_normal_y, minus_one, was_hit);
+		best_idx = _mm256_blendv_epi8(best_idx, lane_idx, _mm256_castps_si256(was_hit));
+
+		was_hit = collision_wall_test_lanes(radius_h, rel_y, rel_x, inv_delta_y, delta_x, radius_w, active_y,
+		                                    &best_time);
+		best_normal_x = _mm256_blendv_ps(best_normal_x, zero, was_hit);
+		best_normal_y = _mm256_blendv_ps(best_normal_y, one, was_hit);
+		best_idx = _mm256_blendv_epi8(best_idx, lane_idx, _mm256_castps_si256(was_hit));
+
+		lane_idx = _mm256_add_epi32(lane_idx, lane_step);
+	}
+
+	alignas(32) float lane_times[COLLISION_LANES];
+	alignas(32) float lane_normals_x[COLLISION_LANES];
+	alignas(32) float lane_normals_y[COLLISION_LANES];
+	alignas(32) uint32_t lane_idxs[COLLISION_LANES];
+	_mm256_store_ps(lane_times, best_time);
+	_mm256_store_ps(lane_normals_x, best_normal_x);
+	_mm256_store_ps(lane_normals_y, best_normal_y);
+	_mm256_store_si256((__m256i *)lane_idxs, best_idx);
+
+	for (uint32_t lane = 0; lane < COLLISION_LANES; ++lane) {
+		if (lane_idxs[lane] != UINT32_MAX &&
+		    (lane_times[lane] < earliest_time ||
+		     (!(lane_times[lane] > earliest_time) && lane_idxs[lane] < result.obstacle_idx))) {
+			earliest_time = lane_times[lane];
+			result.obstacle_idx = lane_idxs[lane];
+			result.normal = (Vtwo){ .x = lane_normals_x[lane], .y = lane_normals_y[lane] };
+		}
+	}
+#else
+	// Note(fredy): the obstacles are visited in order and only an earlier time replaces the hit, so the lowest
+	// index wins the ties like in the lanes
+	float inv_delta_x = displacement.x != 0.0F ? 1.0F / displacement.x : 0.0F;
+	float inv_delta_y = displacement.y != 0.0F ? 1.0F / displacement.y : 0.0F;
+
+	for (uint32_t obstacle_idx = 0; obstacle_idx < obstacle_count; ++obstacle_idx) {
+		if (collides_mask[obstacle_idx] && obstacle_idx != ignore_idx) {
+			float rel_x = mover_pos.x - center_x[obstacle_idx];
+			float rel_y = mover_pos.y - center_y[obstacle_idx];
+			float radius_w = half_width[obstacle_idx] + mover_half_dim.x;
+			float radius_h = half_height[obstacle_idx] + mover_half_dim.y;
+
+			if (displacement.x != 0.0F) {
+				if (collision_wall_test(-radius_w, rel_x, rel_y, inv_delta_x, displacement.y, radius_h,
+				                        &earliest_time)) {
+					result.obstacle_idx = obstacle_idx;
+					result.normal = (Vtwo){ .x = -1.0F, .y = 0.0F };
+				}
+
+				if (collision_wall_test(radius_w, rel_x, rel_y, inv_delta_x, displacement.y, radius_h,
+				                        &earliest_time)) {
+					result.obstacle_idx = obstacle_idx;
+					result.normal = (Vtwo){ .x = 1.0F, .y = 0.0F };
+				}
+			}
+
+			if (displacement.y != 0.0F) {
+				if (collision_wall_test(-radius_h, rel_y, rel_x, inv_delta_y, displacement.x, radius_w,
+				                        &earliest_time)) {
+					result.obstacle_idx = obstacle_idx;
+					result.normal = (Vtwo){ .x = 0.0F, .y = -1.0F };
+				}
+
+				if (collision_wall_test(radius_h, rel_y, rel_x, inv_delta_y, displacement.x, radius_w,
+				                        &earliest_time)) {
+					result.obstacle_idx = obstacle_idx;
+					result.normal = (Vtwo){ .x = 0.0F, .y = 1.0F };
+				}
 			}
 		}
 	}
+#endif
+
+	if (result.obstacle_idx != UINT32_MAX) {
+		float t_epsilon = 0.001F;
+		result.time = NUMBER_MAX(0.0F, earliest_time - t_epsilon);
+	}
 
-	return was_wall_hit;
+	return result;
 }
 
 // =============================================================================
@@ -619,6 +1222,51 @@ inline static uint32_t wall_test(float wall_x, float rel_x, float rel_y, float d
 
 #define MAX_ENTITIES 256
 
+// Fixed step of the simulation, independent of the frame rate
+#define SIM_STEP_S (1.0F / 60.0F)
+
+// Longest frame time that is simulated, the rest is dropped
+#define SIM_MAX_FRAME_TIME_S (0.25F)
+
+// An entity slower than this, on the ground, is at rest
+#define SIM_REST_SPEED_MPS (0.01F)
+
+// Steps at rest before an entity falls asleep
+#define SIM_SLEEP_STEPS 30U
+
+// Bytes of the frame arena that stay committed between frames
+#define FRAME_ARENA_KEEP_BYTES MB_TO_BYTES(16ULL)
+
+// Frames in a row that have to fit in FRAME_ARENA_KEEP_BYTES before the rest of the frame arena is given back
+#define FRAME_ARENA_DECOMMIT_FRAMES 120U
+
+// Span of the bounds around the camera in tiles
+#define CAMERA_SPAN_X_TL (17U * 3U)
+#define CAMERA_SPAN_Y_TL (9U * 3U)
+
+// Span of the bounds around the camera in tiles where the entities are kept LOW
+#define LOW_SPAN_X_TL (CAMERA_SPAN_X_TL * 3U)
+#define LOW_SPAN_Y_TL (CAMERA_SPAN_Y_TL * 3U)
+
+// Every step ticks 1/LOW_TICK_DIVISOR of the LOW entities, so each one is ticked every LOW_TICK_DIVISOR steps
+#define LOW_TICK_DIVISOR 8U
+
+// Span of the flow field around its target in tiles, the entities that are not LOW do not walk
+#define FLOW_FIELD_SIDE_X_TL LOW_SPAN_X_TL
+#define FLOW_FIELD_SIDE_Y_TL LOW_SPAN_Y_TL
+#define FLOW_FIELD_SIZE_TL (FLOW_FIELD_SIDE_X_TL * FLOW_FIELD_SIDE_Y_TL)
+
+// Cost of the tiles of the flow field with no path to the target
+#define FLOW_COST_UNREACHABLE UINT16_MAX
+
+// Index of the tiles out of the flow field
+#define FLOW_TILE_NONE UINT32_MAX
+
+// Note(fredy): the visible area is a square that covers the camera span
+#define VISIBILITY_RADIUS_TL (CAMERA_SPAN_X_TL / 2U + 1U)
+#define VISIBILITY_SIDE_CHK (2U * VISIBILITY_RADIUS_TL / (uint32_t)CHUNK_SIDE_TL + 2U)
+#define VISIBILITY_MAX_CHUNKS (VISIBILITY_SIDE_CHK * VISIBILITY_SIDE_CHK)
+
 typedef struct World {
 	Map *map;
 } World;
@@ -646,11 +1294,12 @@ typedef enum FacingDirection : uint8_t {
 	FACING_DIRECTION_COUNT,
 } FacingDirection;
 
-typedef struct HighEntity {
+typedef struct LowEntity {
 	/**
-	 * @brief Position in meters, relative to the camera
+	 * @brief State at the end of the step before the last one, to interpolate the rendering
 	 */
-	Vtwo pos_m;
+	Position prev_pos;
+	float prev_z_m;
 
 	/**
 	 * @brief Velocity in meters per second
@@ -660,37 +1309,108 @@ typedef struct HighEntity {
 	float z_m;
 	float z_speed_mps;
 
-	uint32_t tile_z;
+	/**
+	 * @brief Consecutive steps the entity has been at rest, it sleeps from SIM_SLEEP_STEPS on
+	 */
+	uint32_t rest_step_count;
 
-	FacingDirection facing;
-} HighEntity;
-
-typedef struct LowEntity {
-	Position pos;
 	FacingDirection facing;
 } LowEntity;
 
-typedef struct DormantEntity {
-	Position pos;
+/**
+ * @brief Collision shape of an entity, it is read with the position every time the entity is simulated
+ */
+typedef struct EntityShape {
 	float width_m;
 	float height_m;
-
-	int32_t delta_tile_z;
 	uint8_t collides;
+} EntityShape;
 
+/**
+ * @brief Data of an entity that is only read now and then
+ */
+typedef struct EntityInfo {
+	int32_t delta_tile_z;
 	EntityType entity_type;
-} DormantEntity;
+} EntityInfo;
+
+typedef enum FlowDirection : uint8_t {
+	FLOW_DIRECTION_NONE,
+	FLOW_DIRECTION_RIGHT,
+	FLOW_DIRECTION_UP_RIGHT,
+	FLOW_DIRECTION_UP,
+	FLOW_DIRECTION_UP_LEFT,
+	FLOW_DIRECTION_LEFT,
+	FLOW_DIRECTION_DOWN_LEFT,
+	FLOW_DIRECTION_DOWN,
+	FLOW_DIRECTION_DOWN_RIGHT,
+	FLOW_DIRECTION_COUNT,
+} FlowDirection;
+
+/**
+ * @brief Paths towards a target from the tiles around it, the entities that follow it read a single direction
+ */
+typedef struct FlowField {
+	/**
+	 * @brief Bottom-left tile of the field
+	 */
+	uint32_t min_tile_x;
+	uint32_t min_tile_y;
+	uint32_t tile_z;
 
-typedef struct Entity {
-	LowEntity *low;
-	DormantEntity *dormant;
-	HighEntity *high;
+	uint32_t target_tile_x;
+	uint32_t target_tile_y;
 
-	EntityResidence residence;
-} Entity;
+	uint32_t is_valid;
+
+	/**
+	 * @brief Integration field, steps from every tile to the target
+	 */
+	uint16_t costs[FLOW_FIELD_SIZE_TL];
+
+	/**
+	 * @brief Direction field, the neighbor every tile goes to
+	 */
+	FlowDirection directions[FLOW_FIELD_SIZE_TL];
+} FlowField;
+
+/**
+ * @brief Tiles seen from the tile of the entity tracked by the camera, computed again only when it steps on another
+ * tile
+ */
+typedef struct Visibility {
+	uint32_t is_valid;
+	uint32_t origin_tile_x;
+	uint32_t origin_tile_y;
+	uint32_t origin_tile_z;
+
+	/**
+	 * @brief Chunks with tiles seen, they are cleared before the next computation
+	 */
+	uint32_t chunk_count;
+	ChunkVisibility *chunks[VISIBILITY_MAX_CHUNKS];
+} Visibility;
+
+/**
+ * @brief Compact list of the indexes of the entities that share a residence
+ */
+typedef struct EntityList {
+	uint32_t count;
+	uint32_t entity_idxs[MAX_ENTITIES];
+} EntityList;
 
 typedef struct Game {
 	Arena arena;
+
+	/**
+	 * @brief Scratch memory over the transient storage, it is reset at the start of every frame
+	 */
+	Arena frame_arena;
+
+	/**
+	 * @brief Frames in a row that used less than FRAME_ARENA_KEEP_BYTES of the frame arena
+	 */
+	uint32_t frame_arena_small_frame_count;
 	World *world;
 
 	AppBitmap backdrop;
@@ -703,270 +1423,2772 @@ typedef struct Game {
 	uint32_t entity_tracked_by_camera_idx;
 	uint32_t entity_count;
 	EntityResidence entity_residences[MAX_ENTITIES];
-	HighEntity high_entities[MAX_ENTITIES];
+
+	/**
+	 * @brief Position of every entity inside the list of its residence, on the level of the list
+	 */
+	uint32_t entity_list_idxs[MAX_ENTITIES];
+	uint32_t entity_levels[MAX_ENTITIES];
+
+	/**
+	 * @brief Residence lists of every level of the map, an entity is in the lists of the level of its tile_z
+	 */
+	EntityList residence_lists[MAP_SIDE_Z_CHK][ENTITY_RESIDENCE_COUNT];
+
+	/**
+	 * @brief The entities are split in streams indexed by entity, the position and the shape are hot, they are
+	 * read every step, the info is cold
+	 */
+	Position entity_positions[MAX_ENTITIES];
+	EntityShape entity_shapes[MAX_ENTITIES];
 	LowEntity low_entities[MAX_ENTITIES];
-	DormantEntity dormant_entities[MAX_ENTITIES];
+	EntityInfo entity_infos[MAX_ENTITIES];
 
 	Position camera_position;
+
+	/**
+	 * @brief Time that was not simulated yet, less than a step
+	 */
+	float sim_accumulator_s;
+
+	/**
+	 * @brief Position in the LOW list of the next entity to tick
+	 */
+	uint32_t low_tick_cursor;
+
+	/**
+	 * @brief Links of the entity lists of the chunks, the spatial index, with the chunk each entity is in
+	 */
+	TileChunk *entity_chunks[MAX_ENTITIES];
+	uint32_t entity_next_idxs[MAX_ENTITIES];
+	uint32_t entity_prev_idxs[MAX_ENTITIES];
+
+	/**
+	 * @brief Hash of the state of every entity, and their XOR, updated as the entities change
+	 */
+	uint64_t entity_hashes[MAX_ENTITIES];
+	uint64_t entities_checksum;
+
+	FlowField flow_field;
+
+	Visibility visibility;
 } Game;
 
-static void game_set_entity_residence(Game *game, uint32_t entity_idx, EntityResidence residence)
+// =============================================================================
+// Spatial Index
+// =============================================================================
+
+// Largest half dimension of an entity in tiles, rounded up
+#define SPATIAL_MARGIN_TL 1U
+
+/**
+ * @brief Entities found by a spatial query, the indexes live in the arena passed to the query
+ */
+typedef struct SpatialQuery {
+	uint32_t count;
+	uint32_t *entity_idxs;
+} SpatialQuery;
+
+static void spatial_unlink_entity(Game *game, uint32_t entity_idx)
 {
-	if (residence == ENTITY_RESIDENCE_HIGH && game->entity_residences[entity_idx] != ENTITY_RESIDENCE_HIGH) {
-		HighEntity *entity_high = &game->high_entities[entity_idx];
-		DormantEntity *entity_dormant = &game->dormant_entities[entity_idx];
+	TileChunk *chunk = game->entity_chunks[entity_idx];
+	uint32_t next_idx = game->entity_next_idxs[entity_idx];
+	uint32_t prev_idx = game->entity_prev_idxs[entity_idx];
 
-		PositionDelta delta = position_substract(&entity_dormant->pos, &game->camera_position);
-		entity_high->pos_m = delta.delta_xy_m;
-		entity_high->vel_mps = (Vtwo){ .x = 0, .y = 0 };
-		entity_high->tile_z = entity_dormant->pos.tile_z;
-		entity_high->facing = FACING_DIRECTION_RIGHT;
+	if (prev_idx) {
+		game->entity_next_idxs[prev_idx] = next_idx;
+	} else {
+		chunk->first_entity_idx = next_idx;
 	}
 
-	game->entity_residences[entity_idx] = residence;
+	if (next_idx) {
+		game->entity_prev_idxs[next_idx] = prev_idx;
+	}
+
+	game->entity_chunks[entity_idx] = nullptr;
 }
 
-inline static Entity game_get_entity(Game *game, uint32_t entity_idx)
+/**
+ * @brief Moves an entity to the list of the chunk under its position, it has to be called every time the
+ * position of the entity changes
+ */
+static void spatial_update_entity(Game *game, uint32_t entity_idx)
 {
-	Entity entity = {};
+	assert(entity_idx != 0);
+
+	Position pos = game->entity_positions[entity_idx];
+	ChunkPosition cpos = map_get_chunk_pos(pos.tile_x, pos.tile_y, pos.tile_z);
+	TileChunk *chunk = map_get_chunk(game->world->map, cpos.chunk_x, cpos.chunk_y, cpos.chunk_z);
+
+	if (chunk != game->entity_chunks[entity_idx]) {
+		if (game->entity_chunks[entity_idx]) {
+			spatial_unlink_entity(game, entity_idx);
+		}
 
-	assert(entity_idx < game->entity_count);
+		game->entity_chunks[entity_idx] = chunk;
+		game->entity_prev_idxs[entity_idx] = 0;
+		game->entity_next_idxs[entity_idx] = chunk->first_entity_idx;
 
-	entity.residence = game->entity_residences[entity_idx];
-	entity.dormant = &game->dormant_entities[entity_idx];
-	entity.low = &game->low_entities[entity_idx];
-	entity.high = &game->high_entities[entity_idx];
+		if (chunk->first_entity_idx) {
+			game->entity_prev_idxs[chunk->first_entity_idx] = entity_idx;
+		}
 
-	return entity;
+		chunk->first_entity_idx = entity_idx;
+	}
 }
 
-static void game_move_entity(Game *game, Entity entity, Vtwo acceleration_mpssq, float time_delta_s)
+/**
+ * @brief Gathers the entities over the chunks that cover the tiles around a position, on the same tile_z.
+ * The caller filters the result with an exact test.
+ *
+ * @param game
+ * @param arena Where the result is pushed
+ * @param center
+ * @param radius_x_tl Tiles gathered to each side of the center on the x axis
+ * @param radius_y_tl Tiles gathered to each side of the center on the y axis
+ * @return SpatialQuery
+ */
+static SpatialQuery spatial_gather(Game *game, Arena *arena, Position center, uint32_t radius_x_tl,
+                                   uint32_t radius_y_tl)
 {
-	float norm_sq = vtwo_norm_sq(acceleration_mpssq);
-	if (norm_sq > 1.0F) {
-		acceleration_mpssq = vtwo_scale(acceleration_mpssq, 1.0F / sqrtf(norm_sq));
+	SpatialQuery result = {};
+	result.entity_idxs = ARENA_PUSH_ARRAY(arena, uint32_t, game->entity_count);
+
+	uint32_t min_chunk_x = (center.tile_x - radius_x_tl) >> CHUNK_SHIFT_BITS;
+	uint32_t min_chunk_y = (center.tile_y - radius_y_tl) >> CHUNK_SHIFT_BITS;
+	uint32_t max_chunk_x = (center.tile_x + radius_x_tl) >> CHUNK_SHIFT_BITS;
+	uint32_t max_chunk_y = (center.tile_y + radius_y_tl) >> CHUNK_SHIFT_BITS;
+
+	// Note(fredy): the chunk coordinates wrap with the tiles, and a chunk of the index is never visited twice
+	uint32_t chunk_mask = UINT32_MAX >> CHUNK_SHIFT_BITS;
+	uint32_t chunk_count_x = NUMBER_MIN(((max_chunk_x - min_chunk_x) & chunk_mask) + 1, MAP_SIDE_X_CHK);
+	uint32_t chunk_count_y = NUMBER_MIN(((max_chunk_y - min_chunk_y) & chunk_mask) + 1, MAP_SIDE_Y_CHK);
+
+	for (uint32_t chunk_y = 0; chunk_y < chunk_count_y; ++chunk_y) {
+		for (uint32_t chunk_x = 0; chunk_x < chunk_count_x; ++chunk_x) {
+			TileChunk *chunk = map_get_chunk(game->world->map, min_chunk_x + chunk_x,
+			                                     min_chunk_y + chunk_y, center.tile_z);
+
+			for (uint32_t entity_idx = chunk->first_entity_idx; entity_idx;
+			     entity_idx = game->entity_next_idxs[entity_idx]) {
+				if (game->entity_positions[entity_idx].tile_z == center.tile_z) {
+					assert(result.count < game->entity_count);
+					result.entity_idxs[result.count++] = entity_idx;
+				}
+			}
+		}
 	}
 
-	// Apply the drag
-	float speed_mps = 50.0F;
-	acceleration_mpssq = vtwo_scale(acceleration_mpssq, speed_mps);
-	acceleration_mpssq = vtwo_sub(acceleration_mpssq, vtwo_scale(entity.high->vel_mps, 8.0F));
+	return result;
+}
 
-	float time_delta_s_sq = float_square(time_delta_s);
+static inline uint32_t spatial_get_radius_tl(float distance_m)
+{
+	uint32_t result = float_ceil_to_uint(distance_m / TILE_SIDE_M) + SPATIAL_MARGIN_TL;
 
-	// Kinematic equation: 1/2*a*t^2
-	Vtwo acceleration_displacement_m = vtwo_scale(acceleration_mpssq, 0.5F * time_delta_s_sq);
+	return result;
+}
 
-	// Kinematic equation: v*t
-	Vtwo velocity_displacement_m = vtwo_scale(entity.high->vel_mps, time_delta_s);
+/**
+ * @brief Finds the entities whose position is inside a rectangle
+ *
+ * @param game
+ * @param arena Where the result is pushed
+ * @param center Center of the rectangle
+ * @param dim_m Dimensions of the rectangle
+ * @return SpatialQuery
+ */
+static SpatialQuery spatial_query_rect(Game *game, Arena *arena, Position center, Vtwo dim_m)
+{
+	SpatialQuery result = spatial_gather(game, arena, center, spatial_get_radius_tl(dim_m.x * 0.5F),
+	                                     spatial_get_radius_tl(dim_m.y * 0.5F));
+	AppRect rect = rectangle((Vtwo){}, dim_m);
+	uint32_t count = 0;
 
-	// Kinematic equation: p' = 1/2*a'*t^2 + v'*t + p
-	Vtwo displacement_m = vtwo_add(acceleration_displacement_m, velocity_displacement_m);
+	for (uint32_t result_idx = 0; result_idx < result.count; ++result_idx) {
+		uint32_t entity_idx = result.entity_idxs[result_idx];
+		PositionDelta delta = position_substract(&game->entity_positions[entity_idx], &center);
 
-	// Kinematic equation: v' = a*t + v
-	entity.high->vel_mps = vtwo_add(vtwo_scale(acceleration_mpssq, time_delta_s), entity.high->vel_mps);
+		if (rectangle_contains(rect, delta.delta_xy_m)) {
+			result.entity_idxs[count++] = entity_idx;
+		}
+	}
 
-	Vtwo new_pos = vtwo_add(entity.high->pos_m, displacement_m);
+	result.count = count;
 
-	// uint32_t start_tile_x = NUMBER_MIN(old_hero_position.tile_x, new_hero_position.tile_x);
-	// uint32_t end_tile_x = NUMBER_MAX(old_hero_position.tile_x, new_hero_position.tile_x);
-	// uint32_t start_tile_y = NUMBER_MIN(old_hero_position.tile_y, new_hero_position.tile_y);
-	// uint32_t end_tile_y = NUMBER_MAX(old_hero_position.tile_y, new_hero_position.tile_y);
+	return result;
+}
 
-	// Adjust the search space to take into acount the hero dimensions
-	// start_tile_x -= HERO_WIDTH_TL;
-	// start_tile_y -= HERO_HEIGHT_TL;
-	// end_tile_x += HERO_WIDTH_TL;
-	// end_tile_y += HERO_HEIGHT_TL;
+/**
+ * @brief Finds the entities whose position is at most radius_m away from the center
+ */
+static SpatialQuery spatial_query_radius(Game *game, Arena *arena, Position center, float radius_m)
+{
+	uint32_t radius_tl = spatial_get_radius_tl(radius_m);
+	SpatialQuery result = spatial_gather(game, arena, center, radius_tl, radius_tl);
+	float radius_sq = float_square(radius_m);
+	uint32_t count = 0;
 
-	// uint32_t tile_z = new_hero_position.tile_z;
+	for (uint32_t result_idx = 0; result_idx < result.count; ++result_idx) {
+		uint32_t entity_idx = result.entity_idxs[result_idx];
+		PositionDelta delta = position_substract(&game->entity_positions[entity_idx], &center);
 
-	// Assert that the search space is small. 32 is not an special or particular number.
-	// assert(end_tile_x - start_tile_x < 32);
-	// assert(end_tile_y - start_tile_y < 32);
+		if (vtwo_norm_sq(delta.delta_xy_m) <= radius_sq) {
+			result.entity_idxs[count++] = entity_idx;
+		}
+	}
 
-	float remaining_time = 1.0F;
-	for (uint32_t i = 0; i < 4 && remaining_time > 0.0F; ++i) {
-		float max_time = 1.0F;
-		Vtwo wall_normal = {};
-		uint32_t hit_entity_idx = 0;
-
-		for (uint32_t entity_idx = 1; entity_idx < game->entity_count; ++entity_idx) {
-			Entity test_entity = game_get_entity(game, entity_idx);
-			game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_HIGH);
-
-			// Note(fredy): do not check for collide with itself
-			if (test_entity.high != entity.high) {
-				if (test_entity.dormant->collides) {
-					// Applying Minkowski algebra
-					float radius_h = 0.5F * (TILE_SIDE_M + HERO_HEIGHT_M);
-					float radius_w = 0.5F * (TILE_SIDE_M + HERO_WIDTH_M);
-					Vtwo min_corner = { .x = -radius_w, .y = -radius_h };
-					Vtwo max_corner = { .x = radius_w, .y = radius_h };
-
-					Vtwo rel_pos = vtwo_sub(entity.high->pos_m, test_entity.high->pos_m);
-
-					if (wall_test(min_corner.x, rel_pos.x, rel_pos.y, displacement_m.x,
-					              displacement_m.y, &max_time, min_corner.y, max_corner.y)) {
-						wall_normal = (Vtwo){ .x = -1.0F, .y = 0.0F };
-						hit_entity_idx = entity_idx;
-					}
+	result.count = count;
+
+	return result;
+}
+
+/**
+ * @brief Finds the k entities nearest to the center, up to max_distance_m away, sorted from the nearest
+ *
+ * @param game
+ * @param arena Where the result is pushed
+ * @param center
+ * @param k Most entities returned
+ * @param max_distance_m Entities further away are not considered
+ * @return SpatialQuery
+ */
+static SpatialQuery spatial_query_nearest(Game *game, Arena *arena, Position center, uint32_t k,
+                                          float max_distance_m)
+{
+	SpatialQuery result = spatial_query_radius(game, arena, center, max_distance_m);
+	float *distances_sq = ARENA_PUSH_ARRAY(arena, float, result.count);
+	uint32_t count = 0;
+
+	// Note(fredy): insertion into the sorted k nearest, k is expected to be small
+	for (uint32_t result_idx = 0; result_idx < result.count; ++result_idx) {
+		uint32_t entity_idx = result.entity_idxs[result_idx];
+		PositionDelta delta = position_substract(&game->entity_positions[entity_idx], &center);
+		float distance_sq = vtwo_norm_sq(delta.delta_xy_m);
+		uint32_t insert_idx = NUMBER_MIN(count, k);
+
+		while (insert_idx > 0 && distances_sq[insert_idx - 1] > distance_sq) {
+			if (insert_idx < k) {
+				distances_sq[insert_idx] = distances_sq[insert_idx - 1];
+				result.entity_idxs[insert_idx] = result.entity_idxs[insert_idx - 1];
+			}
+
+			--insert_idx;
+		}
+
+		if (insert_idx < k) {
+			distances_sq[insert_idx] = distance_sq;
+			result.entity_idxs[insert_idx] = entity_idx;
+			count = NUMBER_MIN(count + 1, k);
+		}
+	}
+
+	result.count = count;
+
+	return result;
+}
+
+/**
+ * @brief Finds the entities whose box is crossed by a segment, sorted from the nearest to the origin
+ *
+ * @param game
+ * @param arena Where the result is pushed
+ * @param origin Start of the segment
+ * @param direction Unit direction of the segment
+ * @param length_m Length of the segment
+ * @return SpatialQuery
+ */
+static SpatialQuery spatial_query_ray(Game *game, Arena *arena, Position origin, Vtwo direction, float length_m)
+{
+	Vtwo half_segment_m = vtwo_scale(direction, length_m * 0.5F);
+	Position center = origin;
+	center.offset_m = vtwo_add(center.offset_m, half_segment_m);
+	map_normalize_position(&center);
+
+	SpatialQuery result = spatial_gather(game, arena, center, spatial_get_radius_tl(fabsf(half_segment_m.x)),
+	                                     spatial_get_radius_tl(fabsf(half_segment_m.y)));
+	float *hit_distances_m = ARENA_PUSH_ARRAY(arena, float, result.count);
+	uint32_t count = 0;
+
+	for (uint32_t result_idx = 0; result_idx < result.count; ++result_idx) {
+		uint32_t entity_idx = result.entity_idxs[result_idx];
+		EntityShape *shape = &game->entity_shapes[entity_idx];
+		Vtwo box_center_m = position_substract(&game->entity_positions[entity_idx], &origin).delta_xy_m;
+		Vtwo box_half_dim_m = { .x = shape->width_m * 0.5F, .y = shape->height_m * 0.5F };
+		float enter_m = 0.0F;
+		float exit_m = length_m;
+
+		// Slab test, the segment is inside the box between the latest entry and the earliest exit
+		for (uint32_t axis = 0; axis < 2; ++axis) {
+			float min_m = box_center_m.e[axis] - box_half_dim_m.e[axis];
+			float max_m = box_center_m.e[axis] + box_half_dim_m.e[axis];
+
+			if (fabsf(direction.e[axis]) < FLT_EPSILON) {
+				if (min_m > 0.0F || max_m < 0.0F) {
+					exit_m = -1.0F;
+				}
+			} else {
+				float min_t = min_m / direction.e[axis];
+				float max_t = max_m / direction.e[axis];
+				enter_m = NUMBER_MAX(enter_m, NUMBER_MIN(min_t, max_t));
+				exit_m = NUMBER_MIN(exit_m, NUMBER_MAX(min_t, max_t));
+			}
+		}
+
+		if (enter_m <= exit_m) {
+			uint32_t insert_idx = count++;
+
+			while (insert_idx > 0 && hit_distances_m[insert_idx - 1] > enter_m) {
+				hit_distances_m[insert_idx] = hit_distances_m[insert_idx - 1];
+				result.entity_idxs[insert_idx] = result.entity_idxs[insert_idx - 1];
+				--insert_idx;
+			}
+
+			hit_distances_m[insert_idx] = enter_m;
+			result.entity_idxs[insert_idx] = entity_idx;
+		}
+	}
+
+	result.count = count;
+
+	return result;
+}
+
+// =============================================================================
+// Entities
+// =============================================================================
+
+/**
+ * @brief Removes an entity from a residence list, filling the hole with the last entity of the list.
+ */
+static void game_list_remove(Game *game, EntityList *list, uint32_t entity_idx)
+{
+	assert(list->count > 0);
+
+	uint32_t list_idx = game->entity_list_idxs[entity_idx];
+	uint32_t last_list_idx = --list->count;
+
+	assert(list->entity_idxs[list_idx] == entity_idx);
+
+	uint32_t last_entity_idx = list->entity_idxs[last_list_idx];
+	list->entity_idxs[list_idx] = last_entity_idx;
+	game->entity_list_idxs[last_entity_idx] = list_idx;
+}
+
+static void game_list_add(Game *game, EntityList *list, uint32_t entity_idx)
+{
+	assert(list->count < MAX_ENTITIES);
+
+	uint32_t list_idx = list->count++;
+	list->entity_idxs[list_idx] = entity_idx;
+	game->entity_list_idxs[entity_idx] = list_idx;
+}
+
+/**
+ * @brief Hash of the simulated state of an entity, the state kept to interpolate the rendering is not part of it
+ */
+static uint64_t game_hash_entity(const Game *game, uint32_t entity_idx)
+{
+	const Position *pos = &game->entity_positions[entity_idx];
+	const EntityShape *shape = &game->entity_shapes[entity_idx];
+	const LowEntity *low = &game->low_entities[entity_idx];
+	const EntityInfo *info = &game->entity_infos[entity_idx];
+
+	uint64_t result = hash_mix(CHECKSUM_SEED, entity_idx);
+	result = hash_mix(result, game->entity_residences[entity_idx]);
+	result = hash_mix(result, pos->tile_x);
+	result = hash_mix(result, pos->tile_y);
+	result = hash_mix(result, pos->tile_z);
+	result = hash_mix_float(result, pos->offset_m.x);
+	result = hash_mix_float(result, pos->offset_m.y);
+	result = hash_mix_float(result, shape->width_m);
+	result = hash_mix_float(result, shape->height_m);
+	result = hash_mix(result, (uint32_t)info->delta_tile_z);
+	result = hash_mix(result, shape->collides);
+	result = hash_mix(result, info->entity_type);
+	result = hash_mix_float(result, low->vel_mps.x);
+	result = hash_mix_float(result, low->vel_mps.y);
+	result = hash_mix_float(result, low->z_m);
+	result = hash_mix_float(result, low->z_speed_mps);
+	result = hash_mix(result, low->rest_step_count);
+	result = hash_mix(result, low->facing);
+
+	return result;
+}
+
+/**
+ * @brief Updates the checksum of the entities with the new state of one of them, it has to be called every time
+ * the state of an entity changes
+ */
+static void game_rehash_entity(Game *game, uint32_t entity_idx)
+{
+	uint64_t hash = game_hash_entity(game, entity_idx);
+
+	game->entities_checksum ^= game->entity_hashes[entity_idx] ^ hash;
+	game->entity_hashes[entity_idx] = hash;
+}
+
+/**
+ * @brief Level of the map, and of the residence lists, of a tile_z
+ */
+static inline uint32_t game_get_level(uint32_t tile_z)
+{
+	uint32_t result = tile_z % MAP_SIDE_Z_CHK;
+
+	return result;
+}
+
+/**
+ * @brief Sets the residence of an entity, and moves it to the lists of the level it is on now
+ */
+static void game_set_entity_residence(Game *game, uint32_t entity_idx, EntityResidence residence)
+{
+	EntityResidence old_residence = game->entity_residences[entity_idx];
+	uint32_t old_level = game->entity_levels[entity_idx];
+	uint32_t level = game_get_level(game->entity_positions[entity_idx].tile_z);
+
+	// Note(fredy): taking the stairs is just a move between the lists of two levels
+	if (residence != old_residence || level != old_level) {
+		game_list_remove(game, &game->residence_lists[old_level][old_residence], entity_idx);
+		game_list_add(game, &game->residence_lists[level][residence], entity_idx);
+		game->entity_levels[entity_idx] = level;
+
+		// Note(fredy): there is nothing to interpolate from until the entity is simulated
+		if (residence == ENTITY_RESIDENCE_HIGH && residence != old_residence) {
+			LowEntity *low = &game->low_entities[entity_idx];
+			low->prev_pos = game->entity_positions[entity_idx];
+			low->prev_z_m = low->z_m;
+			low->rest_step_count = 0;
+		}
+	}
+
+	game->entity_residences[entity_idx] = residence;
+	game_rehash_entity(game, entity_idx);
+}
+
+static uint32_t game_add_entity(Game *game, EntityType type)
+{
+	assert(game->entity_count < MAX_ENTITIES);
+
+	uint32_t entity_idx = game->entity_count++;
+
+	game->entity_positions[entity_idx] = (Position){};
+	game->entity_shapes[entity_idx] = (EntityShape){};
+	game->entity_infos[entity_idx] = (EntityInfo){ .entity_type = type };
+	game->low_entities[entity_idx] = (LowEntity){ .facing = FACING_DIRECTION_RIGHT };
+	game->entity_residences[entity_idx] = ENTITY_RESIDENCE_NONEXISTENT;
+	game->entity_levels[entity_idx] = 0;
+	game_list_add(game, &game->residence_lists[0][ENTITY_RESIDENCE_NONEXISTENT], entity_idx);
+	game_rehash_entity(game, entity_idx);
+
+	return entity_idx;
+}
+
+/**
+ * @brief Bounds around the camera, relative to the camera, where the entities are kept HIGH
+ */
+static AppRect game_get_camera_bounds(void)
+{
+	Vtwo bounds_span_tl = { .x = (float)CAMERA_SPAN_X_TL, .y = (float)CAMERA_SPAN_Y_TL };
+	Vtwo bounds_dim_m = vtwo_scale(bounds_span_tl, TILE_SIDE_M);
+	AppRect result = rectangle((Vtwo){ .x = 0.0F, .y = 0.0F }, bounds_dim_m);
+
+	return result;
+}
+
+/**
+ * @brief Tests if a position is on the tiles of a span centered at the camera
+ */
+static inline uint32_t game_is_in_span(Position pos, Position camera_pos, uint32_t span_x_tl, uint32_t span_y_tl)
+{
+	uint32_t min_tile_x = camera_pos.tile_x - span_x_tl / 2;
+	uint32_t min_tile_y = camera_pos.tile_y - span_y_tl / 2;
+
+	// Note(fredy): unsigned wrap-around keeps the test valid when the bounds cross the tile 0
+	uint32_t result = pos.tile_z == camera_pos.tile_z && pos.tile_x - min_tile_x <= span_x_tl / 2 * 2 &&
+	                  pos.tile_y - min_tile_y <= span_y_tl / 2 * 2;
+
+	return result;
+}
+
+/**
+ * @brief Sets the residence of an entity from where it is relative to the camera
+ */
+static void game_update_entity_residence(Game *game, uint32_t entity_idx)
+{
+	Position pos = game->entity_positions[entity_idx];
+	EntityResidence residence = ENTITY_RESIDENCE_DORMANT;
+
+	if (game_is_in_span(pos, game->camera_position, CAMERA_SPAN_X_TL, CAMERA_SPAN_Y_TL)) {
+		residence = ENTITY_RESIDENCE_HIGH;
+	} else if (game_is_in_span(pos, game->camera_position, LOW_SPAN_X_TL, LOW_SPAN_Y_TL)) {
+		residence = ENTITY_RESIDENCE_LOW;
+	}
+
+	game_set_entity_residence(game, entity_idx, residence);
+}
+
+static uint32_t game_add_player(Game *game)
+{
+	uint32_t entity_idx = game_add_entity(game, ENTITY_TYPE_HERO);
+	Position *pos = &game->entity_positions[entity_idx];
+	EntityShape *shape = &game->entity_shapes[entity_idx];
+
+	pos->tile_x = WORLD_ORIGIN_X_TL + 1;
+	pos->tile_y = WORLD_ORIGIN_Y_TL + 3;
+	pos->tile_z = 0;
+	shape->height_m = 0.5F;
+	shape->width_m = 1.0F;
+	shape->collides = 1U;
+
+	spatial_update_entity(game, entity_idx);
+	game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_HIGH);
+
+	if (game->entity_residences[game->entity_tracked_by_camera_idx] == ENTITY_RESIDENCE_NONEXISTENT) {
+		game->entity_tracked_by_camera_idx = entity_idx;
+	}
+
+	return entity_idx;
+}
+
+static uint32_t game_add_wall(Game *game, uint32_t tile_x, uint32_t tile_y, uint32_t tile_z)
+{
+	uint32_t entity_idx = game_add_entity(game, ENTITY_TYPE_WALL);
+	Position *pos = &game->entity_positions[entity_idx];
+	EntityShape *shape = &game->entity_shapes[entity_idx];
+
+	pos->tile_x = tile_x;
+	pos->tile_y = tile_y;
+	pos->tile_z = tile_z;
+
+	shape->height_m = TILE_SIDE_M;
+	shape->width_m = TILE_SIDE_M;
+	shape->collides = 1U;
+
+	spatial_update_entity(game, entity_idx);
+	game_update_entity_residence(game, entity_idx);
+
+	return entity_idx;
+}
+
+typedef enum SpanOverlap : uint8_t {
+	SPAN_OVERLAP_NONE,
+	SPAN_OVERLAP_PARTIAL,
+	SPAN_OVERLAP_FULL,
+} SpanOverlap;
+
+/**
+ * @brief How much of the tiles of a chunk are on a span centered at the camera
+ */
+static SpanOverlap game_get_chunk_overlap(uint32_t chunk_x, uint32_t chunk_y, uint32_t chunk_z, Position camera_pos,
+                                          uint32_t span_x_tl, uint32_t span_y_tl)
+{
+	SpanOverlap result = SPAN_OVERLAP_NONE;
+
+	if (chunk_z == camera_pos.tile_z) {
+		// Note(fredy): the tiles are made relative to the span, so the test is valid when it crosses the tile 0
+		int32_t min_x = (int32_t)((chunk_x << CHUNK_SHIFT_BITS) - (camera_pos.tile_x - span_x_tl / 2));
+		int32_t min_y = (int32_t)((chunk_y << CHUNK_SHIFT_BITS) - (camera_pos.tile_y - span_y_tl / 2));
+		int32_t max_x = min_x + (int32_t)CHUNK_MASK;
+		int32_t max_y = min_y + (int32_t)CHUNK_MASK;
+		int32_t last_x = (int32_t)(span_x_tl / 2 * 2);
+		int32_t last_y = (int32_t)(span_y_tl / 2 * 2);
+
+		if (max_x >= 0 && min_x <= last_x && max_y >= 0 && min_y <= last_y) {
+			result = min_x >= 0 && max_x <= last_x && min_y >= 0 && max_y <= last_y ? SPAN_OVERLAP_FULL
+			                                                                      : SPAN_OVERLAP_PARTIAL;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Residence of all the entities over a chunk for a camera, ENTITY_RESIDENCE_COUNT if it depends on the
+ * tile they are on
+ */
+static EntityResidence game_get_chunk_residence(uint32_t chunk_x, uint32_t chunk_y, uint32_t chunk_z,
+                                                Position camera_pos)
+{
+	EntityResidence result = ENTITY_RESIDENCE_COUNT;
+	SpanOverlap high_overlap =
+		game_get_chunk_overlap(chunk_x, chunk_y, chunk_z, camera_pos, CAMERA_SPAN_X_TL, CAMERA_SPAN_Y_TL);
+	SpanOverlap low_overlap =
+		game_get_chunk_overlap(chunk_x, chunk_y, chunk_z, camera_pos, LOW_SPAN_X_TL, LOW_SPAN_Y_TL);
+
+	if (high_overlap == SPAN_OVERLAP_FULL) {
+		result = ENTITY_RESIDENCE_HIGH;
+	} else if (high_overlap == SPAN_OVERLAP_NONE && low_overlap == SPAN_OVERLAP_FULL) {
+		result = ENTITY_RESIDENCE_LOW;
+	} else if (low_overlap == SPAN_OVERLAP_NONE) {
+		result = ENTITY_RESIDENCE_DORMANT;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Moves the camera and updates the residences of the entities on the chunks that enter or leave the spans
+ * around it. The entities that move update their own residence.
+ */
+static void game_set_camera(Game *game, Position new_camera_pos)
+{
+	Position old_camera_pos = game->camera_position;
+	game->camera_position = new_camera_pos;
+
+	if (!MAP_ARE_SAME_TILE(old_camera_pos, new_camera_pos)) {
+		Position camera_positions[] = { old_camera_pos, new_camera_pos };
+		uint32_t chunk_mask = UINT32_MAX >> CHUNK_SHIFT_BITS;
+		uint32_t chunk_count_x = NUMBER_MIN(((LOW_SPAN_X_TL / 2 * 2) >> CHUNK_SHIFT_BITS) + 2, MAP_SIDE_X_CHK);
+		uint32_t chunk_count_y = NUMBER_MIN(((LOW_SPAN_Y_TL / 2 * 2) >> CHUNK_SHIFT_BITS) + 2, MAP_SIDE_Y_CHK);
+		uint32_t old_min_chunk_x = (old_camera_pos.tile_x - LOW_SPAN_X_TL / 2) >> CHUNK_SHIFT_BITS;
+		uint32_t old_min_chunk_y = (old_camera_pos.tile_y - LOW_SPAN_Y_TL / 2) >> CHUNK_SHIFT_BITS;
+
+		// Note(fredy): the chunks around the old camera first, then the ones around the new camera that were
+		// not visited yet
+		for (uint32_t camera_idx = 0; camera_idx < 2; ++camera_idx) {
+			Position camera_pos = camera_positions[camera_idx];
+			uint32_t chunk_z = camera_pos.tile_z;
+			uint32_t min_chunk_x = (camera_pos.tile_x - LOW_SPAN_X_TL / 2) >> CHUNK_SHIFT_BITS;
+			uint32_t min_chunk_y = (camera_pos.tile_y - LOW_SPAN_Y_TL / 2) >> CHUNK_SHIFT_BITS;
+
+			for (uint32_t offset_y = 0; offset_y < chunk_count_y; ++offset_y) {
+				for (uint32_t offset_x = 0; offset_x < chunk_count_x; ++offset_x) {
+					uint32_t chunk_x = min_chunk_x + offset_x;
+					uint32_t chunk_y = min_chunk_y + offset_y;
+					uint32_t old_offset_x = (chunk_x - old_min_chunk_x) & chunk_mask;
+					uint32_t old_offset_y = (chunk_y - old_min_chunk_y) & chunk_mask;
+					uint32_t was_visited = camera_idx == 1 && chunk_z == old_camera_pos.tile_z &&
+					                       old_offset_x < chunk_count_x &&
+					                       old_offset_y < chunk_count_y;
+					EntityResidence old_residence =
+						game_get_chunk_residence(chunk_x, chunk_y, chunk_z, old_camera_pos);
+					EntityResidence new_residence =
+						game_get_chunk_residence(chunk_x, chunk_y, chunk_z, new_camera_pos);
+
+					uint32_t is_changed = old_residence != new_residence ||
+					                      new_residence == ENTITY_RESIDENCE_COUNT;
+
+					if (!was_visited && is_changed) {
+						TileChunk *chunk =
+							map_get_chunk(game->world->map, chunk_x, chunk_y, chunk_z);
+
+						for (uint32_t entity_idx = chunk->first_entity_idx; entity_idx;
+						     entity_idx = game->entity_next_idxs[entity_idx]) {
+							game_update_entity_residence(game, entity_idx);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Adds a job to the work queue of the platform, or runs it right away if there is no queue
+ */
+static void game_add_job(Storage *storage, ThreadContext *thread, work_queue_callback_func *callback, void *data)
+{
+	if (storage->work_queue) {
+		storage->plat_work_queue_add_entry(storage->work_queue, thread, callback, data);
+	} else {
+		callback(thread, data);
+	}
+}
+
+static void game_complete_jobs(Storage *storage, ThreadContext *thread)
+{
+	if (storage->work_queue) {
+		storage->plat_work_queue_complete_all(storage->work_queue, thread);
+	}
+}
+
+// =============================================================================
+// Sim Region
+// =============================================================================
+
+#define SIM_LANES 8
+
+// Collision iterations of a move
+#define SIM_MAX_MOVE_ITERATIONS 4
+
+// Vertical strips of a region whose movers are computed in parallel
+#define SIM_PARTITION_COUNT 4U
+
+// Entities whose z axis is integrated by a single job
+#define SIM_Z_BATCH_SIZE (SIM_LANES * 8)
+
+/**
+ * @brief Entities gathered from the canonical storage for one frame of simulation.
+ *
+ * Lives in transient memory. Positions are floats relative to the origin of the region, so the precision
+ * does not depend on how far the region is from the origin of the map. The entities are stored as structure
+ * of arrays so the kinematics can be run over SIM_LANES entities at a time. Every array has room for a
+ * multiple of SIM_LANES entities.
+ *
+ * Regions must not overlap: an entity gathered by two regions is written back twice.
+ */
+typedef struct SimRegion {
+	Position origin;
+
+	/**
+	 * @brief Bounds relative to the origin
+	 */
+	AppRect bounds_m;
+
+	uint32_t entity_count;
+	uint32_t max_entity_count;
+
+	/**
+	 * @brief The awake entities go first, the sleeping ones after them. The sleeping entities are obstacles
+	 * but they are not integrated nor moved.
+	 */
+	uint32_t awake_count;
+
+	/**
+	 * @brief Index of the entity in the canonical storage
+	 */
+	uint32_t *entity_idxs;
+
+	/**
+	 * @brief Position in meters, relative to the origin
+	 */
+	float *pos_x_m;
+	float *pos_y_m;
+
+	/**
+	 * @brief Velocity in meters per second
+	 */
+	float *vel_x_mps;
+	float *vel_y_mps;
+
+	float *z_m;
+	float *z_speed_mps;
+
+	uint32_t *tile_z;
+
+	/**
+	 * @brief Half extents in meters
+	 */
+	float *half_width_m;
+	float *half_height_m;
+
+	/**
+	 * @brief UINT32_MAX for the entities that collide, 0 for the rest and for the padding
+	 */
+	uint32_t *collides_mask;
+
+	uint32_t *rest_step_counts;
+
+	FacingDirection *facing;
+} SimRegion;
+
+/**
+ * @brief Move requested for an entity of the region, and its result
+ */
+typedef struct SimMove {
+	Vtwo acceleration_mpssq;
+	Vtwo start_pos_m;
+
+	Vtwo pos_m;
+	Vtwo vel_mps;
+	uint32_t tile_z;
+
+	uint32_t sim_idx;
+	uint32_t partition_idx;
+
+	/**
+	 * @brief Obstacles hit during the move, they are woken up
+	 */
+	uint32_t hit_count;
+	uint32_t hit_sim_idxs[SIM_MAX_MOVE_ITERATIONS];
+
+	FacingDirection facing;
+} SimMove;
+
+/**
+ * @brief Computes the moves of the entities in one partition of the region
+ */
+typedef struct SimMoveJob {
+	const Game *game;
+	const SimRegion *region;
+	SimMove *moves;
+	uint32_t move_count;
+	uint32_t partition_idx;
+	float time_delta_s;
+} SimMoveJob;
+
+typedef struct SimIntegrateZJob {
+	SimRegion *region;
+	uint32_t first_sim_idx;
+	uint32_t end_sim_idx;
+	float time_delta_s;
+} SimIntegrateZJob;
+
+static inline Vtwo sim_get_pos(const SimRegion *region, uint32_t sim_idx)
+{
+	Vtwo result = {
+		.x = region->pos_x_m[sim_idx],
+		.y = region->pos_y_m[sim_idx],
+	};
+
+	return result;
+}
+
+static inline void sim_set_pos(SimRegion *region, uint32_t sim_idx, Vtwo pos_m)
+{
+	region->pos_x_m[sim_idx] = pos_m.x;
+	region->pos_y_m[sim_idx] = pos_m.y;
+}
+
+static inline Vtwo sim_get_vel(const SimRegion *region, uint32_t sim_idx)
+{
+	Vtwo result = {
+		.x = region->vel_x_mps[sim_idx],
+		.y = region->vel_y_mps[sim_idx],
+	};
+
+	return result;
+}
+
+static inline void sim_set_vel(SimRegion *region, uint32_t sim_idx, Vtwo vel_mps)
+{
+	region->vel_x_mps[sim_idx] = vel_mps.x;
+	region->vel_y_mps[sim_idx] = vel_mps.y;
+}
+
+/**
+ * @brief Whether an entity stayed at rest long enough to be skipped by the simulation
+ */
+static inline uint32_t sim_is_sleeping(uint32_t rest_step_count)
+{
+	uint32_t result = rest_step_count >= SIM_SLEEP_STEPS;
+
+	return result;
+}
+
+/**
+ * @brief Finds an entity inside the region
+ *
+ * @return The index of the entity in the region, UINT32_MAX if the entity is not in the region
+ */
+static uint32_t sim_region_find(const SimRegion *region, uint32_t entity_idx)
+{
+	uint32_t result = UINT32_MAX;
+
+	for (uint32_t sim_idx = 0; sim_idx < region->entity_count; ++sim_idx) {
+		if (region->entity_idxs[sim_idx] == entity_idx) {
+			result = sim_idx;
+			break;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Gathers the HIGH entities inside @p bounds_m into a new region allocated on @p arena
+ *
+ * @param game
+ * @param arena Transient memory, the region is valid until the arena is reset
+ * @param origin Position the region is relative to
+ * @param bounds_m Bounds of the region, relative to the origin
+ * @return SimRegion*
+ */
+static SimRegion *sim_region_begin(Game *game, Arena *arena, Position origin, AppRect bounds_m)
+{
+	// Note(fredy): only the level of the origin is simulated
+	EntityList *high_list = &game->residence_lists[game_get_level(origin.tile_z)][ENTITY_RESIDENCE_HIGH];
+	uint32_t max_entity_count = (high_list->count + SIM_LANES - 1) / SIM_LANES * SIM_LANES;
+
+	SimRegion *region = ARENA_PUSH_STRUCT(arena, SimRegion);
+	region->origin = origin;
+	region->bounds_m = bounds_m;
+	region->entity_count = 0;
+	region->max_entity_count = max_entity_count;
+	// Note(fredy): the streams start on a cache line, so the z batches of the jobs never write the same line
+	region->pos_x_m = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->pos_y_m = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->vel_x_mps = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->vel_y_mps = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->z_m = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->z_speed_mps = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->entity_idxs = ARENA_PUSH_ARRAY_CACHE_LINE(arena, uint32_t, max_entity_count);
+	region->tile_z = ARENA_PUSH_ARRAY_CACHE_LINE(arena, uint32_t, max_entity_count);
+	region->half_width_m = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->half_height_m = ARENA_PUSH_ARRAY_CACHE_LINE(arena, float, max_entity_count);
+	region->collides_mask = ARENA_PUSH_ARRAY_CACHE_LINE(arena, uint32_t, max_entity_count);
+	region->rest_step_counts = ARENA_PUSH_ARRAY_CACHE_LINE(arena, uint32_t, max_entity_count);
+	region->facing = ARENA_PUSH_ARRAY_CACHE_LINE(arena, FacingDirection, max_entity_count);
+
+	// Note(fredy): the first pass gathers the awake entities, the second one the sleeping ones
+	for (uint32_t is_sleeping_pass = 0; is_sleeping_pass < 2; ++is_sleeping_pass) {
+		for (uint32_t high_idx = 0; high_idx < high_list->count; ++high_idx) {
+			uint32_t entity_idx = high_list->entity_idxs[high_idx];
+			LowEntity *low = &game->low_entities[entity_idx];
+			Position *pos = &game->entity_positions[entity_idx];
+			PositionDelta delta = position_substract(pos, &origin);
+
+			if (sim_is_sleeping(low->rest_step_count) == is_sleeping_pass &&
+			    rectangle_contains(bounds_m, delta.delta_xy_m)) {
+				uint32_t sim_idx = region->entity_count++;
+				EntityShape *shape = &game->entity_shapes[entity_idx];
+
+				region->entity_idxs[sim_idx] = entity_idx;
+				sim_set_pos(region, sim_idx, delta.delta_xy_m);
+				sim_set_vel(region, sim_idx, low->vel_mps);
+				region->z_m[sim_idx] = low->z_m;
+				region->z_speed_mps[sim_idx] = low->z_speed_mps;
+				region->tile_z[sim_idx] = pos->tile_z;
+				region->half_width_m[sim_idx] = 0.5F * shape->width_m;
+				region->half_height_m[sim_idx] = 0.5F * shape->height_m;
+				region->collides_mask[sim_idx] = shape->collides ? UINT32_MAX : 0U;
+				region->rest_step_counts[sim_idx] = low->rest_step_count;
+				region->facing[sim_idx] = low->facing;
+			}
+		}
+
+		if (!is_sleeping_pass) {
+			region->awake_count = region->entity_count;
+		}
+	}
+
+	// Note(fredy): the lanes past the entity count are simulated too, keep them finite
+	for (uint32_t sim_idx = region->entity_count; sim_idx < max_entity_count; ++sim_idx) {
+		region->entity_idxs[sim_idx] = 0;
+		sim_set_pos(region, sim_idx, (Vtwo){});
+		sim_set_vel(region, sim_idx, (Vtwo){});
+		region->z_m[sim_idx] = 0.0F;
+		region->z_speed_mps[sim_idx] = 0.0F;
+		region->tile_z[sim_idx] = origin.tile_z;
+		region->half_width_m[sim_idx] = 0.0F;
+		region->half_height_m[sim_idx] = 0.0F;
+		region->collides_mask[sim_idx] = 0U;
+		region->rest_step_counts[sim_idx] = 0;
+		region->facing[sim_idx] = FACING_DIRECTION_RIGHT;
+	}
+
+	return region;
+}
+
+/**
+ * @brief Writes the simulated entities back into the canonical storage, and counts the steps the awake
+ * entities have been at rest. The sleeping entities were not simulated, only their rest counter (reset when
+ * they are woken up) is written back.
+ * The region can still be read (e.g. for rendering) until its arena is reset.
+ */
+static void sim_region_end(Game *game, SimRegion *region)
+{
+	for (uint32_t sim_idx = region->awake_count; sim_idx < region->entity_count; ++sim_idx) {
+		uint32_t entity_idx = region->entity_idxs[sim_idx];
+		LowEntity *low = &game->low_entities[entity_idx];
+
+		if (low->rest_step_count != region->rest_step_counts[sim_idx]) {
+			low->rest_step_count = region->rest_step_counts[sim_idx];
+			game_rehash_entity(game, entity_idx);
+		}
+	}
+
+	float rest_speed_sq = float_square(SIM_REST_SPEED_MPS);
+
+	for (uint32_t sim_idx = 0; sim_idx < region->awake_count; ++sim_idx) {
+		uint32_t entity_idx = region->entity_idxs[sim_idx];
+		Position *pos = &game->entity_positions[entity_idx];
+		LowEntity *low = &game->low_entities[entity_idx];
+
+		low->prev_pos = *pos;
+		low->prev_z_m = low->z_m;
+
+		*pos = region->origin;
+		pos->offset_m = vtwo_add(pos->offset_m, sim_get_pos(region, sim_idx));
+		pos->tile_z = region->tile_z[sim_idx];
+		map_normalize_position(pos);
+		spatial_update_entity(game, entity_idx);
+
+		low->vel_mps = sim_get_vel(region, sim_idx);
+		low->z_m = region->z_m[sim_idx];
+		low->z_speed_mps = region->z_speed_mps[sim_idx];
+		low->facing = region->facing[sim_idx];
+
+		uint32_t is_at_rest = vtwo_norm_sq(low->vel_mps) < rest_speed_sq &&
+		                      fabsf(low->z_speed_mps) < SIM_REST_SPEED_MPS && low->z_m <= 0.0F;
+		low->rest_step_count = is_at_rest ? region->rest_step_counts[sim_idx] + 1 : 0;
+
+		// Note(fredy): a sleeping entity is still, it has nothing to interpolate
+		if (sim_is_sleeping(low->rest_step_count)) {
+			low->vel_mps = (Vtwo){};
+			low->z_speed_mps = 0.0F;
+			low->prev_pos = *pos;
+			low->prev_z_m = low->z_m;
+		}
+
+		game_rehash_entity(game, entity_idx);
+	}
+}
+
+/**
+ * @brief Computes the move of an entity against the entities of the region, without modifying the region.
+ * Many moves can be computed at the same time.
+ */
+static void sim_move_entity(const Game *game, const SimRegion *region, SimMove *move, float time_delta_s)
+{
+	uint32_t sim_idx = move->sim_idx;
+	Vtwo acceleration_mpssq = move->acceleration_mpssq;
+	Vtwo pos_m = sim_get_pos(region, sim_idx);
+	Vtwo vel_mps = sim_get_vel(region, sim_idx);
+	uint32_t tile_z = region->tile_z[sim_idx];
+	FacingDirection facing = region->facing[sim_idx];
+
+	float norm_sq = vtwo_norm_sq(acceleration_mpssq);
+	if (norm_sq > 1.0F) {
+		acceleration_mpssq = vtwo_scale(acceleration_mpssq, 1.0F / sqrtf(norm_sq));
+	}
+
+	// Apply the drag
+	float speed_mps = 50.0F;
+	acceleration_mpssq = vtwo_scale(acceleration_mpssq, speed_mps);
+	acceleration_mpssq = vtwo_sub(acceleration_mpssq, vtwo_scale(vel_mps, 8.0F));
+
+	float time_delta_s_sq = float_square(time_delta_s);
+
+	// Kinematic equation: 1/2*a*t^2
+	Vtwo acceleration_displacement_m = vtwo_scale(acceleration_mpssq, 0.5F * time_delta_s_sq);
+
+	// Kinematic equation: v*t
+	Vtwo velocity_displacement_m = vtwo_scale(vel_mps, time_delta_s);
+
+	// Kinematic equation: p' = 1/2*a'*t^2 + v'*t + p
+	Vtwo displacement_m = vtwo_add(acceleration_displacement_m, velocity_displacement_m);
+
+	// Kinematic equation: v' = a*t + v
+	vel_mps = vtwo_add(vtwo_scale(acceleration_mpssq, time_delta_s), vel_mps);
+
+	// uint32_t start_tile_x = NUMBER_MIN(old_hero_position.tile_x, new_hero_position.tile_x);
+	// uint32_t end_tile_x = NUMBER_MAX(old_hero_position.tile_x, new_hero_position.tile_x);
+	// uint32_t start_tile_y = NUMBER_MIN(old_hero_position.tile_y, new_hero_position.tile_y);
+	// uint32_t end_tile_y = NUMBER_MAX(old_hero_position.tile_y, new_hero_position.tile_y);
+
+	// Adjust the search space to take into acount the hero dimensions
+	// start_tile_x -= HERO_WIDTH_TL;
+	// start_tile_y -= HERO_HEIGHT_TL;
+	// end_tile_x += HERO_WIDTH_TL;
+	// end_tile_y += HERO_HEIGHT_TL;
+
+	// uint32_t tile_z = new_hero_position.tile_z;
+
+	// Assert that the search space is small. 32 is not an special or particular number.
+	// assert(end_tile_x - start_tile_x < 32);
+	// assert(end_tile_y - start_tile_y < 32);
+
+	Vtwo half_dim_m = { .x = region->half_width_m[sim_idx], .y = region->half_height_m[sim_idx] };
+
+	move->hit_count = 0;
+
+	float remaining_time = 1.0F;
+	for (uint32_t i = 0; i < SIM_MAX_MOVE_ITERATIONS && remaining_time > 0.0F; ++i) {
+		SweepHit hit = collision_sweep(region->pos_x_m, region->pos_y_m, region->half_width_m,
+		                               region->half_height_m, region->collides_mask, region->max_entity_count,
+		                               sim_idx, pos_m, half_dim_m, displacement_m);
+		float max_time = hit.time;
+		Vtwo wall_normal = hit.normal;
+
+		pos_m = vtwo_add(pos_m, vtwo_scale(displacement_m, max_time));
+
+		if (hit.obstacle_idx != UINT32_MAX) {
+			float speed_on_r_axis = vtwo_dot(vel_mps, wall_normal);
+			Vtwo velocity_towards_r_axis = vtwo_scale(wall_normal, speed_on_r_axis);
+			vel_mps = vtwo_sub(vel_mps, velocity_towards_r_axis);
+
+			float displacement_on_r_axis = vtwo_dot(displacement_m, wall_normal);
+			Vtwo displacement_towards_r_axis = vtwo_scale(wall_normal, displacement_on_r_axis);
+			displacement_m = vtwo_sub(displacement_m, displacement_towards_r_axis);
+
+			remaining_time -= max_time * remaining_time;
+
+			move->hit_sim_idxs[move->hit_count++] = hit.obstacle_idx;
+
+			const EntityInfo *hit_info = &game->entity_infos[region->entity_idxs[hit.obstacle_idx]];
+			tile_z = (uint32_t)((int32_t)tile_z - hit_info->delta_tile_z);
+		} else {
+			break;
+		}
+	}
+
+	if (vel_mps.x == 0.0F && vel_mps.y == 0.0F) {
+		// Do not set
+	} else if (fabsf(vel_mps.x) > fabsf(vel_mps.y)) {
+		if (vel_mps.x > 0.0F) {
+			facing = FACING_DIRECTION_RIGHT;
+		} else {
+			facing = FACING_DIRECTION_LEFT;
+		}
+	} else {
+		if (vel_mps.y > 0.0F) {
+			facing = FACING_DIRECTION_UP;
+		} else {
+			facing = FACING_DIRECTION_DOWN;
+		}
+	}
+
+	move->pos_m = pos_m;
+	move->vel_mps = vel_mps;
+	move->tile_z = tile_z;
+	move->facing = facing;
+}
+
+static void sim_apply_move(SimRegion *region, const SimMove *move)
+{
+	sim_set_pos(region, move->sim_idx, move->pos_m);
+	sim_set_vel(region, move->sim_idx, move->vel_mps);
+	region->tile_z[move->sim_idx] = move->tile_z;
+	region->facing[move->sim_idx] = move->facing;
+
+	// Note(fredy): a sleeping obstacle starts to be simulated on the next step
+	for (uint32_t hit_idx = 0; hit_idx < move->hit_count; ++hit_idx) {
+		region->rest_step_counts[move->hit_sim_idxs[hit_idx]] = 0;
+	}
+}
+
+/**
+ * @brief Partition of the region an entity belongs to. The region is split in vertical strips.
+ */
+static uint32_t sim_get_partition(const SimRegion *region, uint32_t sim_idx)
+{
+	float region_width_m = region->bounds_m.max.x - region->bounds_m.min.x;
+	float strip_f = (region->pos_x_m[sim_idx] - region->bounds_m.min.x) / region_width_m * SIM_PARTITION_COUNT;
+	strip_f = NUMBER_MAX(strip_f, 0.0F);
+
+	uint32_t result = NUMBER_MIN((uint32_t)strip_f, SIM_PARTITION_COUNT - 1);
+
+	return result;
+}
+
+/**
+ * @brief Checks if the computation of @p move could have hit @p applied_move, either at its old position or
+ * at its new one.
+ */
+static uint32_t sim_move_may_touch(const SimRegion *region, const SimMove *move, const SimMove *applied_move)
+{
+	uint32_t result = 0U;
+
+	if (region->collides_mask[move->sim_idx] && region->collides_mask[applied_move->sim_idx]) {
+		// Note(fredy): same Minkowski sum that sim_move_entity uses
+		float radius_w = region->half_width_m[move->sim_idx] + region->half_width_m[applied_move->sim_idx];
+		float radius_h = region->half_height_m[move->sim_idx] + region->half_height_m[applied_move->sim_idx];
+
+		AppRect swept_m = {
+			.min = { .x = NUMBER_MIN(move->start_pos_m.x, move->pos_m.x) - radius_w,
+			         .y = NUMBER_MIN(move->start_pos_m.y, move->pos_m.y) - radius_h },
+			.max = { .x = NUMBER_MAX(move->start_pos_m.x, move->pos_m.x) + radius_w,
+			         .y = NUMBER_MAX(move->start_pos_m.y, move->pos_m.y) + radius_h },
+		};
+
+		result = rectangle_contains(swept_m, applied_move->start_pos_m) ||
+		         rectangle_contains(swept_m, applied_move->pos_m);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Applies the moves in order. Every move was computed against the region as it was before any move.
+ * A move that could have touched a mover applied before it is computed again against the updated region, so the
+ * result is the same as moving the entities one after the other, no matter how the moves were scheduled.
+ */
+static void sim_merge_moves(const Game *game, SimRegion *region, SimMove *moves, uint32_t move_count,
+                            float time_delta_s)
+{
+	for (uint32_t move_idx = 0; move_idx < move_count; ++move_idx) {
+		SimMove *move = &moves[move_idx];
+
+		uint32_t is_stale = 0U;
+		for (uint32_t applied_idx = 0; applied_idx < move_idx && !is_stale; ++applied_idx) {
+			is_stale = sim_move_may_touch(region, move, &moves[applied_idx]);
+		}
+
+		if (is_stale) {
+			sim_move_entity(game, region, move, time_delta_s);
+		}
+
+		sim_apply_move(region, move);
+	}
+}
+
+static WORK_QUEUE_CALLBACK(sim_move_partition)
+{
+	SimMoveJob *job = data;
+
+	for (uint32_t move_idx = 0; move_idx < job->move_count; ++move_idx) {
+		SimMove *move = &job->moves[move_idx];
+
+		if (move->partition_idx == job->partition_idx) {
+			sim_move_entity(job->game, job->region, move, job->time_delta_s);
+		}
+	}
+}
+
+/**
+ * @brief Integrates the z axis of the entities in [first_sim_idx, end_sim_idx), SIM_LANES entities at a time.
+ *
+ * Entities are clamped to the ground (z = 0), and a grounded entity stops falling.
+ *
+ * @param region
+ * @param first_sim_idx Multiple of SIM_LANES
+ * @param end_sim_idx
+ * @param time_delta_s Simulation step in seconds
+ */
+static void sim_integrate_z(SimRegion *region, uint32_t first_sim_idx, uint32_t end_sim_idx, float time_delta_s)
+{
+	assert(first_sim_idx % SIM_LANES == 0);
+
+	float z_acceleration_mpssq = -9.8F;
+
+#if LIB_SIMD_AVX2
+	// Kinematic equation: 1/2*a*t^2
+	__m256 z_acceleration_displacement_m = _mm256_set1_ps(0.5F * z_acceleration_mpssq * float_square(time_delta_s));
+	__m256 z_acceleration_speed_mps = _mm256_set1_ps(z_acceleration_mpssq * time_delta_s);
+	__m256 time_delta = _mm256_set1_ps(time_delta_s);
+	__m256 zero = _mm256_setzero_ps();
+
+	for (uint32_t sim_idx = first_sim_idx; sim_idx < end_sim_idx; sim_idx += SIM_LANES) {
+		__m256 z_m = _mm256_loadu_ps(region->z_m + sim_idx);
+		__m256 z_speed_mps = _mm256_loadu_ps(region->z_speed_mps + sim_idx);
+
+		// Kinematic equation: p' = 1/2*a'*t^2 + v'*t + p
+		__m256 z_velocity_displacement_m = _mm256_mul_ps(z_speed_mps, time_delta);
+		z_m = _mm256_add_ps(_mm256_add_ps(z_acceleration_displacement_m, z_velocity_displacement_m), z_m);
+
+		// Kinematic equation: v' = a*t + v
+		z_speed_mps = _mm256_add_ps(z_acceleration_speed_mps, z_speed_mps);
+
+		__m256 is_grounded = _mm256_cmp_ps(z_m, zero, _CMP_LE_OQ);
+		__m256 is_falling = _mm256_cmp_ps(z_speed_mps, zero, _CMP_LT_OQ);
+		z_m = _mm256_max_ps(z_m, zero);
+		z_speed_mps = _mm256_blendv_ps(z_speed_mps, zero, _mm256_and_ps(is_grounded, is_falling));
+
+		_mm256_storeu_ps(region->z_m + sim_idx, z_m);
+		_mm256_storeu_ps(region->z_speed_mps + sim_idx, z_speed_mps);
+	}
+#else
+	// Kinematic equation: 1/2*a*t^2
+	float z_acceleration_displacement_m = 0.5F * z_acceleration_mpssq * float_square(time_delta_s);
+	float z_acceleration_speed_mps = z_acceleration_mpssq * time_delta_s;
+
+	for (uint32_t sim_idx = first_sim_idx; sim_idx < end_sim_idx; ++sim_idx) {
+		// Kinematic equation: p' = 1/2*a'*t^2 + v'*t + p
+		float z_velocity_displacement_m = region->z_speed_mps[sim_idx] * time_delta_s;
+		float z_m = z_acceleration_displacement_m + z_velocity_displacement_m + region->z_m[sim_idx];
+
+		// Kinematic equation: v' = a*t + v
+		float z_speed_mps = z_acceleration_speed_mps + region->z_speed_mps[sim_idx];
+
+		if (z_m <= 0.0F && z_speed_mps < 0.0F) {
+			z_speed_mps = 0.0F;
+		}
+
+		region->z_m[sim_idx] = NUMBER_MAX(z_m, 0.0F);
+		region->z_speed_mps[sim_idx] = z_speed_mps;
+	}
+#endif
+}
+
+static WORK_QUEUE_CALLBACK(sim_integrate_z_batch)
+{
+	SimIntegrateZJob *job = data;
+
+	sim_integrate_z(job->region, job->first_sim_idx, job->end_sim_idx, job->time_delta_s);
+}
+
+// =============================================================================
+// Low Entities
+// =============================================================================
+
+/**
+ * @brief Cheap update of a LOW entity, it moves with its velocity and only the tiles of the map stop it
+ *
+ * @param game
+ * @param entity_idx
+ * @param time_delta_s Time since the last tick of the entity
+ */
+static void low_tick_entity(Game *game, uint32_t entity_idx, float time_delta_s)
+{
+	LowEntity *low = &game->low_entities[entity_idx];
+	Position *pos = &game->entity_positions[entity_idx];
+
+	if (!sim_is_sleeping(low->rest_step_count)) {
+		Position new_pos = *pos;
+		new_pos.offset_m = vtwo_add(new_pos.offset_m, vtwo_scale(low->vel_mps, time_delta_s));
+		map_normalize_position(&new_pos);
+
+		// Note(fredy): the other entities are ignored, a wall tile stops the entity where it is
+		if (map_is_tile_walkable(game->world->map, new_pos.tile_x, new_pos.tile_y, new_pos.tile_z)) {
+			*pos = new_pos;
+			spatial_update_entity(game, entity_idx);
+			low->vel_mps = vtwo_scale(low->vel_mps, NUMBER_MAX(1.0F - 8.0F * time_delta_s, 0.0F));
+		} else {
+			low->vel_mps = (Vtwo){};
+		}
+
+		// Note(fredy): a LOW entity lands right away, there is no one to see the jump
+		low->z_m = 0.0F;
+		low->z_speed_mps = 0.0F;
+
+		if (vtwo_norm_sq(low->vel_mps) < float_square(SIM_REST_SPEED_MPS)) {
+			low->vel_mps = (Vtwo){};
+			low->rest_step_count = SIM_SLEEP_STEPS;
+		}
+
+		game_rehash_entity(game, entity_idx);
+	}
+}
+
+/**
+ * @brief Ticks the next 1/LOW_TICK_DIVISOR of the LOW entities, so the whole list is ticked every
+ * LOW_TICK_DIVISOR steps
+ */
+static void low_tick_entities(Game *game, float time_delta_s)
+{
+	uint32_t camera_level = game_get_level(game->camera_position.tile_z);
+	EntityList *low_list = &game->residence_lists[camera_level][ENTITY_RESIDENCE_LOW];
+	uint32_t tick_count = (low_list->count + LOW_TICK_DIVISOR - 1) / LOW_TICK_DIVISOR;
+	float tick_time_delta_s = time_delta_s * (float)LOW_TICK_DIVISOR;
+
+	for (uint32_t tick_idx = 0; tick_idx < tick_count && low_list->count > 0; ++tick_idx) {
+		// Note(fredy): the list changes with the camera, so the cursor is wrapped on every use
+		if (game->low_tick_cursor >= low_list->count) {
+			game->low_tick_cursor = 0;
+		}
+
+		uint32_t entity_idx = low_list->entity_idxs[game->low_tick_cursor];
+		low_tick_entity(game, entity_idx, tick_time_delta_s);
+		game_update_entity_residence(game, entity_idx);
+
+		// Note(fredy): an entity that left the list was replaced by another one that was not ticked yet
+		if (game->entity_residences[entity_idx] == ENTITY_RESIDENCE_LOW) {
+			++game->low_tick_cursor;
+		}
+	}
+}
+
+// =============================================================================
+// Flow Field
+// =============================================================================
+
+static const int32_t flow_direction_dx[FLOW_DIRECTION_COUNT] = { 0, 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int32_t flow_direction_dy[FLOW_DIRECTION_COUNT] = { 0, 0, 1, 1, 1, 0, -1, -1, -1 };
+
+/**
+ * @brief Scratch of an update of a flow field
+ */
+typedef struct FlowUpdate {
+	/**
+	 * @brief Ring of the tiles whose cost has to be spread to their neighbors
+	 */
+	uint32_t *queue;
+	uint32_t queue_first;
+	uint32_t queue_count;
+
+	/**
+	 * @brief Tiles whose cost changed, they and their neighbors get their directions again
+	 */
+	uint32_t *changed_idxs;
+	uint32_t changed_count;
+
+	uint8_t *is_queued;
+	uint8_t *is_changed;
+} FlowUpdate;
+
+static FlowUpdate flow_update_begin(Arena *arena)
+{
+	FlowUpdate result = {};
+
+	result.queue = ARENA_PUSH_ARRAY(arena, uint32_t, FLOW_FIELD_SIZE_TL);
+	result.changed_idxs = ARENA_PUSH_ARRAY(arena, uint32_t, FLOW_FIELD_SIZE_TL);
+	result.is_queued = ARENA_PUSH_ARRAY_ZERO(arena, uint8_t, FLOW_FIELD_SIZE_TL);
+	result.is_changed = ARENA_PUSH_ARRAY_ZERO(arena, uint8_t, FLOW_FIELD_SIZE_TL);
+
+	return result;
+}
+
+static inline void flow_push(FlowUpdate *update, uint32_t tile_idx)
+{
+	if (!update->is_queued[tile_idx]) {
+		update->is_queued[tile_idx] = 1U;
+		update->queue[(update->queue_first + update->queue_count) % FLOW_FIELD_SIZE_TL] = tile_idx;
+		++update->queue_count;
+	}
+}
+
+static inline uint32_t flow_pop(FlowUpdate *update)
+{
+	uint32_t result = update->queue[update->queue_first];
+
+	update->queue_first = (update->queue_first + 1) % FLOW_FIELD_SIZE_TL;
+	--update->queue_count;
+	update->is_queued[result] = 0U;
+
+	return result;
+}
+
+static inline void flow_mark_changed(FlowUpdate *update, uint32_t tile_idx)
+{
+	if (!update->is_changed[tile_idx]) {
+		update->is_changed[tile_idx] = 1U;
+		update->changed_idxs[update->changed_count++] = tile_idx;
+	}
+}
+
+static inline uint32_t flow_get_tile_idx(const FlowField *field, uint32_t tile_x, uint32_t tile_y, uint32_t tile_z)
+{
+	uint32_t result = FLOW_TILE_NONE;
+	uint32_t field_x = tile_x - field->min_tile_x;
+	uint32_t field_y = tile_y - field->min_tile_y;
+
+	if (field->is_valid && tile_z == field->tile_z && field_x < FLOW_FIELD_SIDE_X_TL &&
+	    field_y < FLOW_FIELD_SIDE_Y_TL) {
+		result = field_y * FLOW_FIELD_SIDE_X_TL + field_x;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Index of the tile at an offset of another one, FLOW_TILE_NONE when it falls out of the field
+ */
+static inline uint32_t flow_get_neighbor_idx(uint32_t tile_idx, int32_t delta_x, int32_t delta_y)
+{
+	uint32_t result = FLOW_TILE_NONE;
+	uint32_t field_x = tile_idx % FLOW_FIELD_SIDE_X_TL + (uint32_t)delta_x;
+	uint32_t field_y = tile_idx / FLOW_FIELD_SIDE_X_TL + (uint32_t)delta_y;
+
+	if (field_x < FLOW_FIELD_SIDE_X_TL && field_y < FLOW_FIELD_SIDE_Y_TL) {
+		result = field_y * FLOW_FIELD_SIDE_X_TL + field_x;
+	}
+
+	return result;
+}
+
+static inline uint32_t flow_is_tile_walkable(const FlowField *field, Map *map, uint32_t tile_idx)
+{
+	uint32_t tile_x = field->min_tile_x + tile_idx % FLOW_FIELD_SIDE_X_TL;
+	uint32_t tile_y = field->min_tile_y + tile_idx / FLOW_FIELD_SIDE_X_TL;
+	uint32_t result = map_is_tile_walkable(map, tile_x, tile_y, field->tile_z);
+
+	return result;
+}
+
+static inline uint32_t flow_is_tile_reachable(const FlowField *field, uint32_t tile_idx)
+{
+	uint32_t result = tile_idx != FLOW_TILE_NONE && field->costs[tile_idx] != FLOW_COST_UNREACHABLE;
+
+	return result;
+}
+
+/**
+ * @brief Points a tile to its cheapest neighbor, a diagonal is only taken when it does not cut a corner
+ */
+static void flow_update_direction(FlowField *field, uint32_t tile_idx)
+{
+	FlowDirection best_direction = FLOW_DIRECTION_NONE;
+	uint16_t best_cost = field->costs[tile_idx];
+
+	for (uint32_t direction = FLOW_DIRECTION_RIGHT; direction < FLOW_DIRECTION_COUNT; ++direction) {
+		int32_t delta_x = flow_direction_dx[direction];
+		int32_t delta_y = flow_direction_dy[direction];
+		uint32_t neighbor_idx = flow_get_neighbor_idx(tile_idx, delta_x, delta_y);
+
+		if (flow_is_tile_reachable(field, neighbor_idx) && field->costs[neighbor_idx] < best_cost &&
+		    flow_is_tile_reachable(field, flow_get_neighbor_idx(tile_idx, delta_x, 0)) &&
+		    flow_is_tile_reachable(field, flow_get_neighbor_idx(tile_idx, 0, delta_y))) {
+			best_direction = (FlowDirection)direction;
+			best_cost = field->costs[neighbor_idx];
+		}
+	}
+
+	field->directions[tile_idx] = best_direction;
+}
+
+/**
+ * @brief Spreads the costs of the queued tiles until none goes down, then points again the tiles around the ones
+ * that changed
+ */
+static void flow_relax(FlowField *field, Map *map, FlowUpdate *update)
+{
+	while (update->queue_count > 0) {
+		uint32_t tile_idx = flow_pop(update);
+		uint16_t next_cost = (uint16_t)(field->costs[tile_idx] + 1);
+
+		// Note(fredy): the steps are orthogonal, the diagonals show up when the directions are chosen
+		for (uint32_t direction = FLOW_DIRECTION_RIGHT; direction < FLOW_DIRECTION_COUNT; direction += 2) {
+			uint32_t neighbor_idx = flow_get_neighbor_idx(tile_idx, flow_direction_dx[direction],
+			                                              flow_direction_dy[direction]);
+
+			if (neighbor_idx != FLOW_TILE_NONE && next_cost < field->costs[neighbor_idx] &&
+			    flow_is_tile_walkable(field, map, neighbor_idx)) {
+				field->costs[neighbor_idx] = next_cost;
+				flow_mark_changed(update, neighbor_idx);
+				flow_push(update, neighbor_idx);
+			}
+		}
+	}
+
+	for (uint32_t changed_idx = 0; changed_idx < update->changed_count; ++changed_idx) {
+		uint32_t tile_idx = update->changed_idxs[changed_idx];
+
+		for (uint32_t direction = FLOW_DIRECTION_NONE; direction < FLOW_DIRECTION_COUNT; ++direction) {
+			uint32_t neighbor_idx = flow_get_neighbor_idx(tile_idx, flow_direction_dx[direction],
+			                                              flow_direction_dy[direction]);
+
+			if (neighbor_idx != FLOW_TILE_NONE) {
+				flow_update_direction(field, neighbor_idx);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Builds the whole field around a target with a breadth-first search from it
+ *
+ * @param field
+ * @param map
+ * @param arena Scratch of the search
+ * @param target
+ */
+static void flow_field_build(FlowField *field, Map *map, Arena *arena, Position target)
+{
+	field->min_tile_x = target.tile_x - FLOW_FIELD_SIDE_X_TL / 2;
+	field->min_tile_y = target.tile_y - FLOW_FIELD_SIDE_Y_TL / 2;
+	field->tile_z = target.tile_z;
+	field->target_tile_x = target.tile_x;
+	field->target_tile_y = target.tile_y;
+	field->is_valid = 1U;
+
+	for (uint32_t tile_idx = 0; tile_idx < FLOW_FIELD_SIZE_TL; ++tile_idx) {
+		field->costs[tile_idx] = FLOW_COST_UNREACHABLE;
+		field->directions[tile_idx] = FLOW_DIRECTION_NONE;
+	}
+
+	FlowUpdate update = flow_update_begin(arena);
+	uint32_t target_idx = flow_get_tile_idx(field, target.tile_x, target.tile_y, target.tile_z);
+
+	if (flow_is_tile_walkable(field, map, target_idx)) {
+		field->costs[target_idx] = 0;
+		flow_mark_changed(&update, target_idx);
+		flow_push(&update, target_idx);
+	}
+
+	flow_relax(field, map, &update);
+}
+
+/**
+ * @brief Repairs the field after a tile of the map changed, only the paths that go through the tile are visited
+ *
+ * @param field
+ * @param map
+ * @param arena Scratch of the repair
+ * @param tile_x
+ * @param tile_y
+ * @param tile_z
+ */
+static void flow_field_update_tile(FlowField *field, Map *map, Arena *arena, uint32_t tile_x, uint32_t tile_y,
+                                   uint32_t tile_z)
+{
+	uint32_t tile_idx = flow_get_tile_idx(field, tile_x, tile_y, tile_z);
+
+	if (tile_idx != FLOW_TILE_NONE) {
+		FlowUpdate update = flow_update_begin(arena);
+		flow_mark_changed(&update, tile_idx);
+
+		if (flow_is_tile_walkable(field, map, tile_idx)) {
+			// Note(fredy): an open tile only shortens paths, it is filled from its neighbors and spreads
+			if (tile_x == field->target_tile_x && tile_y == field->target_tile_y) {
+				field->costs[tile_idx] = 0;
+				flow_push(&update, tile_idx);
+			}
+
+			for (uint32_t direction = FLOW_DIRECTION_RIGHT; direction < FLOW_DIRECTION_COUNT;
+			     direction += 2) {
+				uint32_t neighbor_idx = flow_get_neighbor_idx(tile_idx, flow_direction_dx[direction],
+				                                              flow_direction_dy[direction]);
+
+				if (flow_is_tile_reachable(field, neighbor_idx)) {
+					flow_push(&update, neighbor_idx);
+				}
+			}
+		} else if (field->costs[tile_idx] != FLOW_COST_UNREACHABLE) {
+			// Note(fredy): a closed tile lengthens the paths through it, the ones whose cost grows
+			// one step at a time from it. Those tiles are reset and filled again from their neighbors
+			flow_push(&update, tile_idx);
+
+			while (update.queue_count > 0) {
+				uint32_t raised_idx = flow_pop(&update);
+
+				for (uint32_t direction = FLOW_DIRECTION_RIGHT; direction < FLOW_DIRECTION_COUNT;
+				     direction += 2) {
+					uint32_t neighbor_idx =
+						flow_get_neighbor_idx(raised_idx, flow_direction_dx[direction],
+						                      flow_direction_dy[direction]);
+
+					if (neighbor_idx != FLOW_TILE_NONE && !update.is_changed[neighbor_idx] &&
+					    field->costs[neighbor_idx] == field->costs[raised_idx] + 1) {
+						flow_mark_changed(&update, neighbor_idx);
+						flow_push(&update, neighbor_idx);
+					}
+				}
+			}
+
+			for (uint32_t changed_idx = 0; changed_idx < update.changed_count; ++changed_idx) {
+				field->costs[update.changed_idxs[changed_idx]] = FLOW_COST_UNREACHABLE;
+			}
+
+			for (uint32_t changed_idx = 0; changed_idx < update.changed_count; ++changed_idx) {
+				uint32_t raised_idx = update.changed_idxs[changed_idx];
+
+				for (uint32_t direction = FLOW_DIRECTION_RIGHT; direction < FLOW_DIRECTION_COUNT;
+				     direction += 2) {
+					uint32_t neighbor_idx =
+						flow_get_neighbor_idx(raised_idx, flow_direction_dx[direction],
+						                      flow_direction_dy[direction]);
+
+					if (flow_is_tile_reachable(field, neighbor_idx)) {
+						flow_push(&update, neighbor_idx);
+					}
+				}
+			}
+		}
+
+		flow_relax(field, map, &update);
+	}
+}
+
+/**
+ * @brief Direction to walk from a position towards the target of the field, zero on the target, out of the field
+ * and where there is no path
+ */
+static inline Vtwo flow_field_sample(const FlowField *field, Position pos)
+{
+	static const Vtwo directions[FLOW_DIRECTION_COUNT] = {
+		{ .x = 0.0F, .y = 0.0F },
+		{ .x = 1.0F, .y = 0.0F },
+		{ .x = 0.70710678F, .y = 0.70710678F },
+		{ .x = 0.0F, .y = 1.0F },
+		{ .x = -0.70710678F, .y = 0.70710678F },
+		{ .x = -1.0F, .y = 0.0F },
+		{ .x = -0.70710678F, .y = -0.70710678F },
+		{ .x = 0.0F, .y = -1.0F },
+		{ .x = 0.70710678F, .y = -0.70710678F },
+	};
+	Vtwo result = {};
+	uint32_t tile_idx = flow_get_tile_idx(field, pos.tile_x, pos.tile_y, pos.tile_z);
+
+	if (tile_idx != FLOW_TILE_NONE) {
+		result = directions[field->directions[tile_idx]];
+	}
+
+	return result;
+}
+
+/**
+ * @brief Keeps the flow field converging on the entity tracked by the camera, it is built again when the entity
+ * steps on another tile
+ */
+static void game_update_flow_field(Game *game, Arena *arena)
+{
+	uint32_t target_idx = game->entity_tracked_by_camera_idx;
+	Position target = game->entity_positions[target_idx];
+	FlowField *field = &game->flow_field;
+
+	if (game->entity_residences[target_idx] != ENTITY_RESIDENCE_NONEXISTENT &&
+	    (!field->is_valid || target.tile_x != field->target_tile_x || target.tile_y != field->target_tile_y ||
+	     target.tile_z != field->tile_z)) {
+		flow_field_build(field, game->world->map, arena, target);
+	}
+}
+
+/**
+ * @brief Changes a tile of the map while the game runs, the flow field is repaired around it
+ */
+static void game_set_tile_value(Game *game, Arena *arena, uint32_t tile_x, uint32_t tile_y, uint32_t tile_z,
+                                TileType tile_type)
+{
+	Map *map = game->world->map;
+	FlowField *field = &game->flow_field;
+	ChunkPosition cpos = map_get_chunk_pos(tile_x, tile_y, tile_z);
+	uint32_t had_tiles = map_get_chunk(map, cpos.chunk_x, cpos.chunk_y, cpos.chunk_z)->tiles != nullptr;
+
+	map_set_tile_value(map, tile_x, tile_y, tile_z, tile_type);
+
+	if (had_tiles) {
+		flow_field_update_tile(field, map, arena, tile_x, tile_y, tile_z);
+	} else if (field->is_valid) {
+		// Note(fredy): the chunk got its tiles now and all the others turned empty, the field is built again
+		Position target = {
+			.tile_x = field->target_tile_x,
+			.tile_y = field->target_tile_y,
+			.tile_z = field->tile_z,
+		};
+		flow_field_build(field, map, arena, target);
+	}
+
+	// Note(fredy): a tile that changes can open or close the sight of many others, the visibility is computed again
+	game->visibility.is_valid = 0U;
+}
+
+// =============================================================================
+// Pathfinding
+// =============================================================================
+
+#define PATH_TILE_NONE UINT32_MAX
+
+// Costs of the steps between tiles, the diagonal is the straight one times sqrt(2)
+#define PATH_COST_STRAIGHT 10U
+#define PATH_COST_DIAGONAL 14U
+
+// Keys of the start and the goal in the search between the chunks, the nodes take chunk_idx * nodes + node_idx
+#define PATH_KEY_START (UINT32_MAX - 1)
+#define PATH_KEY_GOAL UINT32_MAX
+
+// Entries of the open lists, a search that runs out of them finds no path
+#define PATH_MAX_JUMP_OPEN (8U * CHUNK_SIZE_TL)
+#define PATH_MAX_OPEN (1U << 16)
+
+// Weight of the heuristic between the chunks in quarters. The octile distance never overestimates the cost left, so
+// with 6/4 of it a path costs at most 1.5 times the shortest one through the openings. They come out a few percent
+// longer in practice but the search does not go through every opening whose estimate is under the cost of the path
+#define PATH_HEURISTIC_QUARTERS 6U
+
+// Nodes the search from the goal expands looking for a pocket closed around it
+#define PATH_MAX_POCKET_EXPAND 64U
+
+static const int32_t path_side_dx[PATH_SIDE_COUNT] = { 1, 0, -1, 0 };
+static const int32_t path_side_dy[PATH_SIDE_COUNT] = { 0, 1, 0, -1 };
+
+/**
+ * @brief Walkable tiles of a chunk, a bit per tile
+ */
+typedef struct PathGrid {
+	uint16_t rows[CHUNK_SIDE_TL];
+} PathGrid;
+
+typedef struct PathHeapEntry {
+	uint32_t priority;
+	uint32_t key;
+} PathHeapEntry;
+
+/**
+ * @brief Binary min-heap of the open nodes of a search, a node is pushed again when its cost goes down and the stale
+ * entries are skipped when they are popped
+ */
+typedef struct PathHeap {
+	PathHeapEntry *entries;
+	uint32_t count;
+	uint32_t capacity;
+} PathHeap;
+
+/**
+ * @brief Scratch of a Jump Point Search inside a chunk
+ */
+typedef struct PathJumpSearch {
+	uint32_t costs[CHUNK_SIZE_TL];
+	uint8_t parent_idxs[CHUNK_SIZE_TL];
+	uint8_t is_closed[CHUNK_SIZE_TL];
+	PathHeapEntry open_entries[PATH_MAX_JUMP_OPEN];
+} PathJumpSearch;
+
+/**
+ * @brief State of the nodes of a chunk in a search between the openings
+ */
+typedef struct PathNodeStates {
+	uint32_t chunk_idx;
+	uint8_t is_closed[PATH_MAX_CHUNK_NODES];
+	uint32_t costs[PATH_MAX_CHUNK_NODES];
+	uint32_t parent_keys[PATH_MAX_CHUNK_NODES];
+} PathNodeStates;
+
+typedef struct PathResult {
+	uint32_t count;
+	Position *waypoints;
+} PathResult;
+
+static uint32_t path_heap_push(PathHeap *heap, uint32_t priority, uint32_t key)
+{
+	uint32_t was_pushed = heap->count < heap->capacity;
+
+	if (was_pushed) {
+		uint32_t entry_idx = heap->count++;
+
+		while (entry_idx > 0 && heap->entries[(entry_idx - 1) / 2].priority > priority) {
+			heap->entries[entry_idx] = heap->entries[(entry_idx - 1) / 2];
+			entry_idx = (entry_idx - 1) / 2;
+		}
+
+		heap->entries[entry_idx] = (PathHeapEntry){ .priority = priority, .key = key };
+	}
+
+	return was_pushed;
+}
+
+static PathHeapEntry path_heap_pop(PathHeap *heap)
+{
+	PathHeapEntry result = heap->entries[0];
+	PathHeapEntry last = heap->entries[--heap->count];
+	uint32_t entry_idx = 0;
+	uint32_t child_idx = 1;
+
+	while (child_idx < heap->count) {
+		if (child_idx + 1 < heap->count &&
+		    heap->entries[child_idx + 1].priority < heap->entries[child_idx].priority) {
+			++child_idx;
+		}
+
+		if (last.priority <= heap->entries[child_idx].priority) {
+			break;
+		}
+
+		heap->entries[entry_idx] = heap->entries[child_idx];
+		entry_idx = child_idx;
+		child_idx = entry_idx * 2 + 1;
+	}
+
+	heap->entries[entry_idx] = last;
+
+	return result;
+}
+
+static PathGrid path_load_grid(const TileChunk *chunk)
+{
+	PathGrid result = {};
+
+	if (chunk->tiles) {
+		for (uint32_t tile_y = 0; tile_y < CHUNK_SIDE_TL; ++tile_y) {
+			for (uint32_t tile_x = 0; tile_x < CHUNK_SIDE_TL; ++tile_x) {
+				if (tile_is_walkable(chunk->tiles[tile_y * CHUNK_SIDE_TL + tile_x])) {
+					result.rows[tile_y] |= (uint16_t)(1U << tile_x);
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static inline uint32_t path_is_walkable(const PathGrid *grid, int32_t tile_x, int32_t tile_y)
+{
+	uint32_t result = 0U;
+
+	if ((uint32_t)tile_x < CHUNK_SIDE_TL && (uint32_t)tile_y < CHUNK_SIDE_TL) {
+		result = (grid->rows[tile_y] >> tile_x) & 1U;
+	}
+
+	return result;
+}
+
+static inline uint32_t path_get_tile_idx(int32_t tile_x, int32_t tile_y)
+{
+	uint32_t result = (uint32_t)(tile_y * (int32_t)CHUNK_SIDE_TL + tile_x);
+
+	return result;
+}
+
+static inline uint32_t path_get_octile_cost(int32_t delta_x, int32_t delta_y)
+{
+	uint32_t min_delta = NUMBER_MIN(int_abs(delta_x), int_abs(delta_y));
+	uint32_t max_delta = NUMBER_MAX(int_abs(delta_x), int_abs(delta_y));
+	uint32_t result = PATH_COST_DIAGONAL * min_delta + PATH_COST_STRAIGHT * (max_delta - min_delta);
+
+	return result;
+}
+
+static inline uint32_t path_get_tiles_cost(uint32_t from_tile_idx, uint32_t to_tile_idx)
+{
+	int32_t delta_x = (int32_t)(to_tile_idx % CHUNK_SIDE_TL) - (int32_t)(from_tile_idx % CHUNK_SIDE_TL);
+	int32_t delta_y = (int32_t)(to_tile_idx / CHUNK_SIDE_TL) - (int32_t)(from_tile_idx / CHUNK_SIDE_TL);
+	uint32_t result = path_get_octile_cost(delta_x, delta_y);
+
+	return result;
+}
+
+/**
+ * @brief Walks straight from a tile until it is blocked, reaches the goal or finds a tile with a forced neighbor,
+ * a side tile that opens right after a wall
+ */
+static uint32_t path_jump_straight(const PathGrid *grid, int32_t tile_x, int32_t tile_y, int32_t delta_x,
+                                   int32_t delta_y, uint32_t goal_idx)
+{
+	uint32_t result = PATH_TILE_NONE;
+	int32_t side_x = delta_y != 0;
+	int32_t side_y = delta_x != 0;
+
+	while (path_is_walkable(grid, tile_x, tile_y) && result == PATH_TILE_NONE) {
+		uint32_t is_forced =
+			(path_is_walkable(grid, tile_x + side_x, tile_y + side_y) &&
+			 !path_is_walkable(grid, tile_x + side_x - delta_x, tile_y + side_y - delta_y)) ||
+			(path_is_walkable(grid, tile_x - side_x, tile_y - side_y) &&
+			 !path_is_walkable(grid, tile_x - side_x - delta_x, tile_y - side_y - delta_y));
+
+		if (path_get_tile_idx(tile_x, tile_y) == goal_idx || is_forced) {
+			result = path_get_tile_idx(tile_x, tile_y);
+		}
+
+		tile_x += delta_x;
+		tile_y += delta_y;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Next jump point from a tile in a direction. A diagonal stops where one of its straight jumps finds
+ * something and does not cut corners
+ */
+static uint32_t path_jump(const PathGrid *grid, int32_t tile_x, int32_t tile_y, int32_t delta_x, int32_t delta_y,
+                          uint32_t goal_idx)
+{
+	uint32_t result = PATH_TILE_NONE;
+
+	if (!delta_x || !delta_y) {
+		result = path_jump_straight(grid, tile_x, tile_y, delta_x, delta_y, goal_idx);
+	} else {
+		uint32_t is_open = path_is_walkable(grid, tile_x, tile_y);
+
+		while (is_open && result == PATH_TILE_NONE) {
+			uint32_t jump_x_idx = path_jump_straight(grid, tile_x + delta_x, tile_y, delta_x, 0, goal_idx);
+			uint32_t jump_y_idx = path_jump_straight(grid, tile_x, tile_y + delta_y, 0, delta_y, goal_idx);
+
+			if (path_get_tile_idx(tile_x, tile_y) == goal_idx || jump_x_idx != PATH_TILE_NONE ||
+			    jump_y_idx != PATH_TILE_NONE) {
+				result = path_get_tile_idx(tile_x, tile_y);
+			}
+
+			is_open = path_is_walkable(grid, tile_x + delta_x, tile_y) &&
+			          path_is_walkable(grid, tile_x, tile_y + delta_y) &&
+			          path_is_walkable(grid, tile_x + delta_x, tile_y + delta_y);
+			tile_x += delta_x;
+			tile_y += delta_y;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Directions to jump from a tile reached in a direction, the start tries all of them
+ */
+static uint32_t path_get_jump_directions(const PathGrid *grid, int32_t tile_x, int32_t tile_y, int32_t delta_x,
+                                         int32_t delta_y, int32_t *directions_x, int32_t *directions_y)
+{
+	uint32_t result = 0;
+
+	if (!delta_x && !delta_y) {
+		for (int32_t direction_y = -1; direction_y <= 1; ++direction_y) {
+			for (int32_t direction_x = -1; direction_x <= 1; ++direction_x) {
+				if ((direction_x || direction_y) &&
+				    path_is_walkable(grid, tile_x + direction_x, tile_y) &&
+				    path_is_walkable(grid, tile_x, tile_y + direction_y)) {
+					directions_x[result] = direction_x;
+					directions_y[result++] = direction_y;
+				}
+			}
+		}
+	} else if (delta_x && delta_y) {
+		uint32_t is_x_open = path_is_walkable(grid, tile_x + delta_x, tile_y);
+		uint32_t is_y_open = path_is_walkable(grid, tile_x, tile_y + delta_y);
+
+		if (is_x_open) {
+			directions_x[result] = delta_x;
+			directions_y[result++] = 0;
+		}
+
+		if (is_y_open) {
+			directions_x[result] = 0;
+			directions_y[result++] = delta_y;
+		}
+
+		if (is_x_open && is_y_open) {
+			directions_x[result] = delta_x;
+			directions_y[result++] = delta_y;
+		}
+	} else {
+		// Note(fredy): corners are not cut, so the side tiles are forced neighbors whenever they are open
+		int32_t side_x = delta_y != 0;
+		int32_t side_y = delta_x != 0;
+		uint32_t is_next_open = path_is_walkable(grid, tile_x + delta_x, tile_y + delta_y);
+
+		if (is_next_open) {
+			directions_x[result] = delta_x;
+			directions_y[result++] = delta_y;
+		}
+
+		for (int32_t side = -1; side <= 1; side += 2) {
+			if (path_is_walkable(grid, tile_x + side * side_x, tile_y + side * side_y)) {
+				directions_x[result] = side * side_x;
+				directions_y[result++] = side * side_y;
+
+				if (is_next_open) {
+					directions_x[result] = delta_x + side * side_x;
+					directions_y[result++] = delta_y + side * side_y;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Jump Point Search between two tiles of a chunk on 8 directions without cutting corners, the path is left
+ * in the parents of the search
+ *
+ * @return uint32_t Cost of the path, PATH_TILE_NONE when there is none
+ */
+static uint32_t path_jump_search(const PathGrid *grid, PathJumpSearch *search, uint32_t start_idx, uint32_t goal_idx)
+{
+	uint32_t result = PATH_TILE_NONE;
+	PathHeap open = { .entries = search->open_entries, .capacity = PATH_MAX_JUMP_OPEN };
+
+	for (uint32_t tile_idx = 0; tile_idx < CHUNK_SIZE_TL; ++tile_idx) {
+		search->costs[tile_idx] = UINT32_MAX;
+		search->is_closed[tile_idx] = 0U;
+	}
+
+	search->costs[start_idx] = 0;
+	search->parent_idxs[start_idx] = (uint8_t)start_idx;
+	path_heap_push(&open, path_get_tiles_cost(start_idx, goal_idx), start_idx);
+
+	while (open.count > 0 && result == PATH_TILE_NONE) {
+		uint32_t tile_idx = path_heap_pop(&open).key;
+
+		if (tile_idx == goal_idx) {
+			result = search->costs[goal_idx];
+		} else if (!search->is_closed[tile_idx]) {
+			search->is_closed[tile_idx] = 1U;
+
+			int32_t tile_x = (int32_t)(tile_idx % CHUNK_SIDE_TL);
+			int32_t tile_y = (int32_t)(tile_idx / CHUNK_SIDE_TL);
+			int32_t parent_x = (int32_t)(search->parent_idxs[tile_idx] % CHUNK_SIDE_TL);
+			int32_t parent_y = (int32_t)(search->parent_idxs[tile_idx] / CHUNK_SIDE_TL);
+			int32_t directions_x[8];
+			int32_t directions_y[8];
+			uint32_t direction_count = path_get_jump_directions(grid, tile_x, tile_y,
+			                                                    (tile_x > parent_x) - (tile_x < parent_x),
+			                                                    (tile_y > parent_y) - (tile_y < parent_y),
+			                                                    directions_x, directions_y);
+
+			for (uint32_t direction_idx = 0; direction_idx < direction_count; ++direction_idx) {
+				int32_t delta_x = directions_x[direction_idx];
+				int32_t delta_y = directions_y[direction_idx];
+				uint32_t jump_idx =
+					path_jump(grid, tile_x + delta_x, tile_y + delta_y, delta_x, delta_y, goal_idx);
+
+				if (jump_idx != PATH_TILE_NONE && !search->is_closed[jump_idx]) {
+					uint32_t cost = search->costs[tile_idx];
+					cost += path_get_tiles_cost(tile_idx, jump_idx);
+					uint32_t heuristic = path_get_tiles_cost(jump_idx, goal_idx);
+
+					if (cost < search->costs[jump_idx]) {
+						search->costs[jump_idx] = cost;
+						search->parent_idxs[jump_idx] = (uint8_t)tile_idx;
+						path_heap_push(&open, cost + heuristic, jump_idx);
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief Costs from a tile to all the tiles of a chunk on 8 directions without cutting corners, left in the costs of
+ * the search. The steps can be taken both ways so they are the costs to the tile as well
+ */
+static void path_flood_chunk(const PathGrid *grid, PathJumpSearch *search, uint32_t from_idx)
+{
+	PathHeap open = { .entries = search->open_entries, .capacity = PATH_MAX_JUMP_OPEN };
+
+	for (uint32_t tile_idx = 0; tile_idx < CHUNK_SIZE_TL; ++tile_idx) {
+		search->costs[tile_idx] = UINT32_MAX;
+		search->is_closed[tile_idx] = 0U;
+	}
+
+	search->costs[from_idx] = 0;
+	path_heap_push(&open, 0, from_idx);
+
+	while (open.count > 0) {
+		uint32_t tile_idx = path_heap_pop(&open).key;
+
+		if (!search->is_closed[tile_idx]) {
+			int32_t tile_x = (int32_t)(tile_idx % CHUNK_SIDE_TL);
+			int32_t tile_y = (int32_t)(tile_idx / CHUNK_SIDE_TL);
+
+			search->is_closed[tile_idx] = 1U;
+
+			for (int32_t delta_y = -1; delta_y <= 1; ++delta_y) {
+				for (int32_t delta_x = -1; delta_x <= 1; ++delta_x) {
+					int32_t next_x = tile_x + delta_x;
+					int32_t next_y = tile_y + delta_y;
+
+					if ((delta_x || delta_y) && path_is_walkable(grid, next_x, next_y) &&
+					    path_is_walkable(grid, next_x, tile_y) &&
+					    path_is_walkable(grid, tile_x, next_y)) {
+						uint32_t next_idx = path_get_tile_idx(next_x, next_y);
+						uint32_t cost = search->costs[tile_idx];
+						cost += delta_x && delta_y ? PATH_COST_DIAGONAL : PATH_COST_STRAIGHT;
+
+						if (cost < search->costs[next_idx]) {
+							search->costs[next_idx] = cost;
+							path_heap_push(&open, cost, next_idx);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+static inline uint32_t path_get_edge_tile_idx(uint32_t side, uint32_t edge_idx)
+{
+	int32_t delta_x = path_side_dx[side];
+	int32_t delta_y = path_side_dy[side];
+	uint32_t tile_x = delta_x > 0 ? CHUNK_MASK : (delta_x < 0 ? 0 : edge_idx);
+	uint32_t tile_y = delta_y > 0 ? CHUNK_MASK : (delta_y < 0 ? 0 : edge_idx);
+	uint32_t result = (uint32_t)(tile_y * CHUNK_SIDE_TL + tile_x);
+
+	return result;
+}
+
+/**
+ * @brief Tile of the neighbor chunk right across an edge tile
+ */
+static inline uint32_t path_get_across_tile_idx(uint32_t side, uint32_t tile_idx)
+{
+	uint32_t tile_x = (tile_idx % CHUNK_SIDE_TL + (uint32_t)path_side_dx[side]) & CHUNK_MASK;
+	uint32_t tile_y = (tile_idx / CHUNK_SIDE_TL + (uint32_t)path_side_dy[side]) & CHUNK_MASK;
+	uint32_t result = (uint32_t)(tile_y * CHUNK_SIDE_TL + tile_x);
+
+	return result;
+}
+
+static inline uint32_t path_get_neighbor_chunk_idx(uint32_t chunk_idx, uint32_t side)
+{
+	uint32_t chunk_x = chunk_idx % MAP_SIDE_X_CHK + (uint32_t)path_side_dx[side];
+	uint32_t chunk_y = chunk_idx / MAP_SIDE_X_CHK % MAP_SIDE_Y_CHK + (uint32_t)path_side_dy[side];
+	uint32_t chunk_z = chunk_idx / MAP_SIZE_XY_CHK;
+	uint32_t result =
+		chunk_z * MAP_SIZE_XY_CHK + chunk_y % MAP_SIDE_Y_CHK * MAP_SIDE_X_CHK + chunk_x % MAP_SIDE_X_CHK;
+
+	return result;
+}
+
+/**
+ * @brief Finds the openings of a chunk to its neighbors, a node in the middle of each, and the costs between them
+ */
+static void path_build_chunk(Map *map, PathJumpSearch *search, uint32_t chunk_idx)
+{
+	TileChunk *chunk = &map->chunks[chunk_idx];
+	PathChunk *path = chunk->path;
+	PathGrid grid = path_load_grid(chunk);
+
+	path->node_count = 0;
+
+	for (uint32_t side = PATH_SIDE_RIGHT; side < PATH_SIDE_COUNT; ++side) {
+		PathGrid neighbor_grid = path_load_grid(&map->chunks[path_get_neighbor_chunk_idx(chunk_idx, side)]);
+		uint32_t run_first_idx = PATH_TILE_NONE;
+
+		for (uint32_t edge_idx = 0; edge_idx <= CHUNK_SIDE_TL; ++edge_idx) {
+			uint32_t is_open = 0U;
+
+			if (edge_idx < CHUNK_SIDE_TL) {
+				uint32_t tile_idx = path_get_edge_tile_idx(side, edge_idx);
+				uint32_t across_idx = path_get_across_tile_idx(side, tile_idx);
+
+				is_open = path_is_walkable(&grid, (int32_t)(tile_idx % CHUNK_SIDE_TL),
+				                           (int32_t)(tile_idx / CHUNK_SIDE_TL)) &&
+				          path_is_walkable(&neighbor_grid, (int32_t)(across_idx % CHUNK_SIDE_TL),
+				                           (int32_t)(across_idx / CHUNK_SIDE_TL));
+			}
+
+			if (is_open && run_first_idx == PATH_TILE_NONE) {
+				run_first_idx = edge_idx;
+			} else if (!is_open && run_first_idx != PATH_TILE_NONE) {
+				// Note(fredy): both chunks take the same middle tile, the nodes pair up across the edge
+				assert(path->node_count < PATH_MAX_CHUNK_NODES);
+				path->node_tile_idxs[path->node_count] =
+					(uint8_t)path_get_edge_tile_idx(side, (run_first_idx + edge_idx - 1) / 2);
+				path->node_sides[path->node_count] = (PathSide)side;
+				++path->node_count;
+				run_first_idx = PATH_TILE_NONE;
+			}
+		}
+	}
+
+	for (uint32_t node_idx = 0; node_idx < path->node_count; ++node_idx) {
+		path->costs[node_idx][node_idx] = 0;
+		path_flood_chunk(&grid, search, path->node_tile_idxs[node_idx]);
+
+		for (uint32_t other_idx = node_idx + 1; other_idx < path->node_count; ++other_idx) {
+			uint32_t cost = search->costs[path->node_tile_idxs[other_idx]];
+			uint16_t node_cost = cost == PATH_TILE_NONE ? PATH_COST_NONE : (uint16_t)cost;
+
+			path->costs[node_idx][other_idx] = node_cost;
+			path->costs[other_idx][node_idx] = node_cost;
+		}
+	}
+
+	path->is_dirty = 0U;
+}
+
+/**
+ * @brief Abstract graph of a chunk, built again if its tiles changed
+ */
+static PathChunk *path_get_chunk(Map *map, Arena *arena, PathJumpSearch *search, uint32_t chunk_idx)
+{
+	TileChunk *chunk = &map->chunks[chunk_idx];
+
+	if (!chunk->path) {
+		chunk->path = ARENA_PUSH_STRUCT_ZERO(arena, PathChunk);
+		chunk->path->is_dirty = 1U;
+	}
+
+	PathChunk *result = chunk->path;
+
+	if (result->is_dirty) {
+		path_build_chunk(map, search, chunk_idx);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Shortest signed delta between two tiles of the map, it wraps around like the map does
+ */
+static inline int32_t path_get_map_delta(uint32_t from_tile, uint32_t to_tile, uint32_t map_side_tl)
+{
+	int32_t result = (int32_t)((to_tile - from_tile) & (map_side_tl - 1));
+
+	if (result >= (int32_t)(map_side_tl / 2)) {
+		result -= (int32_t)map_side_tl;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Tile of a node in the map, it wraps every map side
+ */
+static inline void path_get_node_tile(uint32_t chunk_idx, uint32_t tile_idx, uint32_t *tile_x, uint32_t *tile_y)
+{
+	*tile_x = (uint32_t)(chunk_idx % MAP_SIDE_X_CHK * CHUNK_SIDE_TL + tile_idx % CHUNK_SIDE_TL);
+	*tile_y = (uint32_t)(chunk_idx / MAP_SIDE_X_CHK % MAP_SIDE_Y_CHK * CHUNK_SIDE_TL + tile_idx / CHUNK_SIDE_TL);
+}
+
+/**
+ * @brief State of a search between the openings of the chunks
+ */
+typedef struct PathSearch {
+	Map *map;
+
+	/**
+	 * @brief Where the chunks that are reached for the first time keep their abstract graphs
+	 */
+	Arena *graph_arena;
+
+	PathJumpSearch *jump_search;
+	PathHeap open;
+
+	/**
+	 * @brief 1 + index in node_states of every chunk of the map the search reached, 0 for the others
+	 */
+	uint16_t *chunk_state_idxs;
+
+	/**
+	 * @brief Room for every chunk of a level, the search does not leave the level it starts on
+	 */
+	PathNodeStates *node_states;
+	uint32_t node_state_count;
+
+	uint32_t goal_chunk_idx;
+	uint32_t goal_tile_x;
+	uint32_t goal_tile_y;
+
+	/**
+	 * @brief Costs from the nodes of the goal chunk to the goal
+	 */
+	const uint32_t *goal_node_costs;
+
+	uint32_t goal_cost;
+	uint32_t goal_parent_key;
+} PathSearch;
+
+/**
+ * @brief State of the nodes of a chunk in the running search, they start unreached the first time it is asked for
+ */
+static PathNodeStates *path_get_node_states(PathSearch *search, uint32_t chunk_idx)
+{
+	uint32_t state_idx = search->chunk_state_idxs[chunk_idx];
+
+	if (state_idx == 0) {
+		assert(search->node_state_count < MAP_SIZE_XY_CHK);
+
+		PathNodeStates *states = &search->node_states[search->node_state_count++];
+		states->chunk_idx = chunk_idx;
+		memset(states->is_closed, 0, sizeof(states->is_closed));
+
+		for (uint32_t node_idx = 0; node_idx < PATH_MAX_CHUNK_NODES; ++node_idx) {
+			states->costs[node_idx] = UINT32_MAX;
+			states->parent_keys[node_idx] = PATH_KEY_START;
+		}
+
+		state_idx = search->node_state_count;
+		search->chunk_state_idxs[chunk_idx] = (uint16_t)state_idx;
+	}
+
+	PathNodeStates *result = &search->node_states[state_idx - 1];
+
+	return result;
+}
+
+static void path_open_node(PathSearch *search, PathChunk *path, uint32_t chunk_idx, uint32_t node_idx, uint32_t cost,
+                           uint32_t parent_key)
+{
+	PathNodeStates *states = path_get_node_states(search, chunk_idx);
+
+	if (!states->is_closed[node_idx] && cost < states->costs[node_idx]) {
+		uint32_t tile_x = 0;
+		uint32_t tile_y = 0;
+		path_get_node_tile(chunk_idx, path->node_tile_idxs[node_idx], &tile_x, &tile_y);
+
+		int32_t delta_x = path_get_map_delta(tile_x, search->goal_tile_x, MAP_SIDE_X_TL);
+		int32_t delta_y = path_get_map_delta(tile_y, search->goal_tile_y, MAP_SIDE_Y_TL);
+		uint32_t heuristic = path_get_octile_cost(delta_x, delta_y) * PATH_HEURISTIC_QUARTERS / 4;
+
+		states->costs[node_idx] = cost;
+		states->parent_keys[node_idx] = parent_key;
+		path_heap_push(&search->open, cost + heuristic, chunk_idx * PATH_MAX_CHUNK_NODES + node_idx);
+	}
+}
+
+/**
+ * @brief Opens the neighbors of a node, the other nodes of its chunk, the node across its edge and the goal when
+ * the node is in the goal chunk
+ */
+static void path_expand_node(PathSearch *search, uint32_t key)
+{
+	uint32_t chunk_idx = key / PATH_MAX_CHUNK_NODES;
+	uint32_t node_idx = key % PATH_MAX_CHUNK_NODES;
+	PathChunk *path = search->map->chunks[chunk_idx].path;
+	PathNodeStates *states = path_get_node_states(search, chunk_idx);
+	uint32_t cost = states->costs[node_idx];
+
+	states->is_closed[node_idx] = 1U;
+
+	if (chunk_idx == search->goal_chunk_idx && search->goal_node_costs[node_idx] != PATH_TILE_NONE &&
+	    cost + search->goal_node_costs[node_idx] < search->goal_cost) {
+		search->goal_cost = cost + search->goal_node_costs[node_idx];
+		search->goal_parent_key = key;
+		path_heap_push(&search->open, search->goal_cost, PATH_KEY_GOAL);
+	}
+
+	for (uint32_t other_idx = 0; other_idx < path->node_count; ++other_idx) {
+		uint16_t other_cost = path->costs[node_idx][other_idx];
+
+		if (other_idx != node_idx && other_cost != PATH_COST_NONE) {
+			path_open_node(search, path, chunk_idx, other_idx, cost + other_cost, key);
+		}
+	}
+
+	uint32_t side = path->node_sides[node_idx];
+	uint32_t across_chunk_idx = path_get_neighbor_chunk_idx(chunk_idx, side);
+	uint32_t across_idx = path_get_across_tile_idx(side, path->node_tile_idxs[node_idx]);
+	uint32_t across_side = (side + 2) % PATH_SIDE_COUNT;
+	PathChunk *across_path =
+		path_get_chunk(search->map, search->graph_arena, search->jump_search, across_chunk_idx);
+
+	for (uint32_t other_idx = 0; other_idx < across_path->node_count; ++other_idx) {
+		if (across_path->node_tile_idxs[other_idx] == across_idx &&
+		    across_path->node_sides[other_idx] == across_side) {
+			uint32_t across_cost = cost + PATH_COST_STRAIGHT;
+			path_open_node(search, across_path, across_chunk_idx, other_idx, across_cost, key);
+		}
+	}
+}
+
+/**
+ * @brief Adds a waypoint, every waypoint is a short step from the last one so it is placed next to it even when
+ * the tile space wraps
+ */
+static void path_push_waypoint(Arena *arena, PathResult *result, Position *last, uint32_t tile_x, uint32_t tile_y)
+{
+	last->tile_x += (uint32_t)path_get_map_delta(last->tile_x & (MAP_SIDE_X_TL - 1), tile_x, MAP_SIDE_X_TL);
+	last->tile_y += (uint32_t)path_get_map_delta(last->tile_y & (MAP_SIDE_Y_TL - 1), tile_y, MAP_SIDE_Y_TL);
+
+	Position *waypoint = ARENA_PUSH_STRUCT(arena, Position);
+	*waypoint = *last;
+	++result->count;
+}
+
+/**
+ * @brief Adds the jump points of the path between two tiles of a chunk, the first tile excluded
+ */
+static void path_push_chunk_waypoints(Arena *arena, PathResult *result, Position *last, Map *map,
+                                      PathJumpSearch *jump_search, uint32_t chunk_idx, uint32_t from_idx,
+                                      uint32_t to_idx)
+{
+	if (from_idx != to_idx) {
+		PathGrid grid = path_load_grid(&map->chunks[chunk_idx]);
+		uint8_t tile_idxs[CHUNK_SIZE_TL];
+		uint32_t tile_count = 0;
+
+		path_jump_search(&grid, jump_search, from_idx, to_idx);
+
+		for (uint32_t tile_idx = to_idx; tile_idx != from_idx; tile_idx = jump_search->parent_idxs[tile_idx]) {
+			tile_idxs[tile_count++] = (uint8_t)tile_idx;
+		}
+
+		while (tile_count > 0) {
+			uint32_t tile_x = 0;
+			uint32_t tile_y = 0;
+			path_get_node_tile(chunk_idx, tile_idxs[--tile_count], &tile_x, &tile_y);
+			path_push_waypoint(arena, result, last, tile_x, tile_y);
+		}
+	}
+}
+
+static inline uint32_t path_get_parent_key(PathSearch *search, uint32_t key)
+{
+	PathNodeStates *states = path_get_node_states(search, key / PATH_MAX_CHUNK_NODES);
+	uint32_t result = states->parent_keys[key % PATH_MAX_CHUNK_NODES];
+
+	return result;
+}
+
+static inline uint32_t path_is_node_closed(PathSearch *search, uint32_t key)
+{
+	PathNodeStates *states = path_get_node_states(search, key / PATH_MAX_CHUNK_NODES);
+	uint32_t result = states->is_closed[key % PATH_MAX_CHUNK_NODES];
+
+	return result;
+}
+
+/**
+ * @brief Starts a search between the openings from the nodes of the start chunk, they are opened with their costs
+ * from the start
+ */
+static void path_begin_search(PathSearch *search, uint32_t start_chunk_idx, const uint32_t *start_node_costs,
+                              uint32_t goal_chunk_idx, Position goal, const uint32_t *goal_node_costs)
+{
+	// Note(fredy): only the chunks the last search reached are forgotten, the rest of the table is still zero
+	for (uint32_t state_idx = 0; state_idx < search->node_state_count; ++state_idx) {
+		search->chunk_state_idxs[search->node_states[state_idx].chunk_idx] = 0;
+	}
+
+	search->node_state_count = 0;
+	search->open.count = 0;
+	search->goal_chunk_idx = goal_chunk_idx;
+	search->goal_tile_x = goal.tile_x & (MAP_SIDE_X_TL - 1);
+	search->goal_tile_y = goal.tile_y & (MAP_SIDE_Y_TL - 1);
+	search->goal_node_costs = goal_node_costs;
+	search->goal_cost = PATH_TILE_NONE;
+	search->goal_parent_key = PATH_KEY_START;
+
+	PathChunk *start_path = path_get_chunk(search->map, search->graph_arena, search->jump_search, start_chunk_idx);
+
+	for (uint32_t node_idx = 0; node_idx < start_path->node_count; ++node_idx) {
+		if (start_node_costs[node_idx] != PATH_TILE_NONE) {
+			path_open_node(search, start_path, start_chunk_idx, node_idx, start_node_costs[node_idx],
+			               PATH_KEY_START);
+		}
+	}
+}
+
+/**
+ * @brief Expands the nodes of a search until it reaches the goal, runs out of open nodes or expands the given
+ * number of them
+ *
+ * @return uint32_t Whether the search is over, the goal cost tells if it found a path
+ */
+static uint32_t path_run_search(PathSearch *search, uint32_t max_expand_count)
+{
+	uint32_t is_done = 0U;
+	uint32_t expand_count = 0;
+
+	while (search->open.count > 0 && !is_done && expand_count < max_expand_count) {
+		uint32_t key = path_heap_pop(&search->open).key;
+
+		if (key == PATH_KEY_GOAL) {
+			is_done = 1U;
+		} else if (!path_is_node_closed(search, key)) {
+			path_expand_node(search, key);
+			++expand_count;
+		}
+	}
+
+	uint32_t result = is_done || search->open.count == 0;
+
+	return result;
+}
+
+/**
+ * @brief Path between two tiles of a level. A* runs over the openings between the chunks and the legs inside every
+ * chunk are refined with Jump Point Search
+ *
+ * @param game
+ * @param thread The search runs on one of its scratch arenas
+ * @param arena Where the waypoints are pushed, nothing else is left on it
+ * @param start
+ * @param goal
+ * @return PathResult Jump points from the start, excluded, to the goal, none when there is no path
+ */
+static PathResult path_find(Game *game, ThreadContext *thread, Arena *arena, Position start, Position goal)
+{
+	PathResult result = {};
+	Map *map = game->world->map;
+	ArenaTemp scratch = thread_begin_scratch(thread, arena);
+	PathSearch *search = ARENA_PUSH_STRUCT(scratch.arena, PathSearch);
+
+	search->map = map;
+	search->graph_arena = &game->arena;
+	search->jump_search = ARENA_PUSH_STRUCT(scratch.arena, PathJumpSearch);
+	search->open = (PathHeap){
+		.entries = ARENA_PUSH_ARRAY(scratch.arena, PathHeapEntry, PATH_MAX_OPEN),
+		.count = 0,
+		.capacity = PATH_MAX_OPEN,
+	};
+	search->chunk_state_idxs = ARENA_PUSH_ARRAY_ZERO(scratch.arena, uint16_t, MAP_SIZE_CHK);
+	search->node_states = ARENA_PUSH_ARRAY(scratch.arena, PathNodeStates, MAP_SIZE_XY_CHK);
+	search->node_state_count = 0;
+
+	ChunkPosition start_cpos = map_get_chunk_pos(start.tile_x, start.tile_y, start.tile_z);
+	ChunkPosition goal_cpos = map_get_chunk_pos(goal.tile_x, goal.tile_y, goal.tile_z);
+	TileChunk *start_chunk = map_get_chunk(map, start_cpos.chunk_x, start_cpos.chunk_y, start_cpos.chunk_z);
+	TileChunk *goal_chunk = map_get_chunk(map, goal_cpos.chunk_x, goal_cpos.chunk_y, goal_cpos.chunk_z);
+	uint32_t start_chunk_idx = (uint32_t)(start_chunk - map->chunks);
+	uint32_t start_idx = (uint32_t)(start_cpos.tile_y * CHUNK_SIDE_TL + start_cpos.tile_x);
+	uint32_t goal_chunk_idx = (uint32_t)(goal_chunk - map->chunks);
+	uint32_t goal_idx = (uint32_t)(goal_cpos.tile_y * CHUNK_SIDE_TL + goal_cpos.tile_x);
+
+	search->goal_cost = PATH_TILE_NONE;
+	search->goal_parent_key = PATH_KEY_START;
+
+	PathChunk *start_path = path_get_chunk(map, search->graph_arena, search->jump_search, start_chunk_idx);
+	PathChunk *goal_path = path_get_chunk(map, search->graph_arena, search->jump_search, goal_chunk_idx);
+	PathGrid start_grid = path_load_grid(start_chunk);
+	PathGrid goal_grid = path_load_grid(goal_chunk);
+
+	if (start.tile_z == goal.tile_z && start_chunk_idx == goal_chunk_idx) {
+		search->goal_cost = path_jump_search(&start_grid, search->jump_search, start_idx, goal_idx);
+	}
 
-					if (wall_test(max_corner.x, rel_pos.x, rel_pos.y, displacement_m.x,
-					              displacement_m.y, &max_time, min_corner.y, max_corner.y)) {
-						wall_normal = (Vtwo){ .x = 1.0F, .y = 0.0F };
-						hit_entity_idx = entity_idx;
-					}
+	// Note(fredy): a path inside a single chunk is taken as it is, the rest go through the openings
+	if (start.tile_z == goal.tile_z && search->goal_cost == PATH_TILE_NONE) {
+		uint32_t start_node_costs[PATH_MAX_CHUNK_NODES];
+		uint32_t goal_node_costs[PATH_MAX_CHUNK_NODES];
 
-					if (wall_test(min_corner.y, rel_pos.y, rel_pos.x, displacement_m.y,
-					              displacement_m.x, &max_time, min_corner.x, max_corner.x)) {
-						wall_normal = (Vtwo){ .x = 0.0F, .y = -1.0F };
-						hit_entity_idx = entity_idx;
-					}
+		path_flood_chunk(&start_grid, search->jump_search, start_idx);
 
-					if (wall_test(max_corner.y, rel_pos.y, rel_pos.x, displacement_m.y,
-					              displacement_m.x, &max_time, min_corner.x, max_corner.x)) {
-						wall_normal = (Vtwo){ .x = 0.0F, .y = 1.0F };
-						hit_entity_idx = entity_idx;
-					}
-				}
-			}
+		for (uint32_t node_idx = 0; node_idx < start_path->node_count; ++node_idx) {
+			start_node_costs[node_idx] = search->jump_search->costs[start_path->node_tile_idxs[node_idx]];
 		}
 
-		entity.high->pos_m = vtwo_add(entity.high->pos_m, vtwo_scale(displacement_m, max_time));
-
-		if (hit_entity_idx) {
-			float speed_on_r_axis = vtwo_dot(entity.high->vel_mps, wall_normal);
-			Vtwo velocity_towards_r_axis = vtwo_scale(wall_normal, speed_on_r_axis);
-			entity.high->vel_mps = vtwo_sub(entity.high->vel_mps, velocity_towards_r_axis);
+		path_flood_chunk(&goal_grid, search->jump_search, goal_idx);
 
-			float displacement_on_r_axis = vtwo_dot(displacement_m, wall_normal);
-			Vtwo displacement_towards_r_axis = vtwo_scale(wall_normal, displacement_on_r_axis);
-			displacement_m = vtwo_sub(displacement_m, displacement_towards_r_axis);
+		for (uint32_t node_idx = 0; node_idx < goal_path->node_count; ++node_idx) {
+			goal_node_costs[node_idx] = search->jump_search->costs[goal_path->node_tile_idxs[node_idx]];
+		}
 
-			remaining_time -= max_time * remaining_time;
+		// Note(fredy): a goal in a pocket would make the search go through all the map the start reaches, a
+		// short search from the goal runs out of nodes first. The steps go both ways so it is the same graph
+		path_begin_search(search, goal_chunk_idx, goal_node_costs, start_chunk_idx, start, start_node_costs);
+		uint32_t is_pocket = path_run_search(search, PATH_MAX_POCKET_EXPAND);
+		is_pocket = is_pocket && search->goal_cost == PATH_TILE_NONE;
 
-			Entity hit_entity = game_get_entity(game, hit_entity_idx);
-			entity.high->tile_z =
-				(uint32_t)((int32_t)entity.high->tile_z - hit_entity.dormant->delta_tile_z);
-		} else {
-			break;
+		if (!is_pocket) {
+			path_begin_search(search, start_chunk_idx, start_node_costs, goal_chunk_idx, goal,
+			                  goal_node_costs);
+			path_run_search(search, UINT32_MAX);
 		}
 	}
 
-	if (entity.high->vel_mps.x == 0.0F && entity.high->vel_mps.y == 0.0F) {
-		// Do not set
-	} else if (fabsf(entity.high->vel_mps.x) > fabsf(entity.high->vel_mps.y)) {
-		if (entity.high->vel_mps.x > 0.0F) {
-			entity.high->facing = FACING_DIRECTION_RIGHT;
-		} else {
-			entity.high->facing = FACING_DIRECTION_LEFT;
+	if (search->goal_cost != PATH_TILE_NONE) {
+		uint32_t node_count = 0;
+
+		uint32_t goal_parent_key = search->goal_parent_key;
+
+		for (uint32_t key = goal_parent_key; key != PATH_KEY_START; key = path_get_parent_key(search, key)) {
+			++node_count;
 		}
-	} else {
-		if (entity.high->vel_mps.y > 0.0F) {
-			entity.high->facing = FACING_DIRECTION_UP;
-		} else {
-			entity.high->facing = FACING_DIRECTION_DOWN;
+
+		uint32_t *node_keys = ARENA_PUSH_ARRAY(scratch.arena, uint32_t, node_count);
+		uint32_t node_key_idx = node_count;
+
+		for (uint32_t key = goal_parent_key; key != PATH_KEY_START; key = path_get_parent_key(search, key)) {
+			node_keys[--node_key_idx] = key;
 		}
-	}
 
-	entity.dormant->pos = game->camera_position;
-	entity.dormant->pos.offset_m = entity.high->pos_m;
-	map_normalize_position(&entity.dormant->pos);
-}
+		// Note(fredy): the waypoints are the only pushes on the arena, they lie next to each other
+		Position last = { .tile_x = start.tile_x, .tile_y = start.tile_y, .tile_z = start.tile_z };
+		uint32_t last_chunk_idx = start_chunk_idx;
+		uint32_t last_idx = start_idx;
+		result.waypoints = ARENA_PUSH_ARRAY(arena, Position, 0);
 
-static uint32_t game_add_entity(Game *game, EntityType type)
-{
-	assert(game->entity_count < MAX_ENTITIES);
+		for (node_key_idx = 0; node_key_idx < node_count; ++node_key_idx) {
+			uint32_t chunk_idx = node_keys[node_key_idx] / PATH_MAX_CHUNK_NODES;
+			uint32_t node_idx = node_keys[node_key_idx] % PATH_MAX_CHUNK_NODES;
+			uint32_t tile_idx = map->chunks[chunk_idx].path->node_tile_idxs[node_idx];
 
-	uint32_t entity_idx = game->entity_count++;
+			if (chunk_idx == last_chunk_idx) {
+				path_push_chunk_waypoints(arena, &result, &last, map, search->jump_search, chunk_idx,
+				                          last_idx, tile_idx);
+			} else {
+				uint32_t tile_x = 0;
+				uint32_t tile_y = 0;
+				path_get_node_tile(chunk_idx, tile_idx, &tile_x, &tile_y);
+				path_push_waypoint(arena, &result, &last, tile_x, tile_y);
+			}
 
-	game->dormant_entities[entity_idx] = (DormantEntity){ .entity_type = type };
-	game->low_entities[entity_idx] = (LowEntity){};
-	game->high_entities[entity_idx] = (HighEntity){};
+			last_chunk_idx = chunk_idx;
+			last_idx = tile_idx;
+		}
 
-	return entity_idx;
+		path_push_chunk_waypoints(arena, &result, &last, map, search->jump_search, goal_chunk_idx, last_idx,
+		                          goal_idx);
+	}
+
+	arena_end_temp(scratch);
+
+	return result;
 }
 
-static uint32_t game_add_player(Game *game)
-{
-	uint32_t entity_idx = game_add_entity(game, ENTITY_TYPE_HERO);
-	Entity entity = game_get_entity(game, entity_idx);
+// =============================================================================
+// Visibility
+// =============================================================================
 
-	entity.high->facing = FACING_DIRECTION_RIGHT;
+/**
+ * @brief Maps the (column, row) of an octant to a tile delta from the origin, one row per octant
+ */
+static const int32_t visibility_octant_transforms[8][4] = {
+	{ 1, 0, 0, 1 },  { 0, 1, 1, 0 },  { 0, -1, 1, 0 }, { -1, 0, 0, 1 },
+	{ -1, 0, 0, -1 }, { 0, -1, -1, 0 }, { 0, 1, -1, 0 }, { 1, 0, 0, -1 },
+};
 
-	entity.dormant->pos.tile_x = 1;
-	entity.dormant->pos.tile_y = 3;
-	entity.dormant->pos.tile_z = 0;
-	entity.dormant->height_m = 0.5F;
-	entity.dormant->width_m = 1.0F;
-	entity.dormant->collides = 1U;
+static void visibility_mark_tile(Game *game, uint32_t tile_x, uint32_t tile_y)
+{
+	Visibility *visibility = &game->visibility;
+	ChunkPosition cpos = map_get_chunk_pos(tile_x, tile_y, visibility->origin_tile_z);
+	TileChunk *chunk = map_get_chunk(game->world->map, cpos.chunk_x, cpos.chunk_y, cpos.chunk_z);
 
-	game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_HIGH);
+	if (!chunk->visibility) {
+		chunk->visibility = ARENA_PUSH_STRUCT_ZERO(&game->arena, ChunkVisibility);
+	}
 
-	if (game->entity_residences[game->entity_tracked_by_camera_idx] == ENTITY_RESIDENCE_NONEXISTENT) {
-		game->entity_tracked_by_camera_idx = entity_idx;
+	if (!chunk->visibility->is_listed) {
+		assert(visibility->chunk_count < VISIBILITY_MAX_CHUNKS);
+
+		chunk->visibility->is_listed = 1U;
+		visibility->chunks[visibility->chunk_count++] = chunk->visibility;
 	}
 
-	return entity_idx;
+	chunk->visibility->rows[cpos.tile_y] |= (uint16_t)(1U << cpos.tile_x);
 }
 
-static uint32_t game_add_wall(Game *game, uint32_t tile_x, uint32_t tile_y, uint32_t tile_z)
+/**
+ * @brief Recursive shadowcasting over one octant. The rows go away from the origin and the columns of a row go from
+ * the start slope to the end slope, the walls seen start a new scan of the next rows with a narrower span
+ *
+ * @param game
+ * @param first_row_idx First row to scan, the origin is row 0
+ * @param start_slope Slope of the first column that is not in shadow
+ * @param end_slope Slope of the last column that is not in shadow
+ * @param transform Row of visibility_octant_transforms of the octant
+ */
+static void visibility_cast_octant(Game *game, uint32_t first_row_idx, float start_slope, float end_slope,
+                                   const int32_t *transform)
 {
-	uint32_t entity_idx = game_add_entity(game, ENTITY_TYPE_WALL);
-	game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_DORMANT);
-	Entity entity = game_get_entity(game, entity_idx);
-
-	entity.dormant->pos.tile_x = tile_x;
-	entity.dormant->pos.tile_y = tile_y;
-	entity.dormant->pos.tile_z = tile_z;
-
-	entity.dormant->height_m = TILE_SIDE_M;
-	entity.dormant->width_m = TILE_SIDE_M;
-	entity.dormant->collides = 1U;
+	Visibility *visibility = &game->visibility;
+	Map *map = game->world->map;
+	uint32_t tile_z = visibility->origin_tile_z;
+	uint32_t is_blocked = 0U;
+	float next_start_slope = start_slope;
+
+	for (uint32_t row_idx = first_row_idx;
+	     start_slope >= end_slope && row_idx <= VISIBILITY_RADIUS_TL && !is_blocked; ++row_idx) {
+		int32_t row = -(int32_t)row_idx;
+
+		for (int32_t column = row; column <= 0; ++column) {
+			float left_slope = ((float)column - 0.5F) / ((float)row + 0.5F);
+			float right_slope = ((float)column + 0.5F) / ((float)row - 0.5F);
+
+			// Note(fredy): the left slopes only decrease along a row, the rest of the row is past the end
+			if (end_slope > left_slope) {
+				break;
+			}
 
-	return entity_idx;
+			if (start_slope >= right_slope) {
+				uint32_t tile_x = visibility->origin_tile_x +
+				                  (uint32_t)(column * transform[0] + row * transform[1]);
+				uint32_t tile_y = visibility->origin_tile_y +
+				                  (uint32_t)(column * transform[2] + row * transform[3]);
+				uint32_t is_wall = !map_is_tile_walkable(map, tile_x, tile_y, tile_z);
+
+				visibility_mark_tile(game, tile_x, tile_y);
+
+				if (is_blocked && is_wall) {
+					next_start_slope = right_slope;
+				} else if (is_blocked) {
+					is_blocked = 0U;
+					start_slope = next_start_slope;
+				} else if (is_wall && row_idx < VISIBILITY_RADIUS_TL) {
+					is_blocked = 1U;
+					visibility_cast_octant(game, row_idx + 1, start_slope, left_slope, transform);
+					next_start_slope = right_slope;
+				}
+			}
+		}
+	}
 }
 
-static Vtwo game_set_camera(Game *game, Position new_camera_pos)
+static inline uint32_t visibility_is_tile_visible(Map *map, uint32_t tile_x, uint32_t tile_y, uint32_t tile_z)
 {
-	PositionDelta camera_delta = position_substract(&game->camera_position, &new_camera_pos);
-	Vtwo frame_entity_delta = camera_delta.delta_xy_m;
-	game->camera_position = new_camera_pos;
+	ChunkPosition cpos = map_get_chunk_pos(tile_x, tile_y, tile_z);
+	TileChunk *chunk = map_get_chunk(map, cpos.chunk_x, cpos.chunk_y, cpos.chunk_z);
+	uint32_t is_visible = 0U;
 
-	uint32_t tile_span_x = 17 * 3;
-	uint32_t tile_span_y = 9 * 3;
-	Vtwo bounds_dim_m = vtwo_scale((Vtwo){ .x = (float)tile_span_x, .y = (float)tile_span_y }, TILE_SIDE_M);
-	AppRect bounds_m = rectangle((Vtwo){ .x = 0.0F, .y = 0.0F }, bounds_dim_m);
+	if (chunk->visibility) {
+		is_visible = (chunk->visibility->rows[cpos.tile_y] >> cpos.tile_x) & 1U;
+	}
 
-	for (uint32_t entity_idx = 1; entity_idx < game->entity_count; ++entity_idx) {
-		if (game->entity_residences[entity_idx] == ENTITY_RESIDENCE_HIGH) {
-			HighEntity *high = game->high_entities + entity_idx;
-			high->pos_m = vtwo_add(high->pos_m, frame_entity_delta);
+	return is_visible;
+}
 
-			if (!rectangle_contains(bounds_m, high->pos_m)) {
-				game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_DORMANT);
-			}
+/**
+ * @brief Computes again the tiles seen by the entity tracked by the camera when it steps on another tile, the bits
+ * of the last computation are cleared first
+ */
+static void game_update_visibility(Game *game)
+{
+	uint32_t origin_idx = game->entity_tracked_by_camera_idx;
+	Position origin = game->entity_positions[origin_idx];
+	Visibility *visibility = &game->visibility;
+
+	if (game->entity_residences[origin_idx] != ENTITY_RESIDENCE_NONEXISTENT &&
+	    (!visibility->is_valid || origin.tile_x != visibility->origin_tile_x ||
+	     origin.tile_y != visibility->origin_tile_y || origin.tile_z != visibility->origin_tile_z)) {
+		for (uint32_t chunk_idx = 0; chunk_idx < visibility->chunk_count; ++chunk_idx) {
+			memset(visibility->chunks[chunk_idx], 0, sizeof(*visibility->chunks[chunk_idx]));
 		}
-	}
 
-	uint32_t min_tile_x = new_camera_pos.tile_x - tile_span_x / 2;
-	uint32_t max_tile_x = new_camera_pos.tile_x + tile_span_x / 2;
-	uint32_t min_tile_y = new_camera_pos.tile_y - tile_span_y / 2;
-	uint32_t max_tile_y = new_camera_pos.tile_y + tile_span_y / 2;
-	for (uint32_t entity_idx = 1; entity_idx < game->entity_count; ++entity_idx) {
-		if (game->entity_residences[entity_idx] == ENTITY_RESIDENCE_DORMANT) {
-			DormantEntity *dormant = game->dormant_entities + entity_idx;
+		visibility->chunk_count = 0;
+		visibility->origin_tile_x = origin.tile_x;
+		visibility->origin_tile_y = origin.tile_y;
+		visibility->origin_tile_z = origin.tile_z;
 
-			if (dormant->pos.tile_z == new_camera_pos.tile_z && dormant->pos.tile_x >= min_tile_x &&
-			    dormant->pos.tile_x <= max_tile_x && dormant->pos.tile_y >= min_tile_y &&
-			    dormant->pos.tile_y <= max_tile_y) {
-				game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_HIGH);
-			}
+		visibility_mark_tile(game, origin.tile_x, origin.tile_y);
+		for (uint32_t octant_idx = 0; octant_idx < 8; ++octant_idx) {
+			visibility_cast_octant(game, 1, 1.0F, 0.0F, visibility_octant_transforms[octant_idx]);
 		}
-	}
 
-	return frame_entity_delta;
+		visibility->is_valid = 1U;
+	}
 }
 
 // =============================================================================
@@ -1010,6 +4232,215 @@ static void sound_output_samples(GameSoundBuffer *buffer, Game *game, unsigned t
 // Game API
 // =============================================================================
 
+/**
+ * @brief Advances the simulation one fixed step
+ *
+ * @param game
+ * @param storage
+ * @param thread
+ * @param input The input of the frame, every step of the frame sees the same input
+ * @param frame_arena
+ * @param time_delta_s Simulation step in seconds
+ */
+static void game_update_sim_step(Game *game, Storage *storage, ThreadContext *thread, GameInput *input,
+                                 Arena *frame_arena, float time_delta_s)
+{
+	Vtwo accelerations[MAX_CONTROLLERS] = {};
+	uint32_t are_jumping[MAX_CONTROLLERS] = {};
+
+	for (uint32_t controller_idx = 0; controller_idx < MAX_CONTROLLERS; ++controller_idx) {
+		Controller *controller = input_get_controller(input, controller_idx);
+		uint32_t entity_idx = game->player_idx_for_controller[controller_idx];
+		EntityResidence residence = game->entity_residences[entity_idx];
+
+		if (controller->is_connected && residence != ENTITY_RESIDENCE_NONEXISTENT) {
+			Vtwo entity_acceleration = {};
+
+			if (controller->is_analog) {
+				entity_acceleration.x = controller->stick_avg_x;
+				entity_acceleration.y = controller->stick_avg_y;
+
+			} else {
+				if (controller->moveright.ended_down) {
+					entity_acceleration.x = 1.0F;
+				}
+
+				if (controller->moveup.ended_down) {
+					entity_acceleration.y = 1.0F;
+				}
+
+				if (controller->moveleft.ended_down) {
+					entity_acceleration.x = -1.0F;
+				}
+
+				if (controller->movedown.ended_down) {
+					entity_acceleration.y = -1.0F;
+				}
+
+				are_jumping[controller_idx] = controller->actionup.ended_down;
+			}
+
+			accelerations[controller_idx] = entity_acceleration;
+
+			// Note(fredy): the controlled entities are simulated even if the camera left them behind
+			if (residence != ENTITY_RESIDENCE_HIGH) {
+				game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_HIGH);
+			}
+
+			// Note(fredy): the input wakes the entity up before the region is gathered, so it is simulated
+			if (vtwo_norm_sq(entity_acceleration) > 0.0F || are_jumping[controller_idx]) {
+				game->low_entities[entity_idx].rest_step_count = 0;
+				game_rehash_entity(game, entity_idx);
+			}
+		}
+	}
+
+	SimRegion *region = sim_region_begin(game, frame_arena, game->camera_position, game_get_camera_bounds());
+	SimMove *moves = ARENA_PUSH_ARRAY(frame_arena, SimMove, MAX_CONTROLLERS);
+	uint32_t move_count = 0;
+
+	for (uint32_t controller_idx = 0; controller_idx < MAX_CONTROLLERS; ++controller_idx) {
+		uint32_t sim_idx = sim_region_find(region, game->player_idx_for_controller[controller_idx]);
+
+		if (input_get_controller(input, controller_idx)->is_connected && sim_idx < region->awake_count) {
+			if (are_jumping[controller_idx]) {
+				region->z_speed_mps[sim_idx] = 2.0F;
+			}
+
+			SimMove *move = &moves[move_count++];
+			*move = (SimMove){
+				.acceleration_mpssq = accelerations[controller_idx],
+				.start_pos_m = sim_get_pos(region, sim_idx),
+				.sim_idx = sim_idx,
+				.partition_idx = sim_get_partition(region, sim_idx),
+			};
+		}
+	}
+
+	// Note(fredy): the moves only read the region, so they run along the z integration
+	SimMoveJob move_jobs[SIM_PARTITION_COUNT];
+	for (uint32_t partition_idx = 0; partition_idx < SIM_PARTITION_COUNT; ++partition_idx) {
+		move_jobs[partition_idx] = (SimMoveJob){
+			.game = game,
+			.region = region,
+			.moves = moves,
+			.move_count = move_count,
+			.partition_idx = partition_idx,
+			.time_delta_s = time_delta_s,
+		};
+
+		for (uint32_t move_idx = 0; move_idx < move_count; ++move_idx) {
+			if (moves[move_idx].partition_idx == partition_idx) {
+				game_add_job(storage, thread, sim_move_partition, &move_jobs[partition_idx]);
+				break;
+			}
+		}
+	}
+
+	// Note(fredy): the sleeping entities are on the ground and still, they are not integrated
+	uint32_t z_job_count = (region->awake_count + SIM_Z_BATCH_SIZE - 1) / SIM_Z_BATCH_SIZE;
+	SimIntegrateZJob *z_jobs = ARENA_PUSH_ARRAY(frame_arena, SimIntegrateZJob, z_job_count);
+	for (uint32_t z_job_idx = 0; z_job_idx < z_job_count; ++z_job_idx) {
+		uint32_t first_sim_idx = z_job_idx * SIM_Z_BATCH_SIZE;
+
+		z_jobs[z_job_idx] = (SimIntegrateZJob){
+			.region = region,
+			.first_sim_idx = first_sim_idx,
+			.end_sim_idx = NUMBER_MIN(first_sim_idx + SIM_Z_BATCH_SIZE, region->awake_count),
+			.time_delta_s = time_delta_s,
+		};
+		game_add_job(storage, thread, sim_integrate_z_batch, &z_jobs[z_job_idx]);
+	}
+
+	game_complete_jobs(storage, thread);
+	sim_merge_moves(game, region, moves, move_count, time_delta_s);
+
+	Position new_camera_pos = game->camera_position;
+	uint32_t tracked_sim_idx = sim_region_find(region, game->entity_tracked_by_camera_idx);
+	if (tracked_sim_idx != UINT32_MAX) {
+		Vtwo entity_tracked_pos_m = sim_get_pos(region, tracked_sim_idx);
+
+		new_camera_pos.tile_z = region->tile_z[tracked_sim_idx];
+#if 1
+		if (entity_tracked_pos_m.x > 9.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_x += 17;
+		}
+
+		if (entity_tracked_pos_m.x < -9.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_x -= 17;
+		}
+
+		if (entity_tracked_pos_m.y > 5.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_y += 9;
+		}
+
+		if (entity_tracked_pos_m.y < -5.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_y -= 9;
+		}
+#else
+		if (entity_tracked_pos_m.x > 1.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_x += 1;
+		}
+
+		if (entity_tracked_pos_m.x < -1.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_x -= 1;
+		}
+
+		if (entity_tracked_pos_m.y > 1.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_y += 1;
+		}
+
+		if (entity_tracked_pos_m.y < -1.0F * TILE_SIDE_M) {
+			new_camera_pos.tile_y -= 1;
+		}
+#endif
+	}
+
+	sim_region_end(game, region);
+	game_set_camera(game, new_camera_pos);
+
+	// Note(fredy): the camera only looks at the chunks on the edges of its spans, the movers update themselves
+	for (uint32_t sim_idx = 0; sim_idx < region->awake_count; ++sim_idx) {
+		game_update_entity_residence(game, region->entity_idxs[sim_idx]);
+	}
+
+	low_tick_entities(game, time_delta_s);
+	game_update_flow_field(game, frame_arena);
+}
+
+/**
+ * @brief Checksum of the simulated state of the game, two runs that diverge get different checksums.
+ * The entities and the map keep their part of the checksum up to date, only the few globals are hashed here.
+ */
+static uint64_t game_get_checksum(const Game *game)
+{
+#if DEBUG
+	uint64_t entities_checksum = 0;
+	for (uint32_t entity_idx = 0; entity_idx < game->entity_count; ++entity_idx) {
+		entities_checksum ^= game_hash_entity(game, entity_idx);
+	}
+
+	assert(entities_checksum == game->entities_checksum && "An entity changed without being rehashed");
+#endif
+
+	uint64_t result = hash_mix(game->entities_checksum, game->world->map->checksum);
+	result = hash_mix(result, game->entity_count);
+	result = hash_mix(result, game->entity_tracked_by_camera_idx);
+	result = hash_mix(result, game->camera_position.tile_x);
+	result = hash_mix(result, game->camera_position.tile_y);
+	result = hash_mix(result, game->camera_position.tile_z);
+	result = hash_mix_float(result, game->camera_position.offset_m.x);
+	result = hash_mix_float(result, game->camera_position.offset_m.y);
+	result = hash_mix_float(result, game->sim_accumulator_s);
+	result = hash_mix(result, game->low_tick_cursor);
+
+	for (uint32_t controller_idx = 0; controller_idx < MAX_CONTROLLERS; ++controller_idx) {
+		result = hash_mix(result, game->player_idx_for_controller[controller_idx]);
+	}
+
+	return result;
+}
+
 static const Vtwo g_screen_offset = {
 	.x = -(float)TILE_RADIUS_PX,
 	.y = -(float)TILE_RADIUS_PX,
@@ -1019,12 +4450,24 @@ GAME_UPDATE_AND_RENDER(game_update_and_render)
 {
 	assert(sizeof(Game) <= storage->permanent_size_byte);
 
+	// Note(fredy): the game is at the start of the permanent storage, over reserved storage it is committed first
+	if (!storage->is_initialized && storage->plat_memory_commit) {
+		uint32_t was_committed = storage->plat_memory_commit(storage->permanent_base_address, sizeof(Game));
+
+		assert(was_committed);
+		(void)was_committed;
+	}
+
 	Game *game = (Game *)storage->permanent_base_address;
 	Arena *arena = &game->arena;
 	World *world = game->world;
 	Map *map = nullptr;
+	Arena *frame_arena = &game->frame_arena;
 
 	if (!storage->is_initialized) {
+		arena_init_reserved(frame_arena, storage->transient_size_byte, storage->transient_base_address,
+		                    storage->plat_memory_commit, storage->plat_memory_decommit);
+
 		// Reserve entity slot 0 for the null entity
 		uint32_t entity_idx = game_add_entity(game, ENTITY_TYPE_NULL);
 		game_set_entity_residence(game, entity_idx, ENTITY_RESIDENCE_NONEXISTENT);
@@ -1075,27 +4518,36 @@ GAME_UPDATE_AND_RENDER(game_update_and_render)
 		bitmaps->align_y_px = 182;
 		++bitmaps;
 
-		arena_init(&game->arena, storage->permanent_size_byte - sizeof(Game),
-		           (unsigned char *)storage->permanent_base_address + sizeof(Game));
+		// Note(fredy): the permanent storage comes zeroed from the platform, the zeroing pushes do not clear it
+		arena_init_reserved(&game->arena, storage->permanent_size_byte - sizeof(Game),
+		                    (unsigned char *)storage->permanent_base_address + sizeof(Game),
+		                    storage->plat_memory_commit, storage->plat_memory_decommit);
 
-		game->world = arena_push(&game->arena, sizeof(*game->world));
+		// Note(fredy): the permanent storage only holds the map for now, its chunks and what is built for them
+		arena_set_tag(&game->arena, ARENA_TAG_MAP);
+
+		game->world = ARENA_PUSH_STRUCT_ZERO(&game->arena, World);
 		world = game->world;
 
-		world->map = arena_push(&game->arena, sizeof(*map));
+		world->map = ARENA_PUSH_STRUCT_ZERO(&game->arena, Map);
 		map = world->map;
 		arena = &game->arena;
 
-		map->chunks = ARENA_PUSH_ARRAY(arena, TileChunk, (size_t)MAP_SIZE_CHK);
+		map->chunks = ARENA_PUSH_ARRAY_ZERO(arena, TileChunk, (size_t)MAP_SIZE_CHK);
+		POOL_INIT_ARRAY(&map->tile_pool, arena, uint32_t, (size_t)CHUNK_SIZE_TL);
+
+		// Note(fredy): the camera is placed first, so the entities take their residence as they are added
+		Position camera_pos = {
+			.tile_x = WORLD_ORIGIN_X_TL + 17 / 2,
+			.tile_y = WORLD_ORIGIN_Y_TL + 9 / 2,
+			.tile_z = 0,
+		};
+		game_set_camera(game, camera_pos);
 
 		uint32_t tiles_per_width = 17;
 		uint32_t tiles_per_height = 9;
-#if 0
-		uint32_t screen_x = UINT32_MAX / 2;
-		uint32_t screen_y = UINT32_MAX / 2;
-#else
 		uint32_t screen_x = 0;
 		uint32_t screen_y = 0;
-#endif
 		uint32_t random_choice = 0;
 		uint32_t options = 3;
 		uint32_t random_num_idx = 0;
@@ -1633,8 +5085,10 @@ GAME_UPDATE_AND_RENDER(game_update_and_render)
 
 			for (uint32_t chunk_tile_y = 0; chunk_tile_y < tiles_per_height; ++chunk_tile_y) {
 				for (uint32_t chunk_tile_x = 0; chunk_tile_x < tiles_per_width; ++chunk_tile_x) {
-					uint32_t tile_x = screen_x * tiles_per_width + chunk_tile_x;
-					uint32_t tile_y = screen_y * tiles_per_height + chunk_tile_y;
+					uint32_t tile_x =
+						WORLD_ORIGIN_X_TL + screen_x * tiles_per_width + chunk_tile_x;
+					uint32_t tile_y =
+						WORLD_ORIGIN_Y_TL + screen_y * tiles_per_height + chunk_tile_y;
 
 					uint32_t tile_type = TILE_TYPE_EMPTY;
 					if (chunk_tile_x == 0 &&
@@ -1665,7 +5119,7 @@ GAME_UPDATE_AND_RENDER(game_update_and_render)
 						tile_type = TILE_TYPE_STAIRS_DOWN;
 					}
 
-					map_set_tile_value(map, &game->arena, tile_x, tile_y, tile_z, tile_type);
+					map_set_tile_value(map, tile_x, tile_y, tile_z, tile_type);
 
 					if (tile_type == TILE_TYPE_WALL) {
 						game_add_wall(game, tile_x, tile_y, tile_z);
@@ -1698,297 +5152,255 @@ GAME_UPDATE_AND_RENDER(game_update_and_render)
 			is_top_door = 0U;
 		}
 
-		Position camera_pos = {
-			.tile_x = 17 / 2,
-			.tile_y = 9 / 2,
-			.tile_z = 0,
-		};
-		game_set_camera(game, camera_pos);
-
 		storage->is_initialized = 1U;
 	}
 
 	map = world->map;
-	for (uint32_t controller_idx = 0; controller_idx < MAX_CONTROLLERS; ++controller_idx) {
-		Controller *controller = input_get_controller(input, controller_idx);
-
-		if (controller->is_connected) {
-			Entity controlled_entity =
-				game_get_entity(game, game->player_idx_for_controller[controller_idx]);
-
-			if (controlled_entity.residence != ENTITY_RESIDENCE_NONEXISTENT) {
-				Vtwo entity_acceleration = {};
-
-				if (controller->is_analog) {
-					entity_acceleration.x = controller->stick_avg_x;
-					entity_acceleration.y = controller->stick_avg_y;
-
-				} else {
-					if (controller->moveright.ended_down) {
-						entity_acceleration.x = 1.0F;
-					}
-
-					if (controller->moveup.ended_down) {
-						entity_acceleration.y = 1.0F;
-					}
-
-					if (controller->moveleft.ended_down) {
-						entity_acceleration.x = -1.0F;
-					}
-
-					if (controller->movedown.ended_down) {
-						entity_acceleration.y = -1.0F;
-					}
 
-					if (controller->actionup.ended_down) {
-						controlled_entity.high->z_speed_mps = 2.0F;
-					}
-				}
+	// Note(fredy): the frame arena starts empty every frame, nothing pushed on it lives longer than the frame. The
+	// pages committed by frames that needed more than usual are given back once the frames are small for a while,
+	// so a game that always needs more does not commit and decommit them every frame
+	if (frame_arena->peak_bytes > FRAME_ARENA_KEEP_BYTES) {
+		game->frame_arena_small_frame_count = 0;
+	} else if (game->frame_arena_small_frame_count < FRAME_ARENA_DECOMMIT_FRAMES) {
+		++game->frame_arena_small_frame_count;
+	}
 
-				game_move_entity(game, controlled_entity, entity_acceleration, input->time_delta_s);
-			} else {
-				if (controller->start.ended_down) {
-					uint32_t entity_idx = game_add_player(game);
-					game->player_idx_for_controller[controller_idx] = entity_idx;
-				}
-			}
+	arena_reset(frame_arena);
+	if (game->frame_arena_small_frame_count == FRAME_ARENA_DECOMMIT_FRAMES) {
+		arena_decommit(frame_arena, FRAME_ARENA_KEEP_BYTES);
+	}
 
-			Entity entity_tracked = game_get_entity(game, game->entity_tracked_by_camera_idx);
-			Vtwo frame_entity_delta = {};
-			if (entity_tracked.residence != ENTITY_RESIDENCE_NONEXISTENT) {
-				Position new_camera_pos = game->camera_position;
+	arena_set_tag(frame_arena, ARENA_TAG_ENTITIES);
 
-				new_camera_pos.tile_z = entity_tracked.dormant->pos.tile_z;
-#if 1
-				if (entity_tracked.high->pos_m.x > 9.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_x += 17;
-				}
+	for (uint32_t controller_idx = 0; controller_idx < MAX_CONTROLLERS; ++controller_idx) {
+		Controller *controller = input_get_controller(input, controller_idx);
+		uint32_t controlled_entity_idx = game->player_idx_for_controller[controller_idx];
 
-				if (entity_tracked.high->pos_m.x < -9.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_x -= 17;
-				}
+		if (controller->is_connected &&
+		    game->entity_residences[controlled_entity_idx] == ENTITY_RESIDENCE_NONEXISTENT &&
+		    controller->start.ended_down) {
+			uint32_t entity_idx = game_add_player(game);
+			game->player_idx_for_controller[controller_idx] = entity_idx;
+		}
+	}
 
-				if (entity_tracked.high->pos_m.y > 5.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_y += 9;
-				}
+	// Note(fredy): a long frame is simulated as many fixed steps, up to a limit so the game can catch up
+	game->sim_accumulator_s += NUMBER_MIN(input->time_delta_s, SIM_MAX_FRAME_TIME_S);
+	while (game->sim_accumulator_s >= SIM_STEP_S) {
+		// Note(fredy): the scratch of a step is released before the next one, a frame that catches up does not
+		// pile them up
+		ArenaTemp step_temp = arena_begin_temp(frame_arena);
+		game_update_sim_step(game, storage, thread, input, frame_arena, SIM_STEP_S);
+		arena_end_temp(step_temp);
 
-				if (entity_tracked.high->pos_m.y < -5.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_y -= 9;
-				}
-#else
-				if (entity_tracked.high->pos_m.x > 1.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_x += 1;
-				}
+		game->sim_accumulator_s -= SIM_STEP_S;
+	}
 
-				if (entity_tracked.high->pos_m.x < -1.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_x -= 1;
-				}
+	// Note(fredy): the platform records the checksum with the input, a replay compares against it frame by frame
+	storage->state_checksum = game_get_checksum(game);
 
-				if (entity_tracked.high->pos_m.y > 1.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_y += 1;
-				}
+	game_update_visibility(game);
 
-				if (entity_tracked.high->pos_m.y < -1.0F * TILE_SIDE_M) {
-					new_camera_pos.tile_y -= 1;
-				}
-#endif
+	// Note(fredy): the entities are rendered between their last two simulated states
+	float sim_alpha = game->sim_accumulator_s / SIM_STEP_S;
 
-				game_set_camera(game, new_camera_pos);
-			}
 
-			// Render the background
+	// Render the background
 #if 1
-			offscreen_render_bitmap(back_buffer, 0, 0, &game->backdrop, 0, 0, 1.0F);
+	offscreen_render_bitmap(back_buffer, 0, 0, &game->backdrop, 0, 0, 1.0F);
 #else
-			offscreen_render_rectangle(back_buffer, 0.0F, 0.0F, (float)back_buffer->width_px,
-			                           (float)back_buffer->height_px, 1.0F, 0.0F, 1.0F);
+	offscreen_render_rectangle(back_buffer, 0.0F, 0.0F, (float)back_buffer->width_px,
+	                           (float)back_buffer->height_px, 1.0F, 0.0F, 1.0F);
 #endif
 
-			Vtwo bitmap_center_px = {
-				.x = (float)back_buffer->width_px * 0.5F,
-				.y = (float)back_buffer->height_px * 0.5F,
-			};
+	Vtwo bitmap_center_px = {
+		.x = (float)back_buffer->width_px * 0.5F,
+		.y = (float)back_buffer->height_px * 0.5F,
+	};
 
 #if 0
-			for (int32_t tile_row_offset = -10; tile_row_offset < 10; ++tile_row_offset) {
-				for (int32_t tile_col_offset = -20; tile_col_offset < 20; ++tile_col_offset) {
-					uint32_t tile_col =
-						(uint32_t)((int32_t)game->camera_position.tile_x + tile_col_offset);
-					uint32_t tile_row =
-						(uint32_t)((int32_t)game->camera_position.tile_y + tile_row_offset);
-					uint32_t level = game->camera_position.tile_z;
-
-					uint32_t tile_type_id = map_get_tile_type(map, tile_col, tile_row, level);
-
-					if (tile_type_id > TILE_TYPE_EMPTY) {
-						float gray = 0.0F; // Walkable
-
-						switch (tile_type_id) {
-						case TILE_TYPE_EMPTY: {
-							gray = 0.5F;
-						} break;
-						case TILE_TYPE_WALL: {
-							gray = 1.0F;
-						} break;
-						case TILE_TYPE_STAIRS_UP:
-						case TILE_TYPE_STAIRS_DOWN: {
-							gray = 0.25F;
-						} break;
-						default: {
-							assert(0 && "Invalid tile type");
-						} break;
-						}
+	for (int32_t tile_row_offset = -10; tile_row_offset < 10; ++tile_row_offset) {
+		for (int32_t tile_col_offset = -20; tile_col_offset < 20; ++tile_col_offset) {
+			uint32_t tile_col =
+				(uint32_t)((int32_t)game->camera_position.tile_x + tile_col_offset);
+			uint32_t tile_row =
+				(uint32_t)((int32_t)game->camera_position.tile_y + tile_row_offset);
+			uint32_t level = game->camera_position.tile_z;
+
+			uint32_t tile_type_id = map_get_tile_type(map, tile_col, tile_row, level);
+			uint32_t is_visible = !game->visibility.is_valid ||
+			                      visibility_is_tile_visible(map, tile_col, tile_row, level);
+
+			if (tile_type_id > TILE_TYPE_EMPTY && is_visible) {
+				float gray = 0.0F; // Walkable
+
+				switch (tile_type_id) {
+				case TILE_TYPE_EMPTY: {
+					gray = 0.5F;
+				} break;
+				case TILE_TYPE_WALL: {
+					gray = 1.0F;
+				} break;
+				case TILE_TYPE_STAIRS_UP:
+				case TILE_TYPE_STAIRS_DOWN: {
+					gray = 0.25F;
+				} break;
+				default: {
+					assert(0 && "Invalid tile type");
+				} break;
+				}
 
-						Vtwo grid_offset = {
-							.x = (float)tile_col_offset * (float)TILE_SIDE_PX,
-							.y = (float)tile_row_offset * (float)TILE_SIDE_PX,
-						};
-						grid_offset = vtwo_flip_y(grid_offset);
-						Vtwo camera_tile_offset =
-							vtwo_scale(game->camera_position.offset_m, PIXELS_PER_METER);
-						camera_tile_offset = vtwo_flip_y(camera_tile_offset);
+				Vtwo grid_offset = {
+					.x = (float)tile_col_offset * (float)TILE_SIDE_PX,
+					.y = (float)tile_row_offset * (float)TILE_SIDE_PX,
+				};
+				grid_offset = vtwo_flip_y(grid_offset);
+				Vtwo camera_tile_offset =
+					vtwo_scale(game->camera_position.offset_m, PIXELS_PER_METER);
+				camera_tile_offset = vtwo_flip_y(camera_tile_offset);
 
-						Vtwo min_point = vtwo_add(bitmap_center_px, grid_offset);
-						min_point = vtwo_add(min_point, g_screen_offset);
-						min_point = vtwo_add(min_point, camera_tile_offset);
+				Vtwo min_point = vtwo_add(bitmap_center_px, grid_offset);
+				min_point = vtwo_add(min_point, g_screen_offset);
+				min_point = vtwo_add(min_point, camera_tile_offset);
 
-						Vtwo max_point = vtwo_add_scalar(min_point, (float)TILE_SIDE_PX);
+				Vtwo max_point = vtwo_add_scalar(min_point, (float)TILE_SIDE_PX);
 
-						if (game->camera_position.tile_y == tile_row &&
-						    game->camera_position.tile_x == tile_col) {
-							gray = 0.0F;
-						}
-						// Render the current tile
-						offscreen_render_rectangle(back_buffer, min_point, max_point, gray,
-						                           gray, gray);
-					}
+				if (game->camera_position.tile_y == tile_row &&
+				    game->camera_position.tile_x == tile_col) {
+					gray = 0.0F;
 				}
+				// Render the current tile
+				offscreen_render_rectangle(back_buffer, min_point, max_point, gray,
+				                           gray, gray);
 			}
+		}
+	}
 #endif
 
-			for (uint32_t entity_idx = 0; entity_idx < game->entity_count; ++entity_idx) {
-				EntityResidence residence = game->entity_residences[entity_idx];
-
-				if (residence == ENTITY_RESIDENCE_HIGH) {
-					HighEntity *high_entity = &game->high_entities[entity_idx];
-					// LowEntity *low_entity = &game->low_entities[entity_idx];
-					DormantEntity *dormant_entity = &game->dormant_entities[entity_idx];
-
-					high_entity->pos_m = vtwo_add(high_entity->pos_m, frame_entity_delta);
-
-					float time_delta_s_sq = float_square(input->time_delta_s);
-					float z_acceleration_mpssq = -9.8F;
+	uint32_t camera_level = game_get_level(game->camera_position.tile_z);
+	EntityList *high_list = &game->residence_lists[camera_level][ENTITY_RESIDENCE_HIGH];
 
-					// Kinematic equation: 1/2*a*t^2
-					float z_acceleration_displacement_m =
-						0.5F * z_acceleration_mpssq * time_delta_s_sq;
+	arena_set_tag(frame_arena, ARENA_TAG_RENDER);
 
-					// Kinematic equation: v*t
-					float z_speed_displacement_m = high_entity->z_speed_mps * input->time_delta_s;
+	// Note(fredy): the entities on tiles that the tracked entity does not see are culled before rendering anything
+	uint32_t *visible_entity_idxs = ARENA_PUSH_ARRAY(frame_arena, uint32_t, high_list->count);
+	uint32_t visible_entity_count = 0;
+	for (uint32_t high_idx = 0; high_idx < high_list->count; ++high_idx) {
+		uint32_t entity_idx = high_list->entity_idxs[high_idx];
+		Position *entity_pos = &game->entity_positions[entity_idx];
 
-					// TODO(fredy): fix it -> it is going to high and the rendering is triggering an assertion.
-					// Kinematic equation: p' = 1/2*a'*t^2 + v'*t + p
-					high_entity->z_m = z_acceleration_displacement_m + z_speed_displacement_m +
-					                   high_entity->z_m;
-
-					// Kinematic equation: v' = a*t + v
-					high_entity->z_speed_mps =
-						z_acceleration_mpssq * input->time_delta_s + high_entity->z_speed_mps;
-
-					if (high_entity->z_m < 0.0F) {
-						high_entity->z_m = 0.0F;
-					}
+		if (!game->visibility.is_valid ||
+		    visibility_is_tile_visible(map, entity_pos->tile_x, entity_pos->tile_y, entity_pos->tile_z)) {
+			visible_entity_idxs[visible_entity_count++] = entity_idx;
+		}
+	}
 
-					float z_px = -PIXELS_PER_METER * high_entity->z_m;
-
-					HeroBitmaps *entity_bitmaps = &game->hero_bitmaps[high_entity->facing];
-
-					Vtwo camera_entity_delta_px = vtwo_scale(high_entity->pos_m, PIXELS_PER_METER);
-					// Flipping as screen and world y grow in different directions
-					camera_entity_delta_px = vtwo_flip_y(camera_entity_delta_px);
-					Vtwo entity_ground_point_px =
-						vtwo_add(bitmap_center_px, camera_entity_delta_px);
-
-					if (dormant_entity->entity_type == ENTITY_TYPE_HERO) {
-						uint32_t source_offset_x_px = 0U;
-						uint32_t source_offset_y_px = 0U;
-						uint32_t target_offset_x_px = 0U;
-						uint32_t target_offset_y_px = 0U;
-						uint32_t shadow_target_offset_y_px = 0U;
-						uint32_t shadow_source_offset_y_px = 0U;
-
-						float target_offset_x_px_f =
-							entity_ground_point_px.x - (float)entity_bitmaps->align_x_px;
-						float shadow_target_offset_y_px_f =
-							entity_ground_point_px.y - (float)entity_bitmaps->align_y_px;
-						float target_offset_y_px_f = shadow_target_offset_y_px_f + z_px;
-						float shadow_opacity = NUMBER_MAX(1.0F - 0.5F * high_entity->z_m, 0.0F);
-
-						if (target_offset_x_px_f < 0.0F) {
-							source_offset_x_px = float_round_to_uint(-target_offset_x_px_f);
-						} else {
-							target_offset_x_px = float_round_to_uint(target_offset_x_px_f);
-						}
+	for (uint32_t visible_idx = 0; visible_idx < visible_entity_count; ++visible_idx) {
+		uint32_t entity_idx = visible_entity_idxs[visible_idx];
+
+		LowEntity *low_entity = &game->low_entities[entity_idx];
+		EntityShape *entity_shape = &game->entity_shapes[entity_idx];
+		float entity_z_m = float_lerp(low_entity->prev_z_m, low_entity->z_m, sim_alpha);
+
+		float z_px = -PIXELS_PER_METER * entity_z_m;
+
+		HeroBitmaps *entity_bitmaps = &game->hero_bitmaps[low_entity->facing];
+
+		Vtwo camera_entity_prev_delta_m =
+			position_substract(&low_entity->prev_pos, &game->camera_position).delta_xy_m;
+		Vtwo camera_entity_delta_m =
+			position_substract(&game->entity_positions[entity_idx], &game->camera_position).delta_xy_m;
+		camera_entity_delta_m = vtwo_lerp(camera_entity_prev_delta_m, camera_entity_delta_m, sim_alpha);
+		Vtwo camera_entity_delta_px = vtwo_scale(camera_entity_delta_m, PIXELS_PER_METER);
+		// Flipping as screen and world y grow in different directions
+		camera_entity_delta_px = vtwo_flip_y(camera_entity_delta_px);
+		Vtwo entity_ground_point_px =
+			vtwo_add(bitmap_center_px, camera_entity_delta_px);
+
+		if (game->entity_infos[entity_idx].entity_type == ENTITY_TYPE_HERO) {
+			uint32_t source_offset_x_px = 0U;
+			uint32_t source_offset_y_px = 0U;
+			uint32_t target_offset_x_px = 0U;
+			uint32_t target_offset_y_px = 0U;
+			uint32_t shadow_target_offset_y_px = 0U;
+			uint32_t shadow_source_offset_y_px = 0U;
+
+			float target_offset_x_px_f =
+				entity_ground_point_px.x - (float)entity_bitmaps->align_x_px;
+			float shadow_target_offset_y_px_f =
+				entity_ground_point_px.y - (float)entity_bitmaps->align_y_px;
+			float target_offset_y_px_f = shadow_target_offset_y_px_f + z_px;
+			float shadow_opacity = NUMBER_MAX(1.0F - 0.5F * entity_z_m, 0.0F);
+
+			if (target_offset_x_px_f < 0.0F) {
+				source_offset_x_px = float_round_to_uint(-target_offset_x_px_f);
+			} else {
+				target_offset_x_px = float_round_to_uint(target_offset_x_px_f);
+			}
 
-						if (target_offset_y_px_f < 0.0F) {
-							source_offset_y_px = float_round_to_uint(-target_offset_y_px_f);
-						} else {
-							target_offset_y_px = float_round_to_uint(target_offset_y_px_f);
-						}
+			if (target_offset_y_px_f < 0.0F) {
+				source_offset_y_px = float_round_to_uint(-target_offset_y_px_f);
+			} else {
+				target_offset_y_px = float_round_to_uint(target_offset_y_px_f);
+			}
 
-						if (shadow_target_offset_y_px_f < 0.0F) {
-							shadow_source_offset_y_px =
-								float_round_to_uint(-shadow_target_offset_y_px_f);
-						} else {
-							shadow_target_offset_y_px =
-								float_round_to_uint(shadow_target_offset_y_px_f);
-						}
+			if (shadow_target_offset_y_px_f < 0.0F) {
+				shadow_source_offset_y_px =
+					float_round_to_uint(-shadow_target_offset_y_px_f);
+			} else {
+				shadow_target_offset_y_px =
+					float_round_to_uint(shadow_target_offset_y_px_f);
+			}
 
-						if (source_offset_x_px < entity_bitmaps->torso.width_px &&
-						    source_offset_y_px < entity_bitmaps->torso.height_px) {
-							offscreen_render_bitmap(back_buffer, target_offset_x_px,
-							                        target_offset_y_px,
-							                        &entity_bitmaps->torso,
-							                        source_offset_x_px, source_offset_y_px,
-							                        1.0F);
-							offscreen_render_bitmap(back_buffer, target_offset_x_px,
-							                        target_offset_y_px,
-							                        &entity_bitmaps->cape,
-							                        source_offset_x_px, source_offset_y_px,
-							                        1.0F);
-							offscreen_render_bitmap(back_buffer, target_offset_x_px,
-							                        target_offset_y_px,
-							                        &entity_bitmaps->head,
-							                        source_offset_x_px, source_offset_y_px,
-							                        1.0F);
-						}
+			if (source_offset_x_px < entity_bitmaps->torso.width_px &&
+			    source_offset_y_px < entity_bitmaps->torso.height_px) {
+				offscreen_render_bitmap(back_buffer, target_offset_x_px,
+				                        target_offset_y_px,
+				                        &entity_bitmaps->torso,
+				                        source_offset_x_px, source_offset_y_px,
+				                        1.0F);
+				offscreen_render_bitmap(back_buffer, target_offset_x_px,
+				                        target_offset_y_px,
+				                        &entity_bitmaps->cape,
+				                        source_offset_x_px, source_offset_y_px,
+				                        1.0F);
+				offscreen_render_bitmap(back_buffer, target_offset_x_px,
+				                        target_offset_y_px,
+				                        &entity_bitmaps->head,
+				                        source_offset_x_px, source_offset_y_px,
+				                        1.0F);
+			}
 
-						if (shadow_source_offset_y_px < game->shadow.height_px) {
-							offscreen_render_bitmap(back_buffer, target_offset_x_px,
-							                        shadow_target_offset_y_px,
-							                        &game->shadow, source_offset_x_px,
-							                        shadow_source_offset_y_px,
-							                        shadow_opacity);
-						}
-					} else {
-						float entity_red = 1.0F;
-						float entity_green = 1.0F;
-						float entity_blue = 0.0F;
-
-						Vtwo entity_diagonal_px = {
-							.x = dormant_entity->width_m * PIXELS_PER_METER,
-							.y = dormant_entity->height_m * PIXELS_PER_METER,
-						};
-						Vtwo entity_delta_px = vtwo_scale(entity_diagonal_px, 0.5F);
-						Vtwo entity_min_px = vtwo_sub(entity_ground_point_px, entity_delta_px);
-						Vtwo entity_max_px = vtwo_add(entity_min_px, entity_diagonal_px);
-						offscreen_render_rectangle(back_buffer, entity_min_px, entity_max_px,
-						                           entity_red, entity_green, entity_blue);
-					}
-				}
+			if (source_offset_x_px < game->shadow.width_px &&
+			    shadow_source_offset_y_px < game->shadow.height_px) {
+				offscreen_render_bitmap(back_buffer, target_offset_x_px,
+				                        shadow_target_offset_y_px,
+				                        &game->shadow, source_offset_x_px,
+				                        shadow_source_offset_y_px,
+				                        shadow_opacity);
 			}
+		} else {
+			float entity_red = 1.0F;
+			float entity_green = 1.0F;
+			float entity_blue = 0.0F;
+
+			Vtwo entity_diagonal_px = {
+				.x = entity_shape->width_m * PIXELS_PER_METER,
+				.y = entity_shape->height_m * PIXELS_PER_METER,
+			};
+			Vtwo entity_delta_px = vtwo_scale(entity_diagonal_px, 0.5F);
+			Vtwo entity_min_px = vtwo_sub(entity_ground_point_px, entity_delta_px);
+			Vtwo entity_max_px = vtwo_add(entity_min_px, entity_diagonal_px);
+			offscreen_render_rectangle(back_buffer, entity_min_px, entity_max_px,
+			                           entity_red, entity_green, entity_blue);
 		}
 	}
+
+#if ARENA_INSTRUMENTATION
+	storage->permanent_stats = arena_get_stats(&game->arena);
+	storage->transient_stats = arena_get_stats(frame_arena);
+#endif
 }
 
 SOUND_CREATE_SAMPLES(sound_create_samples)
@@ -1,9 +1,317 @@
-#include "handmade.c"
+/*
+* Linux platform code, it runs the game without a window nor sound. The input is scripted, so two runs of the same
+* build simulate the same frames, which is what a profiler needs
+*/
 
-struct Plat_Window {
-	int handle;
-};
+#define _DEFAULT_SOURCE
 
-void plat_file_load(void)
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Note(fredy): there is no code reloading on Linux, the game is compiled into the executable
+#include "app.c"
+
+#define LINUX_FRAME_COUNT_DEFAULT 600U
+#define LINUX_FRAME_TIME_S (1.0F / 30.0F)
+
+// Note(fredy): every move lasts this many frames, the hero walks around a square
+#define LINUX_INPUT_MOVE_FRAMES 90U
+
+// Note(fredy): only reserved, a scratch arena commits what its thread uses
+#define THREAD_SCRATCH_ARENA_BYTES MB_TO_BYTES(16ULL)
+
+#define MEMORY_HUGE_PAGE_BYTES MB_TO_BYTES(2ULL)
+
+FILE_FREE_DEBUG(file_free_debug)
+{
+	free(base_address);
+}
+
+FILE_READ_DEBUG(file_read_debug)
+{
+	ReadFileResult result = {};
+
+	FILE *file = fopen(path, "rb");
+	if (file) {
+		long file_size_byte = -1;
+		if (fseek(file, 0, SEEK_END) == 0) {
+			file_size_byte = ftell(file);
+		}
+
+		if (file_size_byte > 0 && fseek(file, 0, SEEK_SET) == 0) {
+			size_t size_byte = (size_t)file_size_byte;
+			result.base_address = malloc(size_byte);
+			if (result.base_address) {
+				if (fread(result.base_address, 1, size_byte, file) == size_byte) {
+					result.size_byte = size_byte;
+				} else {
+					LOG_ERROR("failed to read the file: %s", path);
+
+					file_free_debug(result.base_address, thread);
+
+					result.base_address = nullptr;
+				}
+			} else {
+				LOG_ERROR("failed to allocate memory for the content of file: %s", path);
+			}
+		} else {
+			LOG_ERROR("failed to get the size of the file: %s", path);
+		}
+
+		(void)fclose(file);
+	} else {
+		LOG_ERROR("failed to open the file: %s", path);
+	}
+
+	return result;
+}
+
+FILE_WRITE_DEBUG(file_write_debug)
+{
+	uint8_t result = 0U;
+
+	FILE *file = fopen(path, "wb");
+	if (file) {
+		if (fwrite(base_address, 1, memory_size_byte, file) == memory_size_byte) {
+			result = 1U;
+		} else {
+			LOG_ERROR("failed to write to the file: %s", path);
+		}
+
+		(void)fclose(file);
+	} else {
+		LOG_ERROR("failed to open the file: %s", path);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Maps committed memory from the huge page pool, the size is rounded up to a whole number of pages.
+ * The game gets no commit callbacks for it, like the Windows large pages
+ *
+ * @return void* nullptr when the pool does not have enough pages
+ */
+static void *memory_alloc_huge_pages(void *base_address, size_t size_bytes)
+{
+	size_t rounded_size_bytes = (size_bytes + MEMORY_HUGE_PAGE_BYTES - 1) & ~(MEMORY_HUGE_PAGE_BYTES - 1);
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+	void *result = mmap(base_address, rounded_size_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+	return result == MAP_FAILED ? nullptr : result;
+}
+
+/**
+ * @brief Reserves address space for the game memory, nothing is charged to the process until it is committed
+ */
+static void *memory_reserve(void *base_address, size_t size_bytes)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	void *result = mmap(base_address, size_bytes, PROT_NONE, flags, -1, 0);
+	result = result == MAP_FAILED ? nullptr : result;
+
+	// Note(fredy): without a huge page pool the kernel can still back the committed ranges with transparent huge
+	// pages, this is only a hint
+	if (result) {
+		(void)madvise(result, size_bytes, MADV_HUGEPAGE);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Reads back how many bytes of a range the kernel backs with transparent huge pages, madvise does not tell
+ *
+ * @return size_t 0 when the range has none or /proc is not mounted
+ */
+static size_t memory_get_transparent_huge_bytes(void *base_address, size_t size_bytes)
+{
+	size_t result = 0;
+	uintptr_t range_start = (uintptr_t)base_address;
+	uintptr_t range_end = range_start + size_bytes;
+
+	FILE *file = fopen("/proc/self/smaps", "r");
+	if (file) {
+		char line[512];
+		uint32_t is_in_range = 0U;
+
+		// Note(fredy): committing part of the range splits its mapping, every piece reports its own huge pages
+		while (fgets(line, sizeof(line), file)) {
+			unsigned long map_start = 0;
+			unsigned long map_end = 0;
+			size_t huge_kb = 0;
+
+			if (sscanf(line, "%lx-%lx ", &map_start, &map_end) == 2) {
+				is_in_range = map_start >= range_start && map_end <= range_end;
+			} else if (is_in_range && sscanf(line, "AnonHugePages: %zu kB", &huge_kb) == 1) {
+				result += KB_TO_BYTES(huge_kb);
+			}
+		}
+
+		(void)fclose(file);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Widens a range to the pages that hold any of its bytes, like VirtualAlloc does
+ */
+static void memory_get_pages(void *base_address, size_t size_bytes, uintptr_t *start, uintptr_t *end)
 {
+	uintptr_t page_bytes = (uintptr_t)sysconf(_SC_PAGESIZE);
+
+	*start = (uintptr_t)base_address & ~(page_bytes - 1);
+	*end = ((uintptr_t)base_address + size_bytes + page_bytes - 1) & ~(page_bytes - 1);
+}
+
+static ARENA_COMMIT(memory_commit)
+{
+	uintptr_t start = 0;
+	uintptr_t end = 0;
+	memory_get_pages(base_address, size_bytes, &start, &end);
+
+	uint32_t result = mprotect((void *)start, end - start, PROT_READ | PROT_WRITE) == 0;
+
+	return result;
+}
+
+static ARENA_DECOMMIT(memory_decommit)
+{
+	uintptr_t start = 0;
+	uintptr_t end = 0;
+	memory_get_pages(base_address, size_bytes, &start, &end);
+
+	// Note(fredy): the anonymous pages are dropped and read as zero the next time they are committed
+	(void)madvise((void *)start, end - start, MADV_DONTNEED);
+	(void)mprotect((void *)start, end - start, PROT_NONE);
+}
+
+/**
+ * @brief Carves the scratch arenas of the main thread from the end of the transient storage, the game keeps the
+ * rest. There is no work queue, the game runs its jobs on the main thread
+ */
+static void thread_init_scratch(Storage *storage, ThreadContext *main_thread)
+{
+	size_t scratch_bytes = ARENA_COMMIT_BYTES + THREAD_SCRATCH_ARENA_COUNT * THREAD_SCRATCH_ARENA_BYTES;
+
+	assert(scratch_bytes < storage->transient_size_byte);
+
+	storage->transient_size_byte -= scratch_bytes;
+	unsigned char *scratch_base = (unsigned char *)storage->transient_base_address + storage->transient_size_byte;
+
+	Arena header = {};
+	arena_init_reserved(&header, ARENA_COMMIT_BYTES, scratch_base, storage->plat_memory_commit,
+	                    storage->plat_memory_decommit);
+	Arena *arenas = ARENA_PUSH_ARRAY_ZERO(&header, Arena, THREAD_SCRATCH_ARENA_COUNT);
+
+	for (uint32_t scratch_idx = 0; scratch_idx < THREAD_SCRATCH_ARENA_COUNT; ++scratch_idx) {
+		arena_init_reserved(&arenas[scratch_idx], THREAD_SCRATCH_ARENA_BYTES,
+		                    scratch_base + ARENA_COMMIT_BYTES + scratch_idx * THREAD_SCRATCH_ARENA_BYTES,
+		                    storage->plat_memory_commit, storage->plat_memory_decommit);
+		main_thread->scratch_arenas[scratch_idx] = &arenas[scratch_idx];
+	}
+}
+
+/**
+ * @brief Plays the keyboard controller: it joins on the first frame, then walks around a square and jumps from
+ * time to time
+ */
+static void input_script(GameInput *input, uint32_t frame_idx)
+{
+	Controller *controller = input_get_controller(input, 0);
+	Controller zero_controller = {};
+	*controller = zero_controller;
+	controller->is_connected = 1U;
+	controller->start.ended_down = frame_idx == 1;
+
+	uint32_t move_idx = (frame_idx / LINUX_INPUT_MOVE_FRAMES) % 4;
+	controller->moveright.ended_down = move_idx == 0;
+	controller->moveup.ended_down = move_idx == 1;
+	controller->moveleft.ended_down = move_idx == 2;
+	controller->movedown.ended_down = move_idx == 3;
+	controller->actionup.ended_down = frame_idx % 50 == 0;
+
+	input->time_delta_s = LINUX_FRAME_TIME_S;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t frame_count = LINUX_FRAME_COUNT_DEFAULT;
+	if (argc > 1) {
+		frame_count = (uint32_t)strtoul(argv[1], nullptr, 10);
+	}
+
+	Storage storage = {
+		.plat_file_free_debug = file_free_debug,
+		.plat_file_read_debug = file_read_debug,
+		.file_write_debug = file_write_debug,
+	};
+	storage.permanent_size_byte = MB_TO_BYTES(64ULL);
+	storage.transient_size_byte = GB_TO_BYTES(1ULL);
+
+	size_t page_bytes = (size_t)sysconf(_SC_PAGESIZE);
+	size_t memory_size_bytes = storage.permanent_size_byte + storage.transient_size_byte;
+	void *memory_base_address = memory_alloc_huge_pages(MEMORY_BASE_ADDRESS, memory_size_bytes);
+
+	if (memory_base_address) {
+		LOG_INFO("game memory backed by %zu KB pages", MEMORY_HUGE_PAGE_BYTES / 1024);
+	} else {
+		// Note(fredy): the memory is only reserved, the game commits the pages as it uses them
+		memory_base_address = memory_reserve(MEMORY_BASE_ADDRESS, memory_size_bytes);
+		storage.plat_memory_commit = memory_commit;
+		storage.plat_memory_decommit = memory_decommit;
+
+		// Note(fredy): the transparent huge pages were only asked for, what the kernel gave is read at the end
+		LOG_INFO("game memory backed by %zu KB pages", page_bytes / 1024);
+	}
+
+	storage.permanent_base_address = memory_base_address;
+	storage.transient_base_address = (unsigned char *)storage.permanent_base_address + storage.permanent_size_byte;
+
+	GameOffscreenBuffer back_buffer = {
+		.width_px = 960,
+		.height_px = 540,
+		.bytes_per_pixel = 4,
+	};
+	back_buffer.pitch_bytes = back_buffer.width_px * back_buffer.bytes_per_pixel;
+
+	size_t back_buffer_bytes = (size_t)back_buffer.pitch_bytes * back_buffer.height_px;
+	back_buffer.top_left_px = memory_alloc_huge_pages(nullptr, back_buffer_bytes);
+	if (back_buffer.top_left_px) {
+		LOG_INFO("back buffer backed by %zu KB pages", MEMORY_HUGE_PAGE_BYTES / 1024);
+	} else {
+		back_buffer.top_left_px = mmap(nullptr, back_buffer_bytes, PROT_READ | PROT_WRITE,
+		                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		back_buffer.top_left_px = back_buffer.top_left_px == MAP_FAILED ? nullptr : back_buffer.top_left_px;
+
+		LOG_INFO("back buffer backed by %zu KB pages", page_bytes / 1024);
+	}
+
+	if (!memory_base_address || !back_buffer.top_left_px) {
+		LOG_ERROR("failed to map the memory of the game");
+
+		return EXIT_FAILURE;
+	}
+
+	ThreadContext thread = {};
+	thread_init_scratch(&storage, &thread);
+
+	GameInput input = {};
+	for (uint32_t frame_idx = 0; frame_idx < frame_count; ++frame_idx) {
+		input_script(&input, frame_idx);
+		game_update_and_render(&back_buffer, &thread, &storage, &input);
+	}
+
+	if (storage.plat_memory_commit) {
+		size_t huge_bytes = memory_get_transparent_huge_bytes(memory_base_address, memory_size_bytes);
+		LOG_INFO("%zu KB of the game memory ended up in transparent huge pages", huge_bytes / 1024);
+	}
+
+	printf("%u frames, state checksum %016llx\n", frame_count, (unsigned long long)storage.state_checksum);
+
+	return EXIT_SUCCESS;
 }
@@ -41,6 +41,15 @@ typedef DSOUND_CREATE(direct_sound_create_func);
 #define MAX_FILE_PATH MAX_PATH
 #define REPLAY_MAX_SLOTS 4
 #define REPLAY_NO_SLOT UINT8_MAX
+#define REPLAY_MAX_RANGES 64
+
+#define WORK_QUEUE_MAX_THREADS 16
+
+// Note(fredy): only reserved, a scratch arena commits what its thread uses
+#define THREAD_SCRATCH_ARENA_BYTES MB_TO_BYTES(16ULL)
+
+// Note(fredy): the large pages need the "Lock pages in memory" privilege, without it the memory uses small pages
+#define MEMORY_USE_LARGE_PAGES 1
 
 #define LODWORD(l) ((unsigned long)(((size_t)(l)) & 0xFFFFFFFF))
 #define HIDWORD(l) ((unsigned long)((((size_t)(l)) >> (sizeof(unsigned) * CHAR_BIT)) & 0xFFFFFFFF))
@@ -102,11 +111,25 @@ typedef struct EngineCode {
 	uint8_t is_valid;
 } EngineCode;
 
+/**
+ * @brief Committed part of the game memory, from its base
+ */
+typedef struct ReplayRange {
+	size_t offset_bytes;
+	size_t size_bytes;
+} ReplayRange;
+
 typedef struct ReplaySlot {
 	HANDLE file_handle;
 	HANDLE file_map;
 	void *memory;
 	char filepath[MAX_FILE_PATH];
+
+	/**
+	 * @brief Parts of the game memory that were committed when the recording started, only they are copied
+	 */
+	ReplayRange ranges[REPLAY_MAX_RANGES];
+	uint32_t range_count;
 } ReplaySlot;
 
 typedef enum ReplayStatus : uint8_t {
@@ -116,10 +139,44 @@ typedef enum ReplayStatus : uint8_t {
 	WIN_REPLAY_PLAYBACK,
 } ReplayStatus;
 
+typedef struct WorkQueueEntry {
+	work_queue_callback_func *callback;
+	void *data;
+} WorkQueueEntry;
+
+/**
+ * @brief A thread of the work queue, with the deque and the entries of the jobs it pushed.
+ * The entries are recycled when the queue completes all its jobs.
+ */
+typedef struct WorkQueueThread {
+	WorkDeque deque;
+	WorkQueueEntry entries[WORK_DEQUE_CAPACITY];
+
+	WorkQueue *queue;
+	ThreadContext context;
+	uint32_t entry_count;
+} WorkQueueThread;
+
+struct WorkQueue {
+	WorkQueueThread threads[WORK_QUEUE_MAX_THREADS];
+
+	/**
+	 * @brief Jobs added and not finished yet
+	 */
+	_Atomic uint32_t pending_count;
+	uint32_t thread_count;
+	HANDLE semaphore;
+};
+
 typedef struct WinState {
 	size_t memory_size_bytes;
 	void *memory_base_address;
 
+	/**
+	 * @brief Large pages are committed with the reservation and can not be decommitted
+	 */
+	uint8_t is_memory_large_pages;
+
 	ReplaySlot replay_slots[REPLAY_MAX_SLOTS];
 	HANDLE replay_file_handle;
 
@@ -137,6 +194,8 @@ static WinOffscreenBuffer g_win_back_buffer;
 static LPDIRECTSOUNDBUFFER g_secbuffer;
 static int64_t g_perf_count_frequency;
 static uint32_t g_show_cursor_debug;
+static size_t g_large_page_bytes;
+static uint32_t g_is_memory_report;
 static WINDOWPLACEMENT g_window_position = {
 	.length = sizeof(g_window_position),
 };
@@ -231,6 +290,243 @@ FILE_WRITE_DEBUG(file_write_debug)
 	return result;
 }
 
+/**
+ * @brief Enables the large pages for the process
+ *
+ * @return size_t The size of the large pages, 0 when they can not be used
+ */
+static size_t memory_enable_large_pages(void)
+{
+	size_t result = 0;
+
+#if MEMORY_USE_LARGE_PAGES
+	HANDLE token = nullptr;
+	if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+		TOKEN_PRIVILEGES privileges = {
+			.PrivilegeCount = 1,
+		};
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+		// Note(fredy): AdjustTokenPrivileges also succeeds without the privilege, check the last error
+		if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+		    AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+		    GetLastError() == ERROR_SUCCESS) {
+			result = GetLargePageMinimum();
+		}
+
+		CloseHandle(token);
+	}
+#endif
+
+	return result;
+}
+
+/**
+ * @brief Reserves and commits memory backed by large pages, the size is rounded up to a whole number of them
+ *
+ * @return void* nullptr when large pages can not back the memory
+ */
+static void *memory_alloc_large_pages(void *base_address, size_t size_bytes)
+{
+	void *result = nullptr;
+
+	if (g_large_page_bytes) {
+		size_t rounded_size_bytes = (size_bytes + g_large_page_bytes - 1) & ~(g_large_page_bytes - 1);
+		result = VirtualAlloc(base_address, rounded_size_bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+		                      PAGE_READWRITE);
+	}
+
+	return result;
+}
+
+static ARENA_COMMIT(memory_commit)
+{
+	void *result = VirtualAlloc(base_address, size_bytes, MEM_COMMIT, PAGE_READWRITE);
+
+	return result != nullptr;
+}
+
+static ARENA_DECOMMIT(memory_decommit)
+{
+	VirtualFree(base_address, size_bytes, MEM_DECOMMIT);
+}
+
+#if ARENA_INSTRUMENTATION
+/**
+ * @brief Logs what the game arenas hold by tag, as the game left them at the end of the last frame
+ */
+static void memory_log_stats(const Storage *storage)
+{
+	char text[1024] = {};
+
+	arena_format_stats(&storage->permanent_stats, "permanent", text, sizeof(text));
+	LOG_INFO("%s", text);
+
+	arena_format_stats(&storage->transient_stats, "transient", text, sizeof(text));
+	LOG_INFO("%s", text);
+}
+#endif
+
+/**
+ * @brief Runs one job, from the deque of the calling thread or stolen from another thread
+ *
+ * @return uint32_t 1 if a job was run, 0 if no job was found
+ */
+static uint32_t work_queue_do_next_entry(WorkQueue *queue, ThreadContext *thread)
+{
+	WorkQueueEntry *entry = work_deque_take(&queue->threads[thread->idx].deque);
+
+	for (uint32_t offset = 1; !entry && offset < queue->thread_count; ++offset) {
+		uint32_t victim_idx = (thread->idx + offset) % queue->thread_count;
+		entry = work_deque_steal(&queue->threads[victim_idx].deque);
+	}
+
+	if (entry) {
+		entry->callback(thread, entry->data);
+		atomic_fetch_sub_explicit(&queue->pending_count, 1, memory_order_release);
+	}
+
+	return entry != nullptr;
+}
+
+WORK_QUEUE_ADD_ENTRY(work_queue_add_entry)
+{
+	WorkQueueThread *owner = &queue->threads[thread->idx];
+
+	atomic_fetch_add_explicit(&queue->pending_count, 1, memory_order_relaxed);
+
+	uint32_t was_pushed = 0U;
+	if (owner->entry_count < WORK_DEQUE_CAPACITY) {
+		WorkQueueEntry *entry = &owner->entries[owner->entry_count++];
+		entry->callback = callback;
+		entry->data = data;
+
+		was_pushed = work_deque_push(&owner->deque, entry);
+	}
+
+	if (was_pushed) {
+		ReleaseSemaphore(queue->semaphore, 1, nullptr);
+	} else {
+		// Note(fredy): the thread ran out of entries, the job is run right away
+		callback(thread, data);
+		atomic_fetch_sub_explicit(&queue->pending_count, 1, memory_order_release);
+	}
+}
+
+/**
+ * @brief Only the main thread can complete the queue, as it recycles the entries of every thread.
+ */
+WORK_QUEUE_COMPLETE_ALL(work_queue_complete_all)
+{
+	assert(thread->idx == 0);
+
+	while (atomic_load_explicit(&queue->pending_count, memory_order_acquire) > 0) {
+		if (!work_queue_do_next_entry(queue, thread)) {
+			_mm_pause();
+		}
+	}
+
+	for (uint32_t thread_idx = 0; thread_idx < queue->thread_count; ++thread_idx) {
+		queue->threads[thread_idx].entry_count = 0;
+	}
+}
+
+static DWORD WINAPI work_queue_thread_proc(LPVOID parameter)
+{
+	WorkQueueThread *worker = parameter;
+	WorkQueue *queue = worker->queue;
+
+	for (;;) {
+		if (!work_queue_do_next_entry(queue, &worker->context)) {
+			WaitForSingleObjectEx(queue->semaphore, INFINITE, FALSE);
+		}
+	}
+}
+
+/**
+ * @brief Initializes the queue and launches its workers. The calling thread is the thread 0.
+ *
+ * @return uint32_t 1 if the queue was initialized, otherwise 0
+ */
+static uint32_t work_queue_init(WorkQueue *queue, uint32_t thread_count)
+{
+	assert(thread_count > 0 && thread_count <= WORK_QUEUE_MAX_THREADS);
+
+	atomic_init(&queue->pending_count, 0);
+	queue->thread_count = thread_count;
+	queue->semaphore = CreateSemaphoreEx(nullptr, 0, (LONG)thread_count, nullptr, 0, SEMAPHORE_ALL_ACCESS);
+
+	if (!queue->semaphore) {
+		LOG_ERROR("failed to create the semaphore of the work queue");
+
+		return 0U;
+	}
+
+	for (uint32_t thread_idx = 0; thread_idx < thread_count; ++thread_idx) {
+		WorkQueueThread *worker = &queue->threads[thread_idx];
+		work_deque_init(&worker->deque);
+		worker->queue = queue;
+		worker->context.idx = thread_idx;
+		worker->entry_count = 0;
+
+		if (thread_idx > 0) {
+			HANDLE thread_handle = CreateThread(nullptr, 0, work_queue_thread_proc, worker, 0, nullptr);
+
+			if (!thread_handle) {
+				LOG_ERROR("failed to create the worker thread %u", thread_idx);
+
+				return 0U;
+			}
+
+			CloseHandle(thread_handle);
+		}
+	}
+
+	return 1U;
+}
+
+/**
+ * @brief Carves the scratch arenas of every thread of the queue from the end of the transient storage, the game
+ * keeps the rest. Their Arena structs are at the start of the carved memory, so a replay restores them along with
+ * the pages they committed
+ */
+static void thread_init_scratch(Storage *storage, WorkQueue *queue, ThreadContext *main_thread)
+{
+	size_t arena_count = (size_t)queue->thread_count * THREAD_SCRATCH_ARENA_COUNT;
+	size_t scratch_bytes = ARENA_COMMIT_BYTES + arena_count * THREAD_SCRATCH_ARENA_BYTES;
+
+	assert(scratch_bytes < storage->transient_size_byte);
+
+	storage->transient_size_byte -= scratch_bytes;
+	unsigned char *scratch_base = (unsigned char *)storage->transient_base_address + storage->transient_size_byte;
+
+	Arena header = {};
+	arena_init_reserved(&header, ARENA_COMMIT_BYTES, scratch_base, storage->plat_memory_commit,
+	                    storage->plat_memory_decommit);
+	Arena *arenas = ARENA_PUSH_ARRAY_ZERO(&header, Arena, arena_count);
+
+	for (size_t arena_idx = 0; arena_idx < arena_count; ++arena_idx) {
+		arena_init_reserved(&arenas[arena_idx], THREAD_SCRATCH_ARENA_BYTES,
+		                    scratch_base + ARENA_COMMIT_BYTES + arena_idx * THREAD_SCRATCH_ARENA_BYTES,
+		                    storage->plat_memory_commit, storage->plat_memory_decommit);
+	}
+
+	// Note(fredy): the workers only read their scratch arenas from the jobs, and no job was added yet
+	for (uint32_t thread_idx = 0; thread_idx < queue->thread_count; ++thread_idx) {
+		ThreadContext *context = &queue->threads[thread_idx].context;
+		Arena *thread_arenas = &arenas[thread_idx * THREAD_SCRATCH_ARENA_COUNT];
+
+		for (uint32_t scratch_idx = 0; scratch_idx < THREAD_SCRATCH_ARENA_COUNT; ++scratch_idx) {
+			context->scratch_arenas[scratch_idx] = &thread_arenas[scratch_idx];
+		}
+	}
+
+	// Note(fredy): the main thread runs the jobs as the thread 0 of the queue
+	for (uint32_t scratch_idx = 0; scratch_idx < THREAD_SCRATCH_ARENA_COUNT; ++scratch_idx) {
+		main_thread->scratch_arenas[scratch_idx] = queue->threads[0].context.scratch_arenas[scratch_idx];
+	}
+}
+
 static uint8_t file_get_exe_path(WinState *winstate)
 {
 	unsigned long exe_path_length = GetModuleFileNameA(nullptr, winstate->exe_path, MAX_FILE_PATH);
@@ -604,9 +900,39 @@ static void input_begin_recording(WinState *winstate)
 	filepos.QuadPart = (long long)winstate->memory_size_bytes;
 	SetFilePointerEx(winstate->replay_file_handle, filepos, nullptr, FILE_BEGIN);
 
-	CopyMemory(replay_slot->memory, winstate->memory_base_address, winstate->memory_size_bytes);
+	// Note(fredy): the game memory is only reserved, the committed regions are the ones copied
+	unsigned char *memory = winstate->memory_base_address;
+	unsigned char *replay_memory = replay_slot->memory;
+	uint32_t is_snapshot_complete = 1U;
+	replay_slot->range_count = 0;
+	for (size_t offset_bytes = 0; offset_bytes < winstate->memory_size_bytes && is_snapshot_complete;) {
+		MEMORY_BASIC_INFORMATION info = {};
+		VirtualQuery(memory + offset_bytes, &info, sizeof(info));
+
+		size_t size_bytes = NUMBER_MIN(info.RegionSize, winstate->memory_size_bytes - offset_bytes);
+		if (info.State == MEM_COMMIT) {
+			if (replay_slot->range_count < REPLAY_MAX_RANGES) {
+				replay_slot->ranges[replay_slot->range_count++] = (ReplayRange){
+					.offset_bytes = offset_bytes,
+					.size_bytes = size_bytes,
+				};
+				CopyMemory(replay_memory + offset_bytes, memory + offset_bytes, size_bytes);
+			} else {
+				is_snapshot_complete = 0U;
+			}
+		}
+
+		offset_bytes += size_bytes;
+	}
 
-	winstate->replay_status = WIN_REPLAY_RECORD;
+	// Note(fredy): a snapshot that misses committed memory would replay from a wrong state, nothing is recorded
+	if (is_snapshot_complete) {
+		winstate->replay_status = WIN_REPLAY_RECORD;
+	} else {
+		replay_slot->range_count = 0;
+		LOG_ERROR("the game memory has more than %d committed ranges, the recording was not started",
+		          REPLAY_MAX_RANGES);
+	}
 }
 
 static void input_end_recording(WinState *winstate)
@@ -629,7 +955,23 @@ static void input_begin_playback(WinState *winstate)
 	filepos.QuadPart = (long long)winstate->memory_size_bytes;
 	SetFilePointerEx(winstate->replay_file_handle, filepos, nullptr, FILE_BEGIN);
 
-	CopyMemory(winstate->memory_base_address, replay_slot->memory, winstate->memory_size_bytes);
+	// Note(fredy): the pages committed after the recording started are given back, the arenas expect zero past
+	// what they had committed then. The large pages are all committed from the start
+	unsigned char *memory = winstate->memory_base_address;
+	unsigned char *replay_memory = replay_slot->memory;
+	if (!winstate->is_memory_large_pages) {
+		memory_decommit(memory, winstate->memory_size_bytes);
+	}
+
+	for (uint32_t range_idx = 0; range_idx < replay_slot->range_count; ++range_idx) {
+		ReplayRange *range = &replay_slot->ranges[range_idx];
+
+		if (!winstate->is_memory_large_pages) {
+			memory_commit(memory + range->offset_bytes, range->size_bytes);
+		}
+
+		CopyMemory(memory + range->offset_bytes, replay_memory + range->offset_bytes, range->size_bytes);
+	}
 
 	winstate->replay_status = WIN_REPLAY_PLAYBACK;
 }
@@ -665,6 +1007,36 @@ static void input_playback(WinState *winstate, GameInput *input)
 	assert(bytes_read == sizeof(*input));
 }
 
+/**
+ * @brief Records the checksum of the state the recorded input led to, after the frame is updated
+ */
+static void input_record_checksum(WinState *winstate, uint64_t checksum)
+{
+	assert(winstate->replay_file_handle);
+	unsigned long bytes_written = 0;
+	WriteFile(winstate->replay_file_handle, &checksum, sizeof(checksum), &bytes_written, nullptr);
+}
+
+/**
+ * @brief Compares the checksum of the state the played back input led to with the recorded one
+ */
+static void input_playback_checksum(WinState *winstate, uint64_t checksum)
+{
+	assert(winstate->replay_file_handle);
+
+	uint64_t recorded_checksum = 0;
+	unsigned long bytes_read = 0;
+	ReadFile(winstate->replay_file_handle, &recorded_checksum, sizeof(recorded_checksum), &bytes_read, nullptr);
+
+	assert(bytes_read == sizeof(recorded_checksum));
+
+	if (recorded_checksum != checksum) {
+		LOG_ERROR("the replay diverged: recorded checksum %016llx, played back checksum %016llx",
+		          (unsigned long long)recorded_checksum, (unsigned long long)checksum);
+		assert(0 && "The replay diverged");
+	}
+}
+
 static void window_pump_messages(WinState *winstate, Controller *keyboard_controller)
 {
 	MSG msg;
@@ -740,6 +1112,12 @@ static void window_pump_messages(WinState *winstate, Controller *keyboard_contro
 							window_toggle_fullscreen(msg.hwnd);
 						}
 					}
+
+#if ARENA_INSTRUMENTATION
+					if (vk_code == 'M') {
+						g_is_memory_report = 1U;
+					}
+#endif
 				}
 			}
 			break;
@@ -789,7 +1167,18 @@ static void offscreen_resize_section(WinOffscreenBuffer *back_buffer, unsigned w
 	size_t bitmap_memory_size = (size_t)(back_buffer->width_px) * (size_t)(back_buffer->height_px) *
 	                            (size_t)(back_buffer->bytes_per_pixel);
 
-	back_buffer->top_left_px = VirtualAlloc(nullptr, bitmap_memory_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	back_buffer->top_left_px = memory_alloc_large_pages(nullptr, bitmap_memory_size);
+	if (back_buffer->top_left_px) {
+		LOG_INFO("back buffer backed by %zu KB pages", g_large_page_bytes / 1024);
+	} else {
+		back_buffer->top_left_px =
+			VirtualAlloc(nullptr, bitmap_memory_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+		SYSTEM_INFO system_info = {};
+		GetSystemInfo(&system_info);
+		LOG_INFO("back buffer backed by %lu KB pages", system_info.dwPageSize / 1024);
+	}
+
 	back_buffer->pitch_bytes = back_buffer->width_px * back_buffer->bytes_per_pixel;
 }
 
@@ -1018,6 +1407,8 @@ int CALLBACK WinMain(HINSTANCE hInstance, [[__maybe_unused__]] HINSTANCE hPrevIn
 	g_show_cursor_debug = 1U;
 #endif
 
+	g_large_page_bytes = memory_enable_large_pages();
+
 	WNDCLASSA win_class = {
 		.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC,
 		.lpfnWndProc = window_procedure,
@@ -1100,17 +1491,41 @@ int CALLBACK WinMain(HINSTANCE hInstance, [[__maybe_unused__]] HINSTANCE hPrevIn
 	int16_t *samples =
 		(int16_t *)VirtualAlloc(nullptr, win_sound.buffsize_bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
 
+	SYSTEM_INFO system_info = {};
+	GetSystemInfo(&system_info);
+	uint32_t thread_count = NUMBER_MIN((uint32_t)system_info.dwNumberOfProcessors, WORK_QUEUE_MAX_THREADS);
+
+	WorkQueue *work_queue = VirtualAlloc(nullptr, sizeof(WorkQueue), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (!work_queue || !work_queue_init(work_queue, NUMBER_MAX(thread_count, 1U))) {
+		return EXIT_FAILURE;
+	}
+
 	Storage storage = {
 		.plat_file_free_debug = file_free_debug,
 		.plat_file_read_debug = file_read_debug,
 		.file_write_debug = file_write_debug,
+		.work_queue = work_queue,
+		.plat_work_queue_add_entry = work_queue_add_entry,
+		.plat_work_queue_complete_all = work_queue_complete_all,
 	};
 	storage.permanent_size_byte = MB_TO_BYTES(64ULL);
 	storage.transient_size_byte = GB_TO_BYTES(1ULL);
 
 	win_state.memory_size_bytes = storage.permanent_size_byte + storage.transient_size_byte;
-	win_state.memory_base_address = VirtualAlloc(MEMORY_BASE_ADDRESS, win_state.memory_size_bytes,
-	                                             MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	win_state.memory_base_address = memory_alloc_large_pages(MEMORY_BASE_ADDRESS, win_state.memory_size_bytes);
+	win_state.is_memory_large_pages = win_state.memory_base_address != nullptr;
+
+	if (win_state.is_memory_large_pages) {
+		LOG_INFO("game memory backed by %zu KB pages", g_large_page_bytes / 1024);
+	} else {
+		// Note(fredy): the memory is only reserved, the game commits the pages as it uses them
+		win_state.memory_base_address =
+			VirtualAlloc(MEMORY_BASE_ADDRESS, win_state.memory_size_bytes, MEM_RESERVE, PAGE_READWRITE);
+		storage.plat_memory_commit = memory_commit;
+		storage.plat_memory_decommit = memory_decommit;
+
+		LOG_INFO("game memory backed by %lu KB pages", system_info.dwPageSize / 1024);
+	}
 
 	storage.permanent_base_address = win_state.memory_base_address;
 	storage.transient_base_address = (unsigned char *)storage.permanent_base_address + storage.permanent_size_byte;
@@ -1142,6 +1557,8 @@ int CALLBACK WinMain(HINSTANCE hInstance, [[__maybe_unused__]] HINSTANCE hPrevIn
 	};
 
 	ThreadContext thread = {};
+	thread_init_scratch(&storage, work_queue, &thread);
+
 	GameOffscreenBuffer bitmap = {};
 
 	GameInput inputs[2] = {};
@@ -1165,9 +1582,12 @@ int CALLBACK WinMain(HINSTANCE hInstance, [[__maybe_unused__]] HINSTANCE hPrevIn
 		return EXIT_FAILURE;
 	}
 
+	// Note(fredy): the game simulates at its own fixed rate, it gets the time the last frame really took
+	float last_frame_time_s = target_frame_time_s;
+
 	size_t last_cycle_count = __rdtsc();
 	while (g_is_running) {
-		new_input->time_delta_s = target_frame_time_s;
+		new_input->time_delta_s = last_frame_time_s;
 
 		if (file_get_last_write_time(app_dll_path, &gamedll_last_write_time) &&
 		    CompareFileTime(&game_code.dll_write_time, &gamedll_last_write_time) != 0 &&
@@ -1313,6 +1733,21 @@ int CALLBACK WinMain(HINSTANCE hInstance, [[__maybe_unused__]] HINSTANCE hPrevIn
 			game_code.update_and_render(&bitmap, &thread, &storage, new_input);
 		}
 
+#if ARENA_INSTRUMENTATION
+		if (g_is_memory_report) {
+			memory_log_stats(&storage);
+			g_is_memory_report = 0U;
+		}
+#endif
+
+		if (win_state.replay_status == WIN_REPLAY_RECORD) {
+			input_record_checksum(&win_state, storage.state_checksum);
+		}
+
+		if (win_state.replay_status == WIN_REPLAY_PLAYBACK) {
+			input_playback_checksum(&win_state, storage.state_checksum);
+		}
+
 		unsigned bytes_to_write = 0;
 
 		unsigned long play_cursor = 0;
@@ -1405,7 +1840,8 @@ int CALLBACK WinMain(HINSTANCE hInstance, [[__maybe_unused__]] HINSTANCE hPrevIn
 		}
 
 		LARGE_INTEGER end_counter = clock_get_wall();
-		float ms_per_frame = 1000.0F * clock_elapsed_secs(last_counter, end_counter);
+		last_frame_time_s = clock_elapsed_secs(last_counter, end_counter);
+		float ms_per_frame = 1000.0F * last_frame_time_s;
 		last_counter = end_counter;
 
 		WindowDimensions windim = window_get_dimensions(winhandle);